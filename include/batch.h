@@ -0,0 +1,24 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+
+/* Upper bound on batch worker threads */
+#define BATCH_MAX_JOBS 256
+
+/* Run the jobs of a manifest in one process, one job per line:
+       embed   <cover.png> <payload.bin> <steg.png>
+       extract <steg.png> <output.bin>
+   Fields are separated by blanks and may be double-quoted; empty lines and lines
+   starting with # are skipped. "-" reads the manifest from stdin.
+   Prints "<line>\t<status>" per job to out as jobs finish and returns STEG_SUCCESS or
+   the status of the first failing job in manifest order.
+   jobs is the number of worker threads (0 = one per processor, 1 = run inline).
+   An interrupt (SIGINT, Ctrl-C) stops the run: running jobs are cancelled at their next row
+   band without leaving partial output, queued ones report STEG_ERROR_CANCELLED. */
+int batch_run(const char *manifest_path, FILE *out, unsigned int jobs);
+
+/* Number of processors, the worker count used for jobs == 0 */
+unsigned int batch_default_jobs(void);
+
+#endif /* BATCH_H */
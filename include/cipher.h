@@ -0,0 +1,83 @@
+#ifndef CIPHER_H
+#define CIPHER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Encrypted payload layout: salt (16) | PBKDF2 iterations (32-bit LE) | nonce (12) |
+   AES-256-GCM ciphertext | tag (16). The key is PBKDF2-HMAC-SHA256 of the passphrase. */
+#define CIPHER_KEY_BYTES           32
+#define CIPHER_SALT_BYTES          16
+#define CIPHER_NONCE_BYTES         12
+#define CIPHER_PREFIX_BYTES        (CIPHER_SALT_BYTES + 4 + CIPHER_NONCE_BYTES)
+#define CIPHER_TAG_BYTES           16
+#define CIPHER_OVERHEAD            (CIPHER_PREFIX_BYTES + CIPHER_TAG_BYTES)
+#define CIPHER_BLOCK_BYTES         16
+#define CIPHER_KDF_ITERATIONS      200000u
+#define CIPHER_KDF_MAX_ITERATIONS  10000000u
+
+/* Backend primitives: BCrypt/CNG on Windows, OpenSSL libcrypto elsewhere */
+typedef struct CipherGcm CipherGcm;
+
+/* False when built without an encryption backend (PXPL_ENCRYPTION=OFF) */
+bool cipher_available(void);
+bool cipher_random(uint8_t *buffer, size_t size);
+bool cipher_pbkdf2(const char *passphrase, const uint8_t salt[CIPHER_SALT_BYTES], uint32_t iterations,
+                   uint8_t key[CIPHER_KEY_BYTES]);
+
+/* AES-256-GCM over aad and then the data; update takes whole blocks, final the rest. Final
+   writes the tag when encrypting and checks it (false on mismatch) when decrypting.
+   in and out may be the same buffer. */
+CipherGcm *cipher_gcm_begin(const uint8_t key[CIPHER_KEY_BYTES], const uint8_t nonce[CIPHER_NONCE_BYTES],
+                            const uint8_t *aad, size_t aad_size, bool encrypt);
+bool cipher_gcm_update(CipherGcm *gcm, const uint8_t *in, uint8_t *out, size_t size);
+bool cipher_gcm_final(CipherGcm *gcm, const uint8_t *in, uint8_t *out, size_t size,
+                      uint8_t tag[CIPHER_TAG_BYTES]);
+void cipher_gcm_free(CipherGcm *gcm);
+
+/* Plaintext handed out by cipher_open_write, in order */
+typedef bool (*CipherSinkFn)(void *context, const uint8_t *data, size_t size);
+
+/* The encrypted layout as a byte stream, produced or consumed in order in chunks of any
+   size, so encryption runs band by band alongside the bit kernels without a second copy
+   of the payload. Partial blocks are carried between chunks. */
+typedef struct {
+    CipherGcm *gcm;
+    size_t pos;                             /* Layout bytes produced or consumed */
+    size_t data_size;                       /* Plaintext bytes */
+    const uint8_t *plain;                   /* Seal: plaintext */
+    size_t plain_done;                      /* Seal: plaintext bytes encrypted */
+    CipherSinkFn sink;                      /* Open: plaintext destination */
+    void *sink_context;
+    const char *passphrase;                 /* Open: used once the prefix is in */
+    uint8_t aad[16];
+    size_t aad_size;
+    uint8_t prefix[CIPHER_PREFIX_BYTES];
+    uint8_t tag[CIPHER_TAG_BYTES];
+    uint8_t carry[CIPHER_BLOCK_BYTES];      /* Block between chunks */
+    size_t carry_pos;
+    size_t carry_len;
+    bool finished;
+    bool verified;
+} CipherStream;
+
+/* Seal plain (kept until the last read) with a fresh salt and nonce; aad is authenticated
+   but not stored (at most 16 bytes) */
+bool cipher_seal_begin(CipherStream *stream, const char *passphrase, const uint8_t *aad,
+                       size_t aad_size, const uint8_t *plain, size_t plain_size);
+/* Next size bytes of the layout */
+bool cipher_seal_read(CipherStream *stream, uint8_t *out, size_t size);
+
+/* Open a layout of sealed_size bytes (at least CIPHER_OVERHEAD) */
+bool cipher_open_begin(CipherStream *stream, const char *passphrase, const uint8_t *aad,
+                       size_t aad_size, size_t sealed_size, CipherSinkFn sink, void *context);
+/* Consume the next size layout bytes; data is decrypted in place */
+bool cipher_open_write(CipherStream *stream, uint8_t *data, size_t size);
+/* True once the whole layout was consumed and the tag matched */
+bool cipher_open_verified(const CipherStream *stream);
+
+/* Release the stream; any state derived from the key is wiped */
+void cipher_stream_end(CipherStream *stream);
+
+#endif /* CIPHER_H */
@@ -0,0 +1,52 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Compressed payload layout: original size (32-bit LE), then one block per
+   COMPRESS_BLOCK_BYTES of the original: a 32-bit LE word holding the stored size (bit 31
+   set = stored raw because it did not shrink) and the block in LZ4 block format. Blocks are
+   independent, so they are packed in parallel and unpacked with one block of state. */
+#define COMPRESS_BLOCK_BYTES       (1u << 16)
+#define COMPRESS_RAW_FLAG          0x80000000u
+#define COMPRESS_PREFIX_BYTES      4
+
+/* No layout expands a byte into more than this many (bounds what is worth reading) */
+#define COMPRESS_MAX_RATIO         256
+
+/* Largest packed size of size bytes */
+size_t compress_bound(size_t size);
+
+/* Pack src into dst (compress_bound(size) bytes); returns the packed size */
+size_t compress_pack(const uint8_t *src, size_t size, uint8_t *dst);
+
+/* Original bytes handed out by compress_unpack_write, in order */
+typedef bool (*CompressSinkFn)(void *context, const uint8_t *data, size_t size);
+
+/* Unpacks a layout fed in chunks of any size */
+typedef struct {
+    CompressSinkFn sink;
+    void *sink_context;
+    uint8_t word[4];            /* Size prefix or block word being gathered */
+    size_t word_got;
+    bool have_size;
+    uint32_t size;              /* Original bytes */
+    size_t done;                /* Original bytes handed out */
+    size_t block_size;          /* Stored bytes of the current block, 0 between blocks */
+    bool block_raw;
+    size_t block_got;
+    uint8_t *in;                /* Block gathered across chunks */
+    uint8_t *out;               /* Decoded block */
+    bool failed;                /* Malformed layout (sink errors leave it false) */
+} CompressStream;
+
+bool compress_unpack_begin(CompressStream *stream, CompressSinkFn sink, void *context);
+/* Consume the next size layout bytes; false on a malformed layout or a sink error */
+bool compress_unpack_write(CompressStream *stream, const uint8_t *data, size_t size);
+/* True once the whole layout was consumed and matched its original size */
+bool compress_unpack_done(const CompressStream *stream);
+void compress_unpack_end(CompressStream *stream);
+
+#endif /* COMPRESS_H */
@@ -0,0 +1,12 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* CRC-32C (Castagnoli, reflected, as in iSCSI and ext4) of the payload. Start from 0 and
+   feed consecutive chunks; uses the SSE4.2 or ARMv8 CRC instructions when available,
+   slicing-by-8 tables otherwise. */
+uint32_t crc32c_update(uint32_t crc, const void *data, size_t size);
+
+#endif /* CRC32C_H */
@@ -0,0 +1,49 @@
+#ifndef IMAGE_BACKEND_H
+#define IMAGE_BACKEND_H
+
+#include "steg.h"
+
+/* Codec behind the image_* functions. image.c owns geometry, capacity, the band plane and
+   caller-held pixels; a backend only moves rows between the plane and an encoded image,
+   keeping its objects in info->codec. One backend is built in (PXPL_IMAGE_BACKEND). */
+typedef struct {
+    const char *name;
+    
+    /* Process-wide codec state; shutdown must not race open images */
+    bool (*runtime_init)(void);
+    void (*runtime_shutdown)(void);
+    
+    /* Open a decoder on frame of filename, or of data/size when filename is NULL, and fill
+       width, height, channels, has_alpha, bgr_order, bit_depth, bytes_per_pixel and frame_count */
+    bool (*open_decoder)(ImageInfo *info, const char *filename, const void *data, size_t size,
+                         uint32_t frame);
+    
+    /* Decode rows [y, y + count) into info->pixels */
+    bool (*read_rows)(ImageInfo *info, uint32_t y, uint32_t count);
+    
+    /* PNG encoder with the geometry and png_profile of info, writing to filename
+       (NULL = memory, handed out by encoded_data) */
+    bool (*open_encoder)(ImageInfo *info, const char *filename);
+    
+    /* Append count rows from info->pixels; commit after the last row */
+    bool (*write_rows)(ImageInfo *info, uint32_t count);
+    bool (*finalize_write)(ImageInfo *info);
+    bool (*encoded_data)(ImageInfo *info, uint8_t **data, size_t *size);
+    
+    /* Multi-frame container (TIFF) on filename, NULL when the backend writes PNG only. Frames
+       are added in order by open_frame_encoder with the geometry of info and written like a
+       PNG, finalize_write committing that frame; finalize_container follows the last one. */
+    bool (*open_container)(ImageInfo *container, const char *filename);
+    bool (*open_frame_encoder)(ImageInfo *info, ImageInfo *container);
+    bool (*finalize_container)(ImageInfo *container);
+    
+    /* Release info->codec */
+    void (*close)(ImageInfo *info);
+} ImageBackend;
+
+#ifdef _WIN32
+extern const ImageBackend image_backend_wic;
+#endif
+extern const ImageBackend image_backend_libpng;
+
+#endif /* IMAGE_BACKEND_H */
@@ -0,0 +1,92 @@
+#ifndef KERNEL_H
+#define KERNEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Target architecture families with hand-written LSB kernels */
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define STEG_KERNEL_X86 1
+#endif
+#if defined(_M_ARM64) || defined(__aarch64__)
+#define STEG_KERNEL_NEON 1
+#endif
+
+/* LSB pack/unpack kernel variants */
+typedef enum {
+    STEG_KERNEL_AUTO = 0,   /* Best variant supported by this CPU */
+    STEG_KERNEL_SCALAR,     /* Portable 64-bit word kernels */
+    STEG_KERNEL_SSE2,
+    STEG_KERNEL_AVX2,
+    STEG_KERNEL_NEON
+} StegKernelVariant;
+
+/* Embed kernels write count units from src into the sample bytes at p, extract kernels read them back.
+   The bitstream visits channels in canonical R,G,B order whatever the memory layout.
+   Dense layouts:   one unit = 1 payload byte  <-> 8 sample bytes (gray, RGB order).
+   Wide layouts:    one unit = 1 payload byte  <-> 16 bytes, LSBs in the even bytes
+                    (16-bit gray/RGB with the low byte first, or 8-bit gray + alpha).
+   BGR layouts:     one unit = 3 payload bytes <-> 8 pixels (24 bytes).
+   RGBA/BGRA:       one unit = 3 payload bytes <-> 8 pixels (32 bytes, alpha untouched).
+   RGBA64:          one unit = 3 payload bytes <-> 8 pixels (64 bytes, alpha untouched). */
+typedef void (*LsbEmbedFn)(uint8_t *p, const uint8_t *src, size_t count);
+typedef void (*LsbExtractFn)(const uint8_t *p, uint8_t *dst, size_t count);
+
+/* Kernel dispatch table */
+typedef struct {
+    StegKernelVariant variant;
+    const char *name;
+    LsbEmbedFn embed_dense;
+    LsbExtractFn extract_dense;
+    LsbEmbedFn embed_wide;
+    LsbExtractFn extract_wide;
+    LsbEmbedFn embed_bgr;
+    LsbExtractFn extract_bgr;
+    LsbEmbedFn embed_rgba;
+    LsbExtractFn extract_rgba;
+    LsbEmbedFn embed_bgra;
+    LsbExtractFn extract_bgra;
+    LsbEmbedFn embed_rgba64;
+    LsbExtractFn extract_rgba64;
+} StegKernelOps;
+
+/* Reorder a BGR bit mask (bit i = LSB of sample byte i, starting on a pixel) into canonical
+   R,G,B order by swapping the outer bits of every 3-bit group; it is its own inverse */
+static inline uint64_t bgr_swap_bits(uint64_t m) {
+    return (m & 0x2492492492492492ULL) | ((m >> 2) & 0x9249249249249249ULL) |
+           ((m << 2) & 0x4924924924924924ULL);
+}
+
+/* Same for BGRA 4-bit groups; the alpha bit of each group is cleared */
+static inline uint32_t bgra_swap_bits(uint32_t m) {
+    return (m & 0x22222222u) | ((m >> 2) & 0x11111111u) | ((m << 2) & 0x44444444u);
+}
+
+/* Kernel table for a variant, or NULL if it is not available on this CPU */
+const StegKernelOps *steg_kernel_ops(StegKernelVariant variant);
+
+/* Force a variant for all later transfers (STEG_KERNEL_AUTO restores detection) */
+bool steg_kernel_select(StegKernelVariant variant);
+
+/* Variant currently used by steg_embed_bits/steg_extract_bits */
+const StegKernelOps *steg_kernel_active(void);
+
+/* Scalar kernels, also used by the SIMD variants for their remainders */
+void lsb_embed_dense_scalar(uint8_t *p, const uint8_t *src, size_t nbytes);
+void lsb_extract_dense_scalar(const uint8_t *p, uint8_t *dst, size_t nbytes);
+void lsb_embed_wide_scalar(uint8_t *p, const uint8_t *src, size_t nbytes);
+void lsb_extract_wide_scalar(const uint8_t *p, uint8_t *dst, size_t nbytes);
+void lsb_embed_bgr_scalar(uint8_t *p, const uint8_t *src, size_t ngroups);
+void lsb_extract_bgr_scalar(const uint8_t *p, uint8_t *dst, size_t ngroups);
+void lsb_embed_rgba_scalar(uint8_t *p, const uint8_t *src, size_t ngroups);
+void lsb_extract_rgba_scalar(const uint8_t *p, uint8_t *dst, size_t ngroups);
+void lsb_embed_bgra_scalar(uint8_t *p, const uint8_t *src, size_t ngroups);
+void lsb_extract_bgra_scalar(const uint8_t *p, uint8_t *dst, size_t ngroups);
+void lsb_embed_rgba64_scalar(uint8_t *p, const uint8_t *src, size_t ngroups);
+void lsb_extract_rgba64_scalar(const uint8_t *p, uint8_t *dst, size_t ngroups);
+
+/* SIMD tables from kernel_simd.c (NULL when not compiled in or unsupported) */
+const StegKernelOps *kernel_simd_ops(StegKernelVariant variant);
+
+#endif /* KERNEL_H */
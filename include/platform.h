@@ -0,0 +1,260 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Inline even where the optimizer would not (size-optimized builds, helpers used several times) */
+#ifdef _MSC_VER
+#define PLATFORM_FORCE_INLINE __forceinline
+#else
+#define PLATFORM_FORCE_INLINE inline __attribute__((always_inline))
+#endif
+
+/* Threads, locks, thread-locals, aligned memory, clocks, memory use and file moves on Win32 or POSIX */
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#include <malloc.h>
+
+#define PLATFORM_THREAD_LOCAL __declspec(thread)
+#define PLATFORM_THREAD_CALL WINAPI
+
+typedef CRITICAL_SECTION PlatformMutex;
+typedef CONDITION_VARIABLE PlatformCond;
+typedef HANDLE PlatformThread;
+typedef DWORD PlatformThreadResult;
+typedef volatile LONG PlatformCounter;
+typedef INIT_ONCE PlatformOnce;
+#define PLATFORM_ONCE_INIT INIT_ONCE_STATIC_INIT
+#else
+#include <pthread.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#define PLATFORM_THREAD_LOCAL __thread
+#define PLATFORM_THREAD_CALL
+
+typedef pthread_mutex_t PlatformMutex;
+typedef pthread_cond_t PlatformCond;
+typedef pthread_t PlatformThread;
+typedef void *PlatformThreadResult;
+typedef volatile long PlatformCounter;
+typedef struct {
+    pthread_mutex_t lock;
+    volatile int done;
+} PlatformOnce;
+#define PLATFORM_ONCE_INIT { PTHREAD_MUTEX_INITIALIZER, 0 }
+#endif
+
+/* Thread entry point; return 0 */
+typedef PlatformThreadResult (PLATFORM_THREAD_CALL *PlatformThreadFn)(void *param);
+
+#ifdef _WIN32
+static inline void platform_mutex_init(PlatformMutex *m) { InitializeCriticalSection(m); }
+static inline void platform_mutex_destroy(PlatformMutex *m) { DeleteCriticalSection(m); }
+static inline void platform_mutex_lock(PlatformMutex *m) { EnterCriticalSection(m); }
+static inline void platform_mutex_unlock(PlatformMutex *m) { LeaveCriticalSection(m); }
+
+static inline void platform_cond_init(PlatformCond *c) { InitializeConditionVariable(c); }
+static inline void platform_cond_destroy(PlatformCond *c) { (void)c; }
+static inline void platform_cond_wait(PlatformCond *c, PlatformMutex *m) {
+    SleepConditionVariableCS(c, m, INFINITE);
+}
+static inline void platform_cond_wake_one(PlatformCond *c) { WakeConditionVariable(c); }
+static inline void platform_cond_wake_all(PlatformCond *c) { WakeAllConditionVariable(c); }
+
+static inline bool platform_thread_start(PlatformThread *t, PlatformThreadFn fn, void *param) {
+    *t = CreateThread(NULL, 0, fn, param, 0, NULL);
+    return *t != NULL;
+}
+static inline void platform_thread_join(PlatformThread t) {
+    WaitForSingleObject(t, INFINITE);
+    CloseHandle(t);
+}
+
+/* Atomically add one and return the new value */
+static inline long platform_counter_increment(PlatformCounter *c) { return InterlockedIncrement(c); }
+
+/* Atomically OR bits into a byte */
+static inline void platform_atomic_or8(volatile unsigned char *p, unsigned char bits) {
+    InterlockedOr8((volatile char *)p, (char)bits);
+}
+
+static inline unsigned int platform_cpu_count(void) {
+    SYSTEM_INFO sys;
+    
+    GetSystemInfo(&sys);
+    return sys.dwNumberOfProcessors ? (unsigned int)sys.dwNumberOfProcessors : 1;
+}
+
+static inline BOOL CALLBACK platform_once_call(PINIT_ONCE once, PVOID param, PVOID *context) {
+    (void)once;
+    (void)context;
+    (*(void (**)(void))param)();
+    return TRUE;
+}
+
+/* Run init exactly once until platform_once_reset */
+static inline void platform_once(PlatformOnce *once, void (*init)(void)) {
+    InitOnceExecuteOnce(once, platform_once_call, (PVOID)&init, NULL);
+}
+static inline bool platform_once_done(PlatformOnce *once) {
+    BOOL pending = FALSE;
+    
+    return InitOnceBeginInitialize(once, INIT_ONCE_CHECK_ONLY, &pending, NULL) && !pending;
+}
+static inline void platform_once_reset(PlatformOnce *once) { InitOnceInitialize(once); }
+
+static inline void *platform_aligned_alloc(size_t size, size_t align) { return _aligned_malloc(size, align); }
+static inline void platform_aligned_free(void *p) { _aligned_free(p); }
+
+/* Monotonic high-resolution clock in nanoseconds */
+static inline uint64_t platform_time_ns(void) {
+    LARGE_INTEGER count, freq;
+    
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&freq);
+    return (uint64_t)(count.QuadPart / freq.QuadPart) * 1000000000u +
+           (uint64_t)(count.QuadPart % freq.QuadPart) * 1000000000u / (uint64_t)freq.QuadPart;
+}
+
+/* Peak resident memory of the process in bytes, 0 if unknown */
+static inline uint64_t platform_peak_memory(void) {
+    PROCESS_MEMORY_COUNTERS counters;
+    
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return 0;
+    }
+    return counters.PeakWorkingSetSize;
+}
+
+/* Move file from over file to, replacing to when it exists */
+static inline bool platform_replace_file(const char *from, const char *to) {
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+/* True when both paths name one existing file, however each is spelled; a is looked up first */
+static inline bool platform_same_file(const char *a, const char *b) {
+    BY_HANDLE_FILE_INFORMATION info[2];
+    const char *paths[2];
+    HANDLE file;
+    BOOL found;
+    int i;
+    
+    paths[0] = a;
+    paths[1] = b;
+    for (i = 0; i < 2; i++) {
+        file = CreateFileA(paths[i], 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        found = GetFileInformationByHandle(file, &info[i]);
+        CloseHandle(file);
+        if (!found) {
+            return false;
+        }
+    }
+    return info[0].dwVolumeSerialNumber == info[1].dwVolumeSerialNumber &&
+           info[0].nFileIndexHigh == info[1].nFileIndexHigh && info[0].nFileIndexLow == info[1].nFileIndexLow;
+}
+#else
+static inline void platform_mutex_init(PlatformMutex *m) { pthread_mutex_init(m, NULL); }
+static inline void platform_mutex_destroy(PlatformMutex *m) { pthread_mutex_destroy(m); }
+static inline void platform_mutex_lock(PlatformMutex *m) { pthread_mutex_lock(m); }
+static inline void platform_mutex_unlock(PlatformMutex *m) { pthread_mutex_unlock(m); }
+
+static inline void platform_cond_init(PlatformCond *c) { pthread_cond_init(c, NULL); }
+static inline void platform_cond_destroy(PlatformCond *c) { pthread_cond_destroy(c); }
+static inline void platform_cond_wait(PlatformCond *c, PlatformMutex *m) { pthread_cond_wait(c, m); }
+static inline void platform_cond_wake_one(PlatformCond *c) { pthread_cond_signal(c); }
+static inline void platform_cond_wake_all(PlatformCond *c) { pthread_cond_broadcast(c); }
+
+static inline bool platform_thread_start(PlatformThread *t, PlatformThreadFn fn, void *param) {
+    return pthread_create(t, NULL, fn, param) == 0;
+}
+static inline void platform_thread_join(PlatformThread t) { pthread_join(t, NULL); }
+
+/* Atomically add one and return the new value */
+static inline long platform_counter_increment(PlatformCounter *c) {
+    return __atomic_add_fetch(c, 1, __ATOMIC_SEQ_CST);
+}
+
+/* Atomically OR bits into a byte */
+static inline void platform_atomic_or8(volatile unsigned char *p, unsigned char bits) {
+    __atomic_fetch_or(p, bits, __ATOMIC_RELAXED);
+}
+
+static inline unsigned int platform_cpu_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    
+    return n > 0 ? (unsigned int)n : 1;
+}
+
+/* Run init exactly once until platform_once_reset */
+static inline void platform_once(PlatformOnce *once, void (*init)(void)) {
+    if (__atomic_load_n(&once->done, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+    pthread_mutex_lock(&once->lock);
+    if (!once->done) {
+        init();
+        __atomic_store_n(&once->done, 1, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&once->lock);
+}
+static inline bool platform_once_done(PlatformOnce *once) {
+    return __atomic_load_n(&once->done, __ATOMIC_ACQUIRE) != 0;
+}
+static inline void platform_once_reset(PlatformOnce *once) {
+    __atomic_store_n(&once->done, 0, __ATOMIC_RELEASE);
+}
+
+static inline void *platform_aligned_alloc(size_t size, size_t align) {
+    void *p;
+    
+    return posix_memalign(&p, align, size) == 0 ? p : NULL;
+}
+static inline void platform_aligned_free(void *p) { free(p); }
+
+/* Monotonic high-resolution clock in nanoseconds */
+static inline uint64_t platform_time_ns(void) {
+    struct timespec now;
+    
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+/* Peak resident memory of the process in bytes, 0 if unknown */
+static inline uint64_t platform_peak_memory(void) {
+    struct rusage usage;
+    
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return (uint64_t)usage.ru_maxrss;
+#else
+    return (uint64_t)usage.ru_maxrss * 1024u;
+#endif
+}
+
+/* Move file from over file to, replacing to when it exists */
+static inline bool platform_replace_file(const char *from, const char *to) { return rename(from, to) == 0; }
+
+/* True when both paths name one existing file, however each is spelled; a is looked up first */
+static inline bool platform_same_file(const char *a, const char *b) {
+    struct stat info[2];
+    
+    return stat(a, &info[0]) == 0 && stat(b, &info[1]) == 0 &&
+           info[0].st_dev == info[1].st_dev && info[0].st_ino == info[1].st_ino;
+}
+#endif
+
+#endif /* PLATFORM_H */
@@ -0,0 +1,28 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Upper bound on shared pool threads */
+#define POOL_MAX_THREADS 64
+
+/* One task of a parallel run; index is in [0, count) */
+typedef void (*PoolTaskFn)(void *context, size_t index);
+
+/* Run fn(context, i) for every i in [0, count) on the shared worker threads and the caller,
+   returning once all tasks are done. Workers start on first use. Runs inline when the pool
+   is busy with another caller, has no workers, or parallelism is off on this thread. */
+void pool_run(PoolTaskFn fn, void *context, size_t count);
+
+/* Threads a run can use, caller included (1 when runs are inline) */
+unsigned int pool_threads(void);
+
+/* Turn intra-operation parallelism on or off for the calling thread, e.g. inside batch
+   workers that already keep every core busy */
+void pool_set_thread_parallel(bool enabled);
+
+/* Stop and join the workers; the next pool_run starts them again */
+void pool_shutdown(void);
+
+#endif /* POOL_H */
@@ -0,0 +1,26 @@
+#ifndef SCATTER_H
+#define SCATTER_H
+
+#include <stdint.h>
+
+/* Feistel rounds of the index permutation */
+#define SCATTER_ROUNDS 4
+
+/* Seeded bijection on [0, domain): a Feistel network over the bits covering the domain
+   (halves differ by at most one bit), cycle-walked back into range. Maps one index either way in
+   O(1) with no table. It spreads the payload over the image; it is not encryption. */
+typedef struct {
+    uint64_t domain;
+    unsigned left_bits;
+    unsigned right_bits;
+    uint64_t right_mask;
+    uint64_t keys[SCATTER_ROUNDS];
+} ScatterPerm;
+
+void scatter_init(ScatterPerm *perm, uint64_t seed, uint64_t domain);
+
+/* Logical index to its position, and back */
+uint64_t scatter_map(const ScatterPerm *perm, uint64_t index);
+uint64_t scatter_unmap(const ScatterPerm *perm, uint64_t index);
+
+#endif /* SCATTER_H */
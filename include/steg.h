@@ -2,17 +2,10 @@
 #define STEG_H
 
 #include <stdint.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdbool.h>
-
-/* Use Windows Imaging Component (WIC) for PNG support */
-#ifdef _WIN32
-#include <windows.h>
-#include <wincodec.h>
-#include <combaseapi.h>
-#else
-#error "This implementation requires Windows"
-#endif
+#include <signal.h>
 
 /* Return codes */
 #define STEG_SUCCESS               0
@@ -21,6 +14,35 @@
 #define STEG_ERROR_CAPACITY        3
 #define STEG_ERROR_IO              4
 #define STEG_ERROR_PNG             5
+#define STEG_ERROR_CANCELLED       6
+
+/* Most low bits per sample a payload can use (--depth) */
+#define STEG_MAX_DEPTH             4
+
+/* Payload header in the LSBs of the first STEG_HEADER_BITS samples, fields little-endian:
+   magic "PXPL" (32 bits), version (8), flags (8, bits 0-1 = depth - 1, bit 2 = scattered,
+   bit 3 = encrypted, bit 4 = compressed, bit 5 = shard), reserved (16), payload size (32). The
+   payload follows at depth bits per sample, then its CRC-32C; scattered payloads have their
+   samples permuted by a seed (see scatter.h), encrypted ones are stored sealed with the header
+   as AAD (see cipher.h), compressed ones are LZ4 packed before sealing (see compress.h). */
+#define STEG_HEADER_MAGIC          0x4C505850u
+#define STEG_HEADER_VERSION        1
+#define STEG_HEADER_BITS           96
+#define STEG_CRC_BITS              32
+#define STEG_FLAG_DEPTH_MASK       0x03
+#define STEG_FLAG_SCATTER          0x04
+#define STEG_FLAG_ENCRYPTED        0x08
+#define STEG_FLAG_COMPRESSED       0x10
+#define STEG_FLAG_SHARD            0x20
+
+/* A shard of a multi-cover set starts its payload with a record, fields little-endian: set ID
+   (32 bits, the CRC-32C of the whole payload), whole payload size (32), offset of the shard's
+   bytes in it (32), shard index (16) and shard count (16). */
+#define STEG_SHARD_BYTES           16
+#define STEG_MAX_SHARDS            65535
+
+/* Target pixel plane size of one streamed row band */
+#define STEG_BAND_BYTES            (4u << 20)
 
 /* PNG color types (matching PNG standard values) */
 typedef enum {
@@ -31,54 +53,282 @@ typedef enum {
     PNG_COLOR_RGBA = 6              /* 6 - RGBA */
 } PngColorType;
 
+/* Layouts of caller-held pixel buffers (steg_embed_pixels/steg_extract_pixels) */
+typedef enum {
+    STEG_PIXELS_GRAY8 = 0,          /* 1 byte per pixel */
+    STEG_PIXELS_RGB24,              /* R,G,B */
+    STEG_PIXELS_BGR24,              /* B,G,R (WIC 24bppBGR) */
+    STEG_PIXELS_RGBA32,             /* R,G,B,A - alpha untouched */
+    STEG_PIXELS_BGRA32              /* B,G,R,A (WIC 32bppBGRA) - alpha untouched */
+} StegPixelFormat;
+
+/* PNG encode profiles: encode time vs. output size. PNG is lossless, so LSBs survive all of them. */
+typedef enum {
+    STEG_PNG_FAST = 0,              /* No filtering, minimal compression (default) */
+    STEG_PNG_BALANCED,              /* Sub filter, medium compression */
+    STEG_PNG_SMALL                  /* Adaptive filtering, maximum compression */
+} StegPngProfile;
+
+/* Payload compression modes */
+typedef enum {
+    STEG_COMPRESS_OFF = 0,          /* Store the payload as is (default) */
+    STEG_COMPRESS_ON,               /* Store it packed whenever that makes it smaller */
+    STEG_COMPRESS_AUTO              /* Pack only when that makes it fit or saves enough rows */
+} StegCompress;
+
+/* Packing needs the whole packed payload before the first band is encoded (its size goes in
+   the header), so it is staged in memory and takes payloads up to this size. Auto mode
+   stores a larger one raw when it fits that way; otherwise the embed fails with
+   STEG_ERROR_ARGS. */
+#define STEG_COMPRESS_MAX_BYTES    (256u << 20)
+
+/* Stages of an operation reported to a progress callback */
+typedef enum {
+    STEG_PHASE_DECODE = 0,          /* Rows decoded from the input image */
+    STEG_PHASE_EMBED,               /* Rows holding their part of the payload */
+    STEG_PHASE_EXTRACT,             /* Rows whose part of the payload was read */
+    STEG_PHASE_ENCODE               /* Rows encoded into the steg image */
+} StegPhase;
+
+typedef struct {
+    StegPhase phase;
+    uint32_t rows_done;             /* Rows of the image through with this phase */
+    uint32_t rows_total;            /* Rows the phase covers */
+    size_t bytes_done;              /* Stored payload bytes in the rows through with it */
+    size_t bytes_total;             /* Payload bytes as stored (see StegProbeInfo) */
+} StegProgress;
+
+/* Called on the thread running the operation once per row band and phase. Return false to
+   cancel: the operation stops before the next band, fails with STEG_ERROR_CANCELLED and
+   leaves no output behind. A scattered payload counts its bytes in proportion to the rows.
+   This and the cancel flag cost one test per band when unset. */
+typedef bool (*StegProgressFn)(void *context, const StegProgress *progress);
+
+/* Phases timed in StegStats */
+typedef enum {
+    STEG_STATS_DECODE = 0,          /* Decoding image rows */
+    STEG_STATS_KEY,                 /* Deriving the cipher key from the passphrase */
+    STEG_STATS_COMPRESS,            /* Packing the payload before embedding */
+    STEG_STATS_PAYLOAD,             /* Moving payload bits in or out of the rows, with sealing,
+                                       opening, unpacking, the CRC and output writes */
+    STEG_STATS_ENCODE,              /* Encoding rows and finishing the steg image */
+    STEG_STATS_OTHER,               /* Opening files, headers and buffers */
+    STEG_STATS_PHASES
+} StegStatsPhase;
+
+/* Timings and counters of one steg_embed_ex/steg_extract_ex, filled in when
+   StegOptions.stats is set (also on failure, up to where it stopped) */
+typedef struct {
+    uint64_t phase_ns[STEG_STATS_PHASES];   /* Wall time per phase; they add up to total_ns */
+    uint64_t total_ns;
+    uint32_t rows_decoded;
+    uint32_t rows_encoded;
+    uint64_t bytes_decoded;         /* Pixel plane bytes of the rows decoded */
+    uint64_t bytes_encoded;         /* Pixel plane bytes of the rows encoded */
+    uint64_t payload_bytes;         /* Payload bytes as stored (see StegProbeInfo) */
+    uint64_t peak_memory;           /* Peak resident memory of the process in bytes, 0 if unknown */
+} StegStats;
+
+/* Embed options; a zeroed struct (or NULL) gives the defaults. Extract uses only the seed,
+   the key, the progress callback and the stats. */
+typedef struct {
+    StegPngProfile png_profile;     /* Encoder settings of the steg image */
+    uint8_t depth;                  /* Low bits per sample for the payload, 1-STEG_MAX_DEPTH (0 = 1) */
+    bool scatter;                   /* Spread the payload over the image by seed */
+    uint64_t seed;                  /* Permutation seed; extract needs the same one */
+    const char *key;                /* AES-256-GCM passphrase, NULL = store the payload in clear */
+    StegCompress compress;          /* LZ4 packing of the payload */
+    StegProgressFn progress;        /* Progress callback, NULL = none (multi-cover sets call none) */
+    void *progress_context;         /* Passed to progress */
+    const volatile sig_atomic_t *cancel; /* Nonzero cancels like a false progress return; may be
+                                             set from another thread or a signal handler, NULL = none */
+    StegStats *stats;               /* Phase timings of the operation, NULL = not timed */
+} StegOptions;
+
 /* Image metadata - optimized layout for cache efficiency */
 typedef struct {
     /* Frequently accessed fields first (cache line 1) */
     uint32_t width;             /* Image width in pixels */
     uint32_t height;            /* Image height in pixels */
-    size_t rowbytes;            /* Bytes per row */
-    size_t capacity;            /* Available capacity in bits for payload */
-    uint8_t **row_pointers;     /* Array of row pointers */
+    size_t rowbytes;            /* Bytes per row (also the plane stride) */
+    size_t capacity;            /* Bits left after the header at one bit per sample */
+    uint8_t *pixels;            /* Contiguous pixel plane, 64-byte aligned */
+    uint8_t **row_pointers;     /* Row views into pixels */
+    bool pixels_borrowed;       /* Plane moved to a writer by image_open_write_from */
+    uint32_t band_y;            /* First image row held in pixels */
+    uint32_t band_rows;         /* Rows currently held in pixels */
+    uint32_t band_capacity;     /* Rows the plane can hold (height when fully decoded) */
+    uint32_t rows_written;      /* Rows streamed to the encoder so far */
     
     /* Less frequently accessed fields */
     uint8_t channels;           /* Number of channels (1, 2, 3, 4) */
     uint8_t bytes_per_pixel;    /* Bytes per pixel */
-    uint8_t bit_depth;          /* Bits per channel (1, 2, 4, 8, 16) */
+    uint8_t bit_depth;          /* Bits per sample in the plane (8, or 16 stored low byte first) */
     uint8_t color_type;         /* PNG color type */
     bool has_alpha;             /* Whether image has alpha channel */
+    bool bgr_order;             /* 8-bit color samples stored B,G,R(,A) (native WIC layout) */
     bool interlaced;            /* Whether image is interlaced */
+    uint8_t png_profile;        /* StegPngProfile of writers, taken from the template */
+    uint32_t frame_count;       /* Frames in the decoded container (1 for PNG) */
     
-    /* WIC structures (used during I/O only) */
-    IWICImagingFactory *wic_factory;    /* WIC factory */
-    IWICBitmapDecoder *decoder;         /* WIC decoder */
-    IWICBitmapFrameDecode *frame;       /* WIC frame decoder */
-    IWICBitmapEncoder *encoder;         /* WIC encoder */
-    IWICBitmapFrameEncode *frame_encode; /* WIC frame encoder */
-    IWICStream *stream;                 /* WIC stream */
-    FILE *fp;                           /* File pointer for I/O operations */
-    uint8_t *current_row;               /* Current row being processed */
+    /* Codec state (used during I/O only) */
+    void *codec;                        /* Decoder or encoder of the image backend */
+    
+    /* Caller-held pixels (image_open_pixels) */
+    uint8_t *raw_pixels;                /* First row of the caller's buffer */
+    size_t raw_stride;                  /* Bytes between caller rows */
 } ImageInfo;
 
+/* Header fields of a carrier image, filled by steg_probe */
+typedef struct {
+    uint8_t version;        /* Header version (STEG_HEADER_VERSION) */
+    uint8_t depth;          /* Low bits per sample holding the payload */
+    bool scattered;         /* Payload samples permuted by a seed */
+    bool encrypted;         /* Payload sealed with a passphrase */
+    bool compressed;        /* Payload LZ4 packed */
+    bool shard;             /* Payload is one shard of a multi-cover set */
+    uint32_t payload_size;  /* Payload bytes as stored (packed, CIPHER_OVERHEAD more when encrypted) */
+    size_t capacity;        /* Largest payload in bytes the image holds at this depth */
+} StegProbeInfo;
+
 /* Steganography context */
 typedef struct {
     ImageInfo *image;       /* Image being processed */
     uint32_t payload_size;  /* Size of payload in bytes */
     size_t bits_processed;  /* Bits processed so far */
+    uint8_t depth;          /* Bits each sample carries in steg_embed_bits/steg_extract_bits (0 = 1) */
 } StegContext;
 
+/* Runtime: codec state shared by every operation (the WIC factory, kept in the COM
+   multithreaded apartment, with the WIC backend) and the worker pool. Optional - image
+   functions initialize it lazily on first use. Each open image enters COM on its thread and
+   leaves it on close, joining the multithreaded apartment unless the thread already has one.
+   Shutdown joins the pool first and is only valid once no other thread is inside a steg_* or
+   image_* call; init may follow it again. */
+bool steg_runtime_init(void);
+void steg_runtime_shutdown(void);
+
 /* Image handling functions */
 bool image_open_read(const char *filename, ImageInfo *info);
 bool image_open_write(const char *filename, ImageInfo *info, const ImageInfo *template);
+/* Like image_open_write, but moves the plane of source into info instead of allocating one.
+   source keeps a borrowed view so image_read_rows decodes straight into the writer's plane. */
+bool image_open_write_from(const char *filename, ImageInfo *info, ImageInfo *source);
 void image_close(ImageInfo *info);
-bool image_read_row(ImageInfo *info, uint32_t y);
-bool image_write_row(ImageInfo *info, uint32_t y);
 bool image_finalize_write(ImageInfo *info);
 
-/* Steganography functions */
+/* Banded streaming: open without decoding (band_rows 0 = STEG_BAND_BYTES worth of rows),
+   decode rows [y, y + count) into the plane, and append the plane's first count rows to the encoder */
+bool image_open_stream(const char *filename, ImageInfo *info, uint32_t band_rows);
+bool image_read_rows(ImageInfo *info, uint32_t y, uint32_t count);
+bool image_write_rows(ImageInfo *info, uint32_t count);
+
+/* Read only the image header (PNG IHDR): geometry, layout and capacity, without a plane */
+bool image_open_info(const char *filename, ImageInfo *info);
+
+/* Like image_open_stream and image_open_info, on frame of a multi-frame container (TIFF,
+   GIF or ICO with the WIC backend; a PNG has frame 0 only). frame_count tells how many. */
+bool image_open_stream_frame(const char *filename, uint32_t frame, ImageInfo *info, uint32_t band_rows);
+bool image_open_info_frame(const char *filename, uint32_t frame, ImageInfo *info);
+
+/* Multi-frame output (a multi-page TIFF, WIC backend only): open the container, add each
+   frame with image_open_write_frame - image_open_write_from into the next frame instead of a
+   file of its own - write and finalize it, then finalize the container. image_close releases
+   the container once its frames are closed. */
+bool image_open_container(const char *filename, ImageInfo *container);
+bool image_open_write_frame(ImageInfo *container, ImageInfo *info, ImageInfo *source);
+bool image_finalize_container(ImageInfo *container);
+
+/* Decode from an encoded image in memory; data must stay valid until image_close */
+bool image_open_stream_mem(const void *data, size_t size, ImageInfo *info, uint32_t band_rows);
+
+/* After image_finalize_write of a writer opened with a NULL filename: copy of the encoded
+   PNG, released with free() */
+bool image_encoded_data(ImageInfo *info, uint8_t **data, size_t *size);
+
+/* Wrap caller-held pixels. A tightly packed buffer is used in place as a single band;
+   otherwise image_read_rows copies bands in and image_write_rows copies them back. */
+bool image_open_pixels(ImageInfo *info, uint8_t *pixels, uint32_t width, uint32_t height,
+                       size_t stride, StegPixelFormat format);
+
+/* Steganography functions. The steg image is written to steg_path + ".tmp" and moved over
+   steg_path once the embed succeeds, so steg_path may name the cover itself. Extract output
+   of an encrypted payload is not authenticated until the call returns true: a file output
+   is removed on failure, and output_path "-" holds the payload in memory until its tag
+   verifies before writing it to stdout. */
 bool steg_embed(const char *cover_path, const char *payload_path, const char *steg_path);
+bool steg_embed_ex(const char *cover_path, const char *payload_path, const char *steg_path,
+                   const StegOptions *options);
 bool steg_extract(const char *steg_path, const char *output_path);
+bool steg_extract_ex(const char *steg_path, const char *output_path, const StegOptions *options);
 
-/* Inline bit manipulation functions for performance */
+/* Multi-cover sets: split a payload over count covers in proportion to their capacity, one
+   shard per cover, embedding the covers in parallel on the worker pool. Extract takes the
+   steg images in any order and writes the rebuilt payload once every shard checked out. */
+bool steg_embed_multi(const char *payload_path, size_t count, const char *const *cover_paths,
+                      const char *const *steg_paths, const StegOptions *options);
+bool steg_extract_multi(size_t count, const char *const *steg_paths, const char *output_path,
+                        const StegOptions *options);
+
+/* A set over the frames of one multi-frame cover (frame_count of image_open_info), written
+   as one multi-page TIFF steg image: frame i carries shard i, so the whole set is a single
+   carrier. Frames are encoded one after another; needs the WIC backend (STEG_ERROR_PNG
+   otherwise). steg_extract_frames decodes the frames in parallel and rebuilds the payload. */
+bool steg_embed_frames(const char *payload_path, const char *cover_path, const char *steg_path,
+                       const StegOptions *options);
+bool steg_extract_frames(const char *steg_path, const char *output_path, const StegOptions *options);
+
+/* Decode only the rows holding the header and validate it: false (STEG_ERROR_FORMAT) for an
+   image that carries no payload. The payload CRC is not checked, that takes a full extract. */
+bool steg_probe(const char *steg_path, StegProbeInfo *info);
+
+/* Largest payload in bytes a cover holds at depth (0 = 1) bits per sample. Reads only the
+   image header, no pixel data is decoded. */
+bool steg_capacity(const char *image_path, uint8_t depth, size_t *payload_bytes);
+
+/* In-memory variants: encoded image bytes in, encoded PNG (embed) or payload (extract) out.
+   Output buffers are allocated by the library and released with steg_free. The _ex forms
+   take the StegOptions of steg_embed_ex/steg_extract_ex. An extracted payload is only
+   authenticated once the call returns true; on failure its buffer is wiped and freed and
+   *payload stays NULL. */
+bool steg_embed_mem(const uint8_t *cover, size_t cover_size, const uint8_t *payload,
+                    size_t payload_size, uint8_t **steg, size_t *steg_size);
+bool steg_embed_mem_ex(const uint8_t *cover, size_t cover_size, const uint8_t *payload,
+                       size_t payload_size, uint8_t **steg, size_t *steg_size,
+                       const StegOptions *options);
+bool steg_extract_mem(const uint8_t *steg, size_t steg_size, uint8_t **payload, size_t *payload_size);
+bool steg_extract_mem_ex(const uint8_t *steg, size_t steg_size, uint8_t **payload,
+                         size_t *payload_size, const StegOptions *options);
+
+/* Raw pixel variants: no codec work, LSBs are set in place in the caller's buffer (the PNG
+   profile of the options does not apply). The extracted payload is handed over as by the
+   in-memory variants. */
+bool steg_embed_pixels(uint8_t *pixels, uint32_t width, uint32_t height, size_t stride,
+                       StegPixelFormat format, const uint8_t *payload, size_t payload_size);
+bool steg_embed_pixels_ex(uint8_t *pixels, uint32_t width, uint32_t height, size_t stride,
+                          StegPixelFormat format, const uint8_t *payload, size_t payload_size,
+                          const StegOptions *options);
+bool steg_extract_pixels(const uint8_t *pixels, uint32_t width, uint32_t height, size_t stride,
+                         StegPixelFormat format, uint8_t **payload, size_t *payload_size);
+bool steg_extract_pixels_ex(const uint8_t *pixels, uint32_t width, uint32_t height, size_t stride,
+                            StegPixelFormat format, uint8_t **payload, size_t *payload_size,
+                            const StegOptions *options);
+
+/* Wipe and free a buffer returned by the _mem/_pixels functions */
+void steg_free(void *buffer, size_t size);
+
+/* STEG_* code of the last steg_embed/steg_extract on the calling thread */
+int steg_last_error(void);
+
+/* Bulk bit transfer: bit i of the buffer (LSB first) maps to stream offset start_offset + i.
+   Walks the pixel plane with a running cursor; equivalent to steg_write_bit/steg_read_bit per bit.
+   Offsets are image-wide; the range must lie within the rows currently held in the plane.
+   With ctx->depth > 1, sample s holds stream bits [s * depth, (s + 1) * depth) in its low bits
+   (lowest first). */
+bool steg_embed_bits(StegContext *ctx, const uint8_t *src, size_t nbits, size_t start_offset);
+bool steg_extract_bits(StegContext *ctx, uint8_t *dst, size_t nbits, size_t start_offset);
+
+/* Reference per-bit access; addresses a fully decoded image (band_y 0, all rows held) */
 static inline bool steg_write_bit(StegContext *ctx, uint8_t bit, uint32_t offset) {
     if (!ctx || !ctx->image || !ctx->image->row_pointers) return false;
     
@@ -90,7 +340,11 @@ static inline bool steg_write_bit(StegContext *ctx, uint8_t bit, uint32_t offset
     
     if (y >= ctx->image->height || x >= ctx->image->width) return false;
     
-    uint32_t pixel_offset = x * ctx->image->bytes_per_pixel + channel;
+    /* Bitstream order is R,G,B regardless of memory layout */
+    if (ctx->image->bgr_order && usable_channels == 3) channel = 2 - channel;
+    
+    /* The LSB is in the first byte of 16-bit samples */
+    uint32_t pixel_offset = x * ctx->image->bytes_per_pixel + channel * (ctx->image->bit_depth / 8);
     uint8_t *pixel = &ctx->image->row_pointers[y][pixel_offset];
     *pixel = (*pixel & 0xFE) | (bit & 0x01);
     
@@ -108,7 +362,9 @@ static inline uint8_t steg_read_bit(StegContext *ctx, uint32_t offset) {
     
     if (y >= ctx->image->height || x >= ctx->image->width) return 0;
     
-    uint32_t pixel_offset = x * ctx->image->bytes_per_pixel + channel;
+    if (ctx->image->bgr_order && usable_channels == 3) channel = 2 - channel;
+    
+    uint32_t pixel_offset = x * ctx->image->bytes_per_pixel + channel * (ctx->image->bit_depth / 8);
     return ctx->image->row_pointers[y][pixel_offset] & 0x01;
 }
 
@@ -0,0 +1,329 @@
+#include "batch.h"
+#include "steg.h"
+#include "pool.h"
+#include "platform.h"
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#ifdef _WIN32
+#include <objbase.h>
+#endif
+
+/* Longest manifest line, enough for three MAX_PATH paths plus the command */
+#define BATCH_LINE_MAX 4096
+#define BATCH_MAX_FIELDS 4
+
+/* One manifest line waiting to run */
+typedef struct {
+    unsigned long line_no;
+    int status;                 /* Preset failure for lines rejected while reading */
+    char line[BATCH_LINE_MAX];
+} BatchJob;
+
+/* Shared state of one batch run. The queue is bounded so at most workers + capacity
+   lines are buffered and only workers images are in flight at any time. */
+typedef struct {
+    FILE *out;
+    PlatformMutex lock;
+    PlatformCond not_empty;
+    PlatformCond not_full;
+    BatchJob *slots;
+    unsigned int capacity;
+    unsigned int head;
+    unsigned int count;
+    bool closed;
+    int first_status;           /* Status of the first failing job in manifest order */
+    unsigned long first_line;
+} BatchState;
+
+/* Set by the first interrupt of a run: running jobs stop at their next row band and
+   remove their partial output, queued ones are reported cancelled without running */
+static volatile sig_atomic_t batch_cancelled;
+
+/* Interrupt handler for the length of a run; a second interrupt ends the process as usual */
+static void batch_interrupt(int sig) {
+    batch_cancelled = 1;
+    signal(sig, SIG_DFL);
+}
+
+/* Split a line in place into blank-separated, optionally double-quoted fields.
+   Returns the field count, or -1 for too many fields or an unterminated quote. */
+static int split_fields(char *line, char **fields, int max_fields) {
+    int count = 0;
+    char *p = line;
+    
+    for (;;) {
+        while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+            p++;
+        }
+        if (*p == '\0' || *p == '#') {
+            return count;
+        }
+        if (count == max_fields) {
+            return -1;
+        }
+        
+        if (*p == '"') {
+            fields[count++] = ++p;
+            p = strchr(p, '"');
+            if (!p) {
+                return -1;
+            }
+        } else {
+            fields[count++] = p;
+            while (*p && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+                p++;
+            }
+            if (*p == '\0') {
+                return count;
+            }
+        }
+        *p++ = '\0';
+    }
+}
+
+/* Lines holding only blanks or a comment carry no job */
+static bool is_blank_line(const char *line) {
+    while (*line == ' ' || *line == '\t' || *line == '\r' || *line == '\n') {
+        line++;
+    }
+    return *line == '\0' || *line == '#';
+}
+
+/* Parse and run one job and return its STEG_* status */
+static int run_job(BatchJob *job) {
+    StegOptions options = {0};
+    char *fields[BATCH_MAX_FIELDS];
+    int count;
+    bool ok;
+    
+    if (job->status != STEG_SUCCESS) {
+        return job->status;
+    }
+    if (batch_cancelled) {
+        return STEG_ERROR_CANCELLED;
+    }
+    
+    options.cancel = &batch_cancelled;
+    count = split_fields(job->line, fields, BATCH_MAX_FIELDS);
+    if (count == 4 && strcmp(fields[0], "embed") == 0) {
+        ok = steg_embed_ex(fields[1], fields[2], fields[3], &options);
+    } else if (count == 3 && strcmp(fields[0], "extract") == 0) {
+        ok = steg_extract_ex(fields[1], fields[2], &options);
+    } else {
+        fprintf(stderr, "Error: Malformed manifest line %lu\n", job->line_no);
+        return STEG_ERROR_ARGS;
+    }
+    
+    if (ok) {
+        return STEG_SUCCESS;
+    }
+    return steg_last_error() != STEG_SUCCESS ? steg_last_error() : STEG_ERROR_IO;
+}
+
+/* Print a job status and remember the earliest failure */
+static void report_job(BatchState *state, unsigned long line_no, int status) {
+    platform_mutex_lock(&state->lock);
+    fprintf(state->out, "%lu\t%d\n", line_no, status);
+    fflush(state->out);
+    if (status != STEG_SUCCESS && (state->first_status == STEG_SUCCESS || line_no < state->first_line)) {
+        state->first_status = status;
+        state->first_line = line_no;
+    }
+    platform_mutex_unlock(&state->lock);
+}
+
+/* Append a job, waiting while the queue is full */
+static void queue_push(BatchState *state, const BatchJob *job) {
+    platform_mutex_lock(&state->lock);
+    while (state->count == state->capacity) {
+        platform_cond_wait(&state->not_full, &state->lock);
+    }
+    state->slots[(state->head + state->count) % state->capacity] = *job;
+    state->count++;
+    platform_cond_wake_one(&state->not_empty);
+    platform_mutex_unlock(&state->lock);
+}
+
+/* Take the next job; false once the queue is closed and drained */
+static bool queue_pop(BatchState *state, BatchJob *job) {
+    platform_mutex_lock(&state->lock);
+    while (state->count == 0 && !state->closed) {
+        platform_cond_wait(&state->not_empty, &state->lock);
+    }
+    if (state->count == 0) {
+        platform_mutex_unlock(&state->lock);
+        return false;
+    }
+    *job = state->slots[state->head];
+    state->head = (state->head + 1) % state->capacity;
+    state->count--;
+    platform_cond_wake_one(&state->not_full);
+    platform_mutex_unlock(&state->lock);
+    return true;
+}
+
+static void queue_close(BatchState *state) {
+    platform_mutex_lock(&state->lock);
+    state->closed = true;
+    platform_cond_wake_all(&state->not_empty);
+    platform_mutex_unlock(&state->lock);
+}
+
+/* Worker thread: on Windows its own multithreaded apartment, the shared WIC factory */
+static PlatformThreadResult PLATFORM_THREAD_CALL batch_worker(void *param) {
+    BatchState *state = (BatchState *)param;
+    BatchJob job;
+#ifdef _WIN32
+    HRESULT hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+#endif
+    
+    /* Jobs already occupy the cores; keep each one on its worker */
+    pool_set_thread_parallel(false);
+    
+    while (queue_pop(state, &job)) {
+        report_job(state, job.line_no, run_job(&job));
+    }
+    
+#ifdef _WIN32
+    if (SUCCEEDED(hr)) {
+        CoUninitialize();
+    }
+#endif
+    return 0;
+}
+
+/* Start up to count workers; returns how many are running */
+static unsigned int start_workers(BatchState *state, PlatformThread *threads, unsigned int count) {
+    unsigned int started = 0;
+    
+    while (started < count && platform_thread_start(&threads[started], batch_worker, state)) {
+        started++;
+    }
+    return started;
+}
+
+unsigned int batch_default_jobs(void) {
+    return platform_cpu_count();
+}
+
+int batch_run(const char *manifest_path, FILE *out, unsigned int jobs) {
+    BatchState state;
+    FILE *manifest;
+    BatchJob job;
+    PlatformThread *threads = NULL;
+    void (*previous_interrupt)(int);
+    unsigned int workers = 0;
+    unsigned int i;
+    bool truncated = false;
+    bool read_failed;
+    int result;
+    
+    memset(&state, 0, sizeof(state));
+    state.out = out;
+    state.first_status = STEG_SUCCESS;
+    platform_mutex_init(&state.lock);
+    platform_cond_init(&state.not_empty);
+    platform_cond_init(&state.not_full);
+    
+    if (strcmp(manifest_path, "-") == 0) {
+        manifest = stdin;
+    } else {
+        manifest = fopen(manifest_path, "r");
+        if (!manifest) {
+            fprintf(stderr, "Error: Could not open manifest %s\n", manifest_path);
+            platform_cond_destroy(&state.not_empty);
+            platform_cond_destroy(&state.not_full);
+            platform_mutex_destroy(&state.lock);
+            return STEG_ERROR_IO;
+        }
+    }
+    job.line_no = 0;
+    batch_cancelled = 0;
+    previous_interrupt = signal(SIGINT, batch_interrupt);
+    
+    /* Worker pool with a queue of one pending line per worker; jobs == 1 runs inline */
+    if (jobs == 0) {
+        jobs = batch_default_jobs();
+    }
+    if (jobs > BATCH_MAX_JOBS) {
+        jobs = BATCH_MAX_JOBS;
+    }
+    if (jobs > 1) {
+        state.capacity = jobs;
+        state.slots = (BatchJob *)malloc(sizeof(BatchJob) * state.capacity);
+        threads = (PlatformThread *)malloc(sizeof(PlatformThread) * jobs);
+        if (state.slots && threads) {
+            workers = start_workers(&state, threads, jobs);
+        }
+        if (workers == 0) {
+            fprintf(stderr, "Warning: Could not start batch workers, running jobs serially\n");
+        }
+    }
+    
+    while (!batch_cancelled && fgets(job.line, sizeof(job.line), manifest)) {
+        size_t len = strlen(job.line);
+        bool complete = (len > 0 && job.line[len - 1] == '\n') || feof(manifest);
+        
+        /* The tail of an overlong line belongs to the job already rejected */
+        if (truncated) {
+            truncated = !complete;
+            continue;
+        }
+        job.line_no++;
+        job.status = STEG_SUCCESS;
+        
+        if (!complete) {
+            fprintf(stderr, "Error: Manifest line %lu is too long\n", job.line_no);
+            job.status = STEG_ERROR_ARGS;
+            truncated = true;
+        } else if (is_blank_line(job.line)) {
+            continue;
+        }
+        
+        if (workers) {
+            queue_push(&state, &job);
+        } else {
+            report_job(&state, job.line_no, run_job(&job));
+        }
+    }
+    
+    read_failed = ferror(manifest) != 0;
+    if (read_failed) {
+        fprintf(stderr, "Error: Failed to read manifest\n");
+    }
+    
+    /* Drain the queue and wait for every worker */
+    if (workers) {
+        queue_close(&state);
+        for (i = 0; i < workers; i++) {
+            platform_thread_join(threads[i]);
+        }
+    }
+    free(threads);
+    free(state.slots);
+    if (manifest != stdin) {
+        fclose(manifest);
+    }
+    
+    if (previous_interrupt != SIG_ERR) {
+        signal(SIGINT, previous_interrupt);
+    }
+    
+    result = state.first_status;
+    if (result == STEG_SUCCESS && read_failed) {
+        result = STEG_ERROR_IO;
+    }
+    
+    /* Lines left unread after an interrupt are not reported */
+    if (batch_cancelled) {
+        fprintf(stderr, "Error: Batch interrupted\n");
+        if (result == STEG_SUCCESS) {
+            result = STEG_ERROR_CANCELLED;
+        }
+    }
+    platform_cond_destroy(&state.not_empty);
+    platform_cond_destroy(&state.not_full);
+    platform_mutex_destroy(&state.lock);
+    return result;
+}
@@ -0,0 +1,507 @@
+#include "steg.h"
+#include "cipher.h"
+#include "kernel.h"
+#include "pool.h"
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Megapixels of the default cover sweep */
+static const double default_sizes[] = { 0.1, 1.0, 10.0, 100.0 };
+
+/* Payload sweep: these fractions of the cover's capacity, the last one filling it */
+static const unsigned payload_divisors[] = { 64, 8, 2, 1 };
+
+#define BENCH_MAX_SIZES 16
+#define BENCH_DEFAULT_REPS 3
+
+/* One synthetic cover: a native WIC layout (BGR or BGRA) that both backends encode */
+typedef struct {
+    const char *layout;
+    StegPixelFormat format;
+    uint32_t width;
+    uint32_t height;
+    size_t rowbytes;
+    uint8_t *pixels;            /* Tight plane, modified by the pixel and kernel stages */
+    uint8_t *png;               /* The plane encoded with the selected profile */
+    size_t png_size;
+    size_t capacity;            /* Largest payload under the embed options */
+} BenchCover;
+
+typedef struct {
+    StegPngProfile profile;
+    unsigned reps;
+    StegOptions options;        /* Embed options of the pixels and end-to-end stages */
+} BenchConfig;
+
+static void show_usage(void) {
+    fprintf(stderr, "PNG LSB Steganography Benchmark\n"
+                    "Usage:\n"
+                    "  pxpl-bench [--sizes MP[,MP]...] [--reps N] [--png-profile fast|balanced|small]\n"
+                    "             [--depth 1-4] [--seed N] [--key K] [--compress off|on|auto]\n"
+                    "  --sizes lists the cover sizes in megapixels (default 0.1,1,10,100)\n"
+                    "  --reps runs every case N times and keeps the fastest (default 3)\n"
+                    "  --depth, --seed, --key and --compress apply to the pixels and end-to-end stages\n"
+                    "Synthetic BGR and BGRA covers are built in memory and payloads of 1/64, 1/8, 1/2\n"
+                    "and all of their capacity are timed through each stage:\n"
+                    "  kernel-embed, kernel-extract   one LSB kernel variant on one thread\n"
+                    "  pixels-embed, pixels-extract   steg_*_pixels per variant, inline and on the pool\n"
+                    "  decode, encode                 the PNG codec alone over the whole cover\n"
+                    "  embed, extract                 steg_*_mem end to end\n"
+                    "Prints one tab-separated line per case on stdout:\n"
+                    "  <stage> <variant> <layout> <megapixels> <bytes> <threads> <ns> <MB/s> <ns/bit>\n"
+                    "  bytes are payload bytes, or pixel plane bytes for decode and encode\n");
+}
+
+/* Deterministic noise so runs are comparable */
+static uint32_t bench_random(uint32_t *state) {
+    uint32_t x = *state;
+    
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static void bench_fill(uint8_t *data, size_t size, uint32_t seed) {
+    uint32_t state = seed | 1;
+    
+    for (size_t i = 0; i < size; i++) {
+        data[i] = (uint8_t)(bench_random(&state) >> 24);
+    }
+}
+
+/* One result line; a case that moves no bytes reports no rate */
+static void bench_report(const char *stage, const char *variant, const BenchCover *cover, size_t bytes,
+                         unsigned threads, uint64_t ns) {
+    double mp = (double)cover->width * cover->height / 1e6;
+    
+    printf("%s\t%s\t%s\t%.2f\t%llu\t%u\t%llu\t%.1f\t%.3f\n", stage, variant, cover->layout, mp,
+           (unsigned long long)bytes, threads, (unsigned long long)ns,
+           ns && bytes ? (double)bytes * 1000.0 / (double)ns : 0.0,
+           bytes ? (double)ns / ((double)bytes * 8.0) : 0.0);
+    fflush(stdout);
+}
+
+/* Encode the cover plane band by band into memory; the PNG is released with free() */
+static bool bench_encode(const BenchCover *cover, StegPngProfile profile, uint8_t **png, size_t *png_size) {
+    ImageInfo source;
+    ImageInfo out = {0};
+    uint32_t y, count;
+    bool success = false;
+    
+    if (!image_open_pixels(&source, cover->pixels, cover->width, cover->height, cover->rowbytes,
+                           cover->format)) {
+        return false;
+    }
+    
+    /* Encoder plane of about STEG_BAND_BYTES, like the embed loop uses */
+    source.png_profile = (uint8_t)profile;
+    source.band_capacity = (uint32_t)(STEG_BAND_BYTES / cover->rowbytes) & ~7u;
+    if (source.band_capacity < 8) {
+        source.band_capacity = 8;
+    }
+    if (source.band_capacity > cover->height) {
+        source.band_capacity = cover->height;
+    }
+    if (!image_open_write(NULL, &out, &source)) {
+        goto cleanup;
+    }
+    for (y = 0; y < cover->height; y += count) {
+        count = cover->height - y < out.band_capacity ? cover->height - y : out.band_capacity;
+        memcpy(out.pixels, cover->pixels + (size_t)y * cover->rowbytes, (size_t)count * cover->rowbytes);
+        if (!image_write_rows(&out, count)) {
+            goto cleanup;
+        }
+    }
+    success = image_finalize_write(&out) && image_encoded_data(&out, png, png_size);
+    
+cleanup:
+    image_close(&out);
+    image_close(&source);
+    return success;
+}
+
+/* Decode every row of an encoded cover in bands */
+static bool bench_decode(const BenchCover *cover) {
+    ImageInfo in;
+    uint32_t y, count;
+    bool success = true;
+    
+    if (!image_open_stream_mem(cover->png, cover->png_size, &in, 0)) {
+        return false;
+    }
+    for (y = 0; y < in.height && success; y += count) {
+        count = in.height - y < in.band_capacity ? in.height - y : in.band_capacity;
+        success = image_read_rows(&in, y, count);
+    }
+    image_close(&in);
+    return success;
+}
+
+/* Build a cover of about mp megapixels at 4:3: a smooth gradient with a little noise, so
+   the PNG stages see photo-like compression rather than pure noise */
+static bool bench_cover_init(BenchCover *cover, double mp, bool alpha, const BenchConfig *config) {
+    ImageInfo info;
+    uint64_t pixels = (uint64_t)(mp * 1e6);
+    uint32_t state = 0x9E3779B9u;
+    unsigned channels = alpha ? 4 : 3;
+    unsigned depth = config->options.depth ? config->options.depth : 1;
+    uint8_t *p;
+    
+    memset(cover, 0, sizeof(*cover));
+    cover->layout = alpha ? "bgra" : "bgr";
+    cover->format = alpha ? STEG_PIXELS_BGRA32 : STEG_PIXELS_BGR24;
+    while ((uint64_t)cover->width * cover->width * 3 < pixels * 4) {
+        cover->width++;
+    }
+    cover->height = cover->width ? (uint32_t)(pixels / cover->width) : 0;
+    if (cover->width < 8 || cover->height < 8) {
+        fprintf(stderr, "Error: Cover of %.3f MP is too small\n", mp);
+        return false;
+    }
+    cover->rowbytes = (size_t)cover->width * channels;
+    cover->pixels = (uint8_t *)malloc(cover->rowbytes * cover->height);
+    if (!cover->pixels) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return false;
+    }
+    
+    for (uint32_t y = 0; y < cover->height; y++) {
+        p = cover->pixels + (size_t)y * cover->rowbytes;
+        for (uint32_t x = 0; x < cover->width; x++, p += channels) {
+            unsigned base = (unsigned)(((uint64_t)x * 160 / cover->width) + ((uint64_t)y * 80 / cover->height));
+            
+            for (unsigned c = 0; c < 3; c++) {
+                p[c] = (uint8_t)(base + c * 8 + (bench_random(&state) >> 29));
+            }
+            if (alpha) {
+                p[3] = 255;
+            }
+        }
+    }
+    
+    if (!image_open_pixels(&info, cover->pixels, cover->width, cover->height, cover->rowbytes, cover->format)) {
+        return false;
+    }
+    cover->capacity = info.capacity * depth > STEG_CRC_BITS ? (info.capacity * depth - STEG_CRC_BITS) / 8 : 0;
+    image_close(&info);
+    if (config->options.key) {
+        cover->capacity = cover->capacity > CIPHER_OVERHEAD ? cover->capacity - CIPHER_OVERHEAD : 0;
+    }
+    if (cover->capacity > UINT32_MAX) {
+        cover->capacity = UINT32_MAX;
+    }
+    
+    if (!bench_encode(cover, config->profile, &cover->png, &cover->png_size)) {
+        fprintf(stderr, "Error: Failed to encode the %.2f MP cover\n", mp);
+        return false;
+    }
+    return true;
+}
+
+static void bench_cover_free(BenchCover *cover) {
+    free(cover->pixels);
+    free(cover->png);
+    memset(cover, 0, sizeof(*cover));
+}
+
+/* Kernel variants: ops on one thread over the plane. A BGR or BGRA group is 8 pixels
+   holding 3 payload bytes. */
+static bool bench_kernels(const BenchCover *cover, const uint8_t *payload, uint8_t *scratch,
+                          const BenchConfig *config) {
+    const StegKernelVariant variants[] = { STEG_KERNEL_SCALAR, STEG_KERNEL_SSE2, STEG_KERNEL_AVX2, STEG_KERNEL_NEON };
+    size_t groups_max = (size_t)cover->width * cover->height / 8;
+    const StegKernelOps *ops;
+    LsbEmbedFn embed;
+    LsbExtractFn extract;
+    uint64_t start, ns, best_embed, best_extract;
+    size_t groups;
+    
+    for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v++) {
+        ops = steg_kernel_ops(variants[v]);
+        if (!ops) {
+            continue;
+        }
+        embed = cover->format == STEG_PIXELS_BGRA32 ? ops->embed_bgra : ops->embed_bgr;
+        extract = cover->format == STEG_PIXELS_BGRA32 ? ops->extract_bgra : ops->extract_bgr;
+        for (size_t d = 0; d < sizeof(payload_divisors) / sizeof(payload_divisors[0]); d++) {
+            groups = groups_max / payload_divisors[d];
+            if (groups == 0) {
+                continue;
+            }
+            best_embed = best_extract = UINT64_MAX;
+            for (unsigned r = 0; r < config->reps; r++) {
+                start = platform_time_ns();
+                embed(cover->pixels, payload, groups);
+                ns = platform_time_ns() - start;
+                best_embed = ns < best_embed ? ns : best_embed;
+                
+                start = platform_time_ns();
+                extract(cover->pixels, scratch, groups);
+                ns = platform_time_ns() - start;
+                best_extract = ns < best_extract ? ns : best_extract;
+            }
+            if (memcmp(payload, scratch, groups * 3) != 0) {
+                fprintf(stderr, "Error: %s kernel round trip differs\n", ops->name);
+                return false;
+            }
+            bench_report("kernel-embed", ops->name, cover, groups * 3, 1, best_embed);
+            bench_report("kernel-extract", ops->name, cover, groups * 3, 1, best_extract);
+        }
+    }
+    return true;
+}
+
+/* steg_embed_pixels_ex/steg_extract_pixels_ex with each kernel variant, inline and on the pool */
+static bool bench_pixels(const BenchCover *cover, const uint8_t *payload, const BenchConfig *config) {
+    const StegKernelVariant variants[] = { STEG_KERNEL_SCALAR, STEG_KERNEL_SSE2, STEG_KERNEL_AVX2, STEG_KERNEL_NEON };
+    uint8_t *out;
+    size_t out_size, size;
+    uint64_t start, ns, best_embed, best_extract;
+    unsigned threads;
+    bool success = true;
+    
+    for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]) && success; v++) {
+        if (!steg_kernel_select(variants[v])) {
+            continue;
+        }
+        for (int parallel = 0; parallel < 2 && success; parallel++) {
+            pool_set_thread_parallel(parallel != 0);
+            threads = pool_threads();
+            if (parallel && threads == 1) {
+                continue;
+            }
+            for (size_t d = 0; d < sizeof(payload_divisors) / sizeof(payload_divisors[0]) && success; d++) {
+                size = cover->capacity / payload_divisors[d];
+                best_embed = best_extract = UINT64_MAX;
+                for (unsigned r = 0; r < config->reps && success; r++) {
+                    start = platform_time_ns();
+                    success = steg_embed_pixels_ex(cover->pixels, cover->width, cover->height, cover->rowbytes,
+                                                   cover->format, payload, size, &config->options);
+                    ns = platform_time_ns() - start;
+                    best_embed = ns < best_embed ? ns : best_embed;
+                    
+                    start = platform_time_ns();
+                    success = success && steg_extract_pixels_ex(cover->pixels, cover->width, cover->height,
+                                                                cover->rowbytes, cover->format, &out, &out_size,
+                                                                &config->options);
+                    ns = platform_time_ns() - start;
+                    best_extract = ns < best_extract ? ns : best_extract;
+                    if (success) {
+                        success = out_size == size && memcmp(out, payload, size) == 0;
+                        steg_free(out, out_size);
+                    }
+                }
+                if (!success) {
+                    fprintf(stderr, "Error: %s pixel round trip failed\n", steg_kernel_active()->name);
+                    break;
+                }
+                bench_report("pixels-embed", steg_kernel_active()->name, cover, size, threads, best_embed);
+                bench_report("pixels-extract", steg_kernel_active()->name, cover, size, threads, best_extract);
+            }
+        }
+    }
+    pool_set_thread_parallel(true);
+    steg_kernel_select(STEG_KERNEL_AUTO);
+    return success;
+}
+
+/* The PNG codec alone, then steg_embed_mem_ex/steg_extract_mem_ex with the detected kernel */
+static bool bench_codec(const BenchCover *cover, const uint8_t *payload, const BenchConfig *config) {
+    const char *const profile_names[] = { "fast", "balanced", "small" };
+    const char *variant = steg_kernel_active()->name;
+    size_t plane = cover->rowbytes * cover->height;
+    unsigned threads = pool_threads();
+    uint8_t *png, *steg, *out;
+    size_t png_size, steg_size, out_size, size;
+    uint64_t start, ns, best_decode = UINT64_MAX, best_encode = UINT64_MAX, best_embed, best_extract;
+    bool success = true;
+    
+    for (unsigned r = 0; r < config->reps && success; r++) {
+        start = platform_time_ns();
+        success = bench_decode(cover);
+        ns = platform_time_ns() - start;
+        best_decode = ns < best_decode ? ns : best_decode;
+        
+        start = platform_time_ns();
+        success = success && bench_encode(cover, config->profile, &png, &png_size);
+        ns = platform_time_ns() - start;
+        best_encode = ns < best_encode ? ns : best_encode;
+        if (success) {
+            free(png);
+        }
+    }
+    if (!success) {
+        fprintf(stderr, "Error: PNG codec stage failed\n");
+        return false;
+    }
+    bench_report("decode", variant, cover, plane, 1, best_decode);
+    bench_report("encode", profile_names[config->profile], cover, plane, 1, best_encode);
+    
+    for (size_t d = 0; d < sizeof(payload_divisors) / sizeof(payload_divisors[0]) && success; d++) {
+        size = cover->capacity / payload_divisors[d];
+        best_embed = best_extract = UINT64_MAX;
+        for (unsigned r = 0; r < config->reps && success; r++) {
+            start = platform_time_ns();
+            success = steg_embed_mem_ex(cover->png, cover->png_size, payload, size, &steg, &steg_size,
+                                        &config->options);
+            ns = platform_time_ns() - start;
+            best_embed = ns < best_embed ? ns : best_embed;
+            if (!success) {
+                break;
+            }
+            
+            start = platform_time_ns();
+            success = steg_extract_mem_ex(steg, steg_size, &out, &out_size, &config->options);
+            ns = platform_time_ns() - start;
+            best_extract = ns < best_extract ? ns : best_extract;
+            if (success) {
+                success = out_size == size && memcmp(out, payload, size) == 0;
+                steg_free(out, out_size);
+            }
+            free(steg);
+        }
+        if (!success) {
+            fprintf(stderr, "Error: End-to-end round trip failed\n");
+            break;
+        }
+        bench_report("embed", variant, cover, size, threads, best_embed);
+        bench_report("extract", variant, cover, size, threads, best_extract);
+    }
+    return success;
+}
+
+/* Comma-separated megapixel list */
+static size_t parse_sizes(const char *list, double *sizes) {
+    size_t count = 0;
+    char *end;
+    
+    while (*list && count < BENCH_MAX_SIZES) {
+        sizes[count] = strtod(list, &end);
+        if (end == list || sizes[count] <= 0.0 || (*end != ',' && *end != '\0')) {
+            return 0;
+        }
+        count++;
+        list = *end ? end + 1 : end;
+    }
+    return *list ? 0 : count;
+}
+
+int main(int argc, char **argv) {
+    BenchConfig config = { STEG_PNG_FAST, BENCH_DEFAULT_REPS, { 0 } };
+    double sizes[BENCH_MAX_SIZES];
+    size_t size_count = sizeof(default_sizes) / sizeof(default_sizes[0]);
+    BenchCover cover;
+    uint8_t *payload = NULL, *scratch = NULL;
+    size_t bytes;
+    char *end;
+    unsigned long reps;
+    int status = STEG_SUCCESS;
+    
+    memcpy(sizes, default_sizes, sizeof(default_sizes));
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            show_usage();
+            return STEG_ERROR_ARGS;
+        }
+        if (strcmp(argv[i], "--sizes") == 0) {
+            size_count = parse_sizes(argv[++i], sizes);
+            if (size_count == 0) {
+                fprintf(stderr, "Error: --sizes expects megapixel values separated by commas\n");
+                return STEG_ERROR_ARGS;
+            }
+        } else if (strcmp(argv[i], "--reps") == 0) {
+            reps = strtoul(argv[++i], &end, 10);
+            if (*end != '\0' || reps == 0 || reps > 1000) {
+                fprintf(stderr, "Error: --reps expects 1-1000\n");
+                return STEG_ERROR_ARGS;
+            }
+            config.reps = (unsigned)reps;
+        } else if (strcmp(argv[i], "--png-profile") == 0) {
+            i++;
+            if (strcmp(argv[i], "fast") == 0) {
+                config.profile = STEG_PNG_FAST;
+            } else if (strcmp(argv[i], "balanced") == 0) {
+                config.profile = STEG_PNG_BALANCED;
+            } else if (strcmp(argv[i], "small") == 0) {
+                config.profile = STEG_PNG_SMALL;
+            } else {
+                fprintf(stderr, "Error: Unknown PNG profile '%s' (fast, balanced or small)\n", argv[i]);
+                return STEG_ERROR_ARGS;
+            }
+        } else if (strcmp(argv[i], "--depth") == 0) {
+            reps = strtoul(argv[++i], &end, 10);
+            if (*end != '\0' || reps < 1 || reps > STEG_MAX_DEPTH) {
+                fprintf(stderr, "Error: --depth expects 1 to %d\n", STEG_MAX_DEPTH);
+                return STEG_ERROR_ARGS;
+            }
+            config.options.depth = (uint8_t)reps;
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            config.options.seed = strtoull(argv[++i], &end, 0);
+            if (end == argv[i] || *end != '\0' || *argv[i] == '-') {
+                fprintf(stderr, "Error: --seed expects a number from 0 to 2^64 - 1\n");
+                return STEG_ERROR_ARGS;
+            }
+            config.options.scatter = true;
+        } else if (strcmp(argv[i], "--key") == 0) {
+            config.options.key = argv[++i];
+        } else if (strcmp(argv[i], "--compress") == 0) {
+            i++;
+            if (strcmp(argv[i], "off") == 0) {
+                config.options.compress = STEG_COMPRESS_OFF;
+            } else if (strcmp(argv[i], "on") == 0) {
+                config.options.compress = STEG_COMPRESS_ON;
+            } else if (strcmp(argv[i], "auto") == 0) {
+                config.options.compress = STEG_COMPRESS_AUTO;
+            } else {
+                fprintf(stderr, "Error: --compress expects off, on or auto\n");
+                return STEG_ERROR_ARGS;
+            }
+        } else {
+            show_usage();
+            return STEG_ERROR_ARGS;
+        }
+    }
+    config.options.png_profile = config.profile;
+    
+    if (!steg_runtime_init()) {
+        return STEG_ERROR_IO;
+    }
+    printf("stage\tvariant\tlayout\tmegapixels\tbytes\tthreads\tns\tmb_per_s\tns_per_bit\n");
+    for (size_t s = 0; s < size_count && status == STEG_SUCCESS; s++) {
+        for (int alpha = 0; alpha < 2 && status == STEG_SUCCESS; alpha++) {
+            if (!bench_cover_init(&cover, sizes[s], alpha != 0, &config)) {
+                bench_cover_free(&cover);
+                status = STEG_ERROR_IO;
+                break;
+            }
+            
+            /* The largest payload of either stage: a full cover, or every kernel group */
+            bytes = (size_t)cover.width * cover.height / 8 * 3;
+            bytes = cover.capacity > bytes ? cover.capacity : bytes;
+            payload = (uint8_t *)malloc(bytes);
+            scratch = (uint8_t *)malloc(bytes);
+            if (!payload || !scratch) {
+                fprintf(stderr, "Error: Memory allocation failed\n");
+                status = STEG_ERROR_IO;
+            } else {
+                bench_fill(payload, bytes, (uint32_t)cover.capacity);
+                if (!bench_kernels(&cover, payload, scratch, &config) ||
+                    !bench_pixels(&cover, payload, &config) ||
+                    !bench_codec(&cover, payload, &config)) {
+                    status = steg_last_error() != STEG_SUCCESS ? steg_last_error() : STEG_ERROR_IO;
+                }
+            }
+            free(payload);
+            free(scratch);
+            payload = scratch = NULL;
+            bench_cover_free(&cover);
+        }
+    }
+    
+    steg_runtime_shutdown();
+    return status;
+}
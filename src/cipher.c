@@ -0,0 +1,210 @@
+#include "cipher.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Derive the key from the prefix fields and start the GCM state */
+static bool cipher_stream_key(CipherStream *stream, const char *passphrase, bool encrypt) {
+    uint8_t key[CIPHER_KEY_BYTES];
+    uint32_t iterations = (uint32_t)stream->prefix[CIPHER_SALT_BYTES] |
+                          ((uint32_t)stream->prefix[CIPHER_SALT_BYTES + 1] << 8) |
+                          ((uint32_t)stream->prefix[CIPHER_SALT_BYTES + 2] << 16) |
+                          ((uint32_t)stream->prefix[CIPHER_SALT_BYTES + 3] << 24);
+    
+    /* Bound the work a crafted image can ask for */
+    if (iterations == 0 || iterations > CIPHER_KDF_MAX_ITERATIONS) {
+        fprintf(stderr, "Error: Invalid key derivation parameters\n");
+        return false;
+    }
+    if (!cipher_pbkdf2(passphrase, stream->prefix, iterations, key)) {
+        fprintf(stderr, "Error: Key derivation failed\n");
+        return false;
+    }
+    stream->gcm = cipher_gcm_begin(key, stream->prefix + CIPHER_SALT_BYTES + 4,
+                                   stream->aad, stream->aad_size, encrypt);
+    
+    /* Security: the GCM state keeps its own key schedule */
+    memset(key, 0, sizeof(key));
+    if (!stream->gcm) {
+        fprintf(stderr, "Error: Could not start AES-GCM\n");
+        return false;
+    }
+    return true;
+}
+
+static bool cipher_stream_init(CipherStream *stream, const uint8_t *aad, size_t aad_size) {
+    memset(stream, 0, sizeof(*stream));
+    if (aad_size > sizeof(stream->aad)) {
+        return false;
+    }
+    memcpy(stream->aad, aad, aad_size);
+    stream->aad_size = aad_size;
+    return true;
+}
+
+bool cipher_seal_begin(CipherStream *stream, const char *passphrase, const uint8_t *aad,
+                       size_t aad_size, const uint8_t *plain, size_t plain_size) {
+    if (!cipher_stream_init(stream, aad, aad_size)) {
+        return false;
+    }
+    if (!cipher_random(stream->prefix, CIPHER_SALT_BYTES) ||
+        !cipher_random(stream->prefix + CIPHER_SALT_BYTES + 4, CIPHER_NONCE_BYTES)) {
+        fprintf(stderr, "Error: Could not generate salt and nonce\n");
+        return false;
+    }
+    for (int i = 0; i < 4; i++) {
+        stream->prefix[CIPHER_SALT_BYTES + i] = (uint8_t)(CIPHER_KDF_ITERATIONS >> (i * 8));
+    }
+    stream->plain = plain;
+    stream->data_size = plain_size;
+    return cipher_stream_key(stream, passphrase, true);
+}
+
+bool cipher_seal_read(CipherStream *stream, uint8_t *out, size_t size) {
+    size_t data_end = CIPHER_PREFIX_BYTES + stream->data_size;
+    size_t n, left;
+    
+    while (size) {
+        if (stream->pos < CIPHER_PREFIX_BYTES) {
+            n = CIPHER_PREFIX_BYTES - stream->pos < size ? CIPHER_PREFIX_BYTES - stream->pos : size;
+            memcpy(out, stream->prefix + stream->pos, n);
+        } else if (stream->pos < data_end) {
+            left = stream->data_size - stream->plain_done;
+            if (stream->carry_pos < stream->carry_len) {
+                /* Rest of a block encrypted for the previous chunk */
+                n = stream->carry_len - stream->carry_pos;
+                n = n < size ? n : size;
+                memcpy(out, stream->carry + stream->carry_pos, n);
+                stream->carry_pos += n;
+            } else if (left >= CIPHER_BLOCK_BYTES && size >= CIPHER_BLOCK_BYTES) {
+                /* Whole blocks straight into the chunk */
+                n = (left < size ? left : size) & ~(size_t)(CIPHER_BLOCK_BYTES - 1);
+                if (!cipher_gcm_update(stream->gcm, stream->plain + stream->plain_done, out, n)) {
+                    return false;
+                }
+                stream->plain_done += n;
+            } else {
+                /* A block straddling the chunk end, or the partial last block with the tag */
+                n = left < CIPHER_BLOCK_BYTES ? left : CIPHER_BLOCK_BYTES;
+                if (n == CIPHER_BLOCK_BYTES) {
+                    if (!cipher_gcm_update(stream->gcm, stream->plain + stream->plain_done, stream->carry, n)) {
+                        return false;
+                    }
+                } else {
+                    if (!cipher_gcm_final(stream->gcm, stream->plain + stream->plain_done, stream->carry, n,
+                                          stream->tag)) {
+                        return false;
+                    }
+                    stream->finished = true;
+                }
+                stream->plain_done += n;
+                stream->carry_pos = 0;
+                stream->carry_len = n;
+                continue;
+            }
+        } else {
+            if (!stream->finished) {
+                if (!cipher_gcm_final(stream->gcm, NULL, NULL, 0, stream->tag)) {
+                    return false;
+                }
+                stream->finished = true;
+            }
+            n = data_end + CIPHER_TAG_BYTES - stream->pos;
+            if (n == 0) {
+                return false;
+            }
+            n = n < size ? n : size;
+            memcpy(out, stream->tag + (stream->pos - data_end), n);
+        }
+        stream->pos += n;
+        out += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool cipher_open_begin(CipherStream *stream, const char *passphrase, const uint8_t *aad,
+                       size_t aad_size, size_t sealed_size, CipherSinkFn sink, void *context) {
+    if (sealed_size < CIPHER_OVERHEAD || !cipher_stream_init(stream, aad, aad_size)) {
+        return false;
+    }
+    stream->data_size = sealed_size - CIPHER_OVERHEAD;
+    stream->passphrase = passphrase;
+    stream->sink = sink;
+    stream->sink_context = context;
+    return true;
+}
+
+bool cipher_open_write(CipherStream *stream, uint8_t *data, size_t size) {
+    size_t data_end = CIPHER_PREFIX_BYTES + stream->data_size;
+    size_t n, left;
+    
+    while (size) {
+        if (stream->pos < CIPHER_PREFIX_BYTES) {
+            n = CIPHER_PREFIX_BYTES - stream->pos < size ? CIPHER_PREFIX_BYTES - stream->pos : size;
+            memcpy(stream->prefix + stream->pos, data, n);
+            if (stream->pos + n == CIPHER_PREFIX_BYTES &&
+                !cipher_stream_key(stream, stream->passphrase, false)) {
+                return false;
+            }
+        } else if (stream->pos < data_end) {
+            left = data_end - stream->pos;
+            if (stream->carry_len == 0 && left >= CIPHER_BLOCK_BYTES && size >= CIPHER_BLOCK_BYTES) {
+                /* Whole blocks decrypted in place */
+                n = (left < size ? left : size) & ~(size_t)(CIPHER_BLOCK_BYTES - 1);
+                if (!cipher_gcm_update(stream->gcm, data, data, n) ||
+                    !stream->sink(stream->sink_context, data, n)) {
+                    return false;
+                }
+            } else {
+                /* Gather a block across chunks; a partial last block waits for the tag */
+                n = CIPHER_BLOCK_BYTES - stream->carry_len;
+                n = n < left ? n : left;
+                n = n < size ? n : size;
+                memcpy(stream->carry + stream->carry_len, data, n);
+                stream->carry_len += n;
+                if (stream->carry_len == CIPHER_BLOCK_BYTES) {
+                    if (!cipher_gcm_update(stream->gcm, stream->carry, stream->carry, CIPHER_BLOCK_BYTES) ||
+                        !stream->sink(stream->sink_context, stream->carry, CIPHER_BLOCK_BYTES)) {
+                        return false;
+                    }
+                    stream->carry_len = 0;
+                }
+            }
+        } else {
+            n = data_end + CIPHER_TAG_BYTES - stream->pos;
+            if (n == 0) {
+                return false;
+            }
+            n = n < size ? n : size;
+            memcpy(stream->tag + (stream->pos - data_end), data, n);
+            if (stream->pos + n == data_end + CIPHER_TAG_BYTES) {
+                if (!cipher_gcm_final(stream->gcm, stream->carry, stream->carry, stream->carry_len,
+                                      stream->tag)) {
+                    return false;
+                }
+                if (stream->carry_len && !stream->sink(stream->sink_context, stream->carry, stream->carry_len)) {
+                    return false;
+                }
+                stream->carry_len = 0;
+                stream->verified = true;
+            }
+        }
+        stream->pos += n;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool cipher_open_verified(const CipherStream *stream) {
+    return stream->verified;
+}
+
+void cipher_stream_end(CipherStream *stream) {
+    if (stream->gcm) {
+        cipher_gcm_free(stream->gcm);
+    }
+    
+    /* Security: carried blocks may be plaintext */
+    memset(stream, 0, sizeof(*stream));
+}
@@ -0,0 +1,133 @@
+#include "cipher.h"
+#include <windows.h>
+#include <bcrypt.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+
+/* BCrypt/CNG backend; CNG uses AES-NI and PCLMULQDQ where the CPU has them. GCM runs as
+   chained calls, the last one without the chain flag produces or checks the tag. */
+struct CipherGcm {
+    BCRYPT_ALG_HANDLE alg;
+    BCRYPT_KEY_HANDLE key;
+    BCRYPT_AUTHENTICATED_CIPHER_MODE_INFO info;
+    uint8_t nonce[CIPHER_NONCE_BYTES];
+    uint8_t aad[16];
+    uint8_t mac[CIPHER_TAG_BYTES];
+    uint8_t tag[CIPHER_TAG_BYTES];
+    uint8_t iv[CIPHER_BLOCK_BYTES];
+    bool encrypt;
+};
+
+bool cipher_available(void) {
+    return true;
+}
+
+bool cipher_random(uint8_t *buffer, size_t size) {
+    return size <= ULONG_MAX &&
+           BCRYPT_SUCCESS(BCryptGenRandom(NULL, buffer, (ULONG)size, BCRYPT_USE_SYSTEM_PREFERRED_RNG));
+}
+
+bool cipher_pbkdf2(const char *passphrase, const uint8_t salt[CIPHER_SALT_BYTES], uint32_t iterations,
+                   uint8_t key[CIPHER_KEY_BYTES]) {
+    BCRYPT_ALG_HANDLE hmac = NULL;
+    size_t length = strlen(passphrase);
+    bool ok;
+    
+    if (length > ULONG_MAX ||
+        !BCRYPT_SUCCESS(BCryptOpenAlgorithmProvider(&hmac, BCRYPT_SHA256_ALGORITHM, NULL,
+                                                    BCRYPT_ALG_HANDLE_HMAC_FLAG))) {
+        return false;
+    }
+    ok = BCRYPT_SUCCESS(BCryptDeriveKeyPBKDF2(hmac, (PUCHAR)passphrase, (ULONG)length, (PUCHAR)salt,
+                                              CIPHER_SALT_BYTES, iterations, key, CIPHER_KEY_BYTES, 0));
+    BCryptCloseAlgorithmProvider(hmac, 0);
+    return ok;
+}
+
+CipherGcm *cipher_gcm_begin(const uint8_t key[CIPHER_KEY_BYTES], const uint8_t nonce[CIPHER_NONCE_BYTES],
+                            const uint8_t *aad, size_t aad_size, bool encrypt) {
+    CipherGcm *gcm = calloc(1, sizeof(CipherGcm));
+    
+    if (!gcm || aad_size > sizeof(gcm->aad)) {
+        free(gcm);
+        return NULL;
+    }
+    gcm->encrypt = encrypt;
+    memcpy(gcm->nonce, nonce, CIPHER_NONCE_BYTES);
+    memcpy(gcm->aad, aad, aad_size);
+    if (!BCRYPT_SUCCESS(BCryptOpenAlgorithmProvider(&gcm->alg, BCRYPT_AES_ALGORITHM, NULL, 0)) ||
+        !BCRYPT_SUCCESS(BCryptSetProperty(gcm->alg, BCRYPT_CHAINING_MODE, (PUCHAR)BCRYPT_CHAIN_MODE_GCM,
+                                          sizeof(BCRYPT_CHAIN_MODE_GCM), 0)) ||
+        !BCRYPT_SUCCESS(BCryptGenerateSymmetricKey(gcm->alg, &gcm->key, NULL, 0, (PUCHAR)key,
+                                                   CIPHER_KEY_BYTES, 0))) {
+        cipher_gcm_free(gcm);
+        return NULL;
+    }
+    
+    /* BCrypt takes the AAD with the first chained call */
+    BCRYPT_INIT_AUTH_MODE_INFO(gcm->info);
+    gcm->info.pbNonce = gcm->nonce;
+    gcm->info.cbNonce = CIPHER_NONCE_BYTES;
+    gcm->info.pbAuthData = aad_size ? gcm->aad : NULL;
+    gcm->info.cbAuthData = (ULONG)aad_size;
+    gcm->info.pbTag = gcm->tag;
+    gcm->info.cbTag = CIPHER_TAG_BYTES;
+    gcm->info.pbMacContext = gcm->mac;
+    gcm->info.cbMacContext = CIPHER_TAG_BYTES;
+    gcm->info.dwFlags = BCRYPT_AUTH_MODE_CHAIN_CALLS_FLAG;
+    return gcm;
+}
+
+static bool cipher_gcm_call(CipherGcm *gcm, const uint8_t *in, uint8_t *out, size_t size) {
+    ULONG n = 0;
+    NTSTATUS status;
+    
+    if (size > ULONG_MAX) {
+        return false;
+    }
+    if (gcm->encrypt) {
+        status = BCryptEncrypt(gcm->key, (PUCHAR)in, (ULONG)size, &gcm->info, gcm->iv, sizeof(gcm->iv),
+                               out, (ULONG)size, &n, 0);
+    } else {
+        status = BCryptDecrypt(gcm->key, (PUCHAR)in, (ULONG)size, &gcm->info, gcm->iv, sizeof(gcm->iv),
+                               out, (ULONG)size, &n, 0);
+    }
+    
+    /* AAD already absorbed */
+    gcm->info.pbAuthData = NULL;
+    gcm->info.cbAuthData = 0;
+    return BCRYPT_SUCCESS(status) && n == size;
+}
+
+bool cipher_gcm_update(CipherGcm *gcm, const uint8_t *in, uint8_t *out, size_t size) {
+    return cipher_gcm_call(gcm, in, out, size);
+}
+
+bool cipher_gcm_final(CipherGcm *gcm, const uint8_t *in, uint8_t *out, size_t size,
+                      uint8_t tag[CIPHER_TAG_BYTES]) {
+    if (!gcm->encrypt) {
+        memcpy(gcm->tag, tag, CIPHER_TAG_BYTES);
+    }
+    gcm->info.dwFlags &= ~BCRYPT_AUTH_MODE_CHAIN_CALLS_FLAG;
+    if (!cipher_gcm_call(gcm, in, out, size)) {
+        return false;
+    }
+    if (gcm->encrypt) {
+        memcpy(tag, gcm->tag, CIPHER_TAG_BYTES);
+    }
+    return true;
+}
+
+void cipher_gcm_free(CipherGcm *gcm) {
+    if (gcm) {
+        if (gcm->key) {
+            BCryptDestroyKey(gcm->key);
+        }
+        if (gcm->alg) {
+            BCryptCloseAlgorithmProvider(gcm->alg, 0);
+        }
+        SecureZeroMemory(gcm, sizeof(*gcm));
+        free(gcm);
+    }
+}
@@ -0,0 +1,53 @@
+#include "cipher.h"
+
+/* Built with PXPL_ENCRYPTION=OFF: callers check cipher_available first, the rest fails */
+bool cipher_available(void) {
+    return false;
+}
+
+bool cipher_random(uint8_t *buffer, size_t size) {
+    (void)buffer;
+    (void)size;
+    return false;
+}
+
+bool cipher_pbkdf2(const char *passphrase, const uint8_t salt[CIPHER_SALT_BYTES], uint32_t iterations,
+                   uint8_t key[CIPHER_KEY_BYTES]) {
+    (void)passphrase;
+    (void)salt;
+    (void)iterations;
+    (void)key;
+    return false;
+}
+
+CipherGcm *cipher_gcm_begin(const uint8_t key[CIPHER_KEY_BYTES], const uint8_t nonce[CIPHER_NONCE_BYTES],
+                            const uint8_t *aad, size_t aad_size, bool encrypt) {
+    (void)key;
+    (void)nonce;
+    (void)aad;
+    (void)aad_size;
+    (void)encrypt;
+    return NULL;
+}
+
+bool cipher_gcm_update(CipherGcm *gcm, const uint8_t *in, uint8_t *out, size_t size) {
+    (void)gcm;
+    (void)in;
+    (void)out;
+    (void)size;
+    return false;
+}
+
+bool cipher_gcm_final(CipherGcm *gcm, const uint8_t *in, uint8_t *out, size_t size,
+                      uint8_t tag[CIPHER_TAG_BYTES]) {
+    (void)gcm;
+    (void)in;
+    (void)out;
+    (void)size;
+    (void)tag;
+    return false;
+}
+
+void cipher_gcm_free(CipherGcm *gcm) {
+    (void)gcm;
+}
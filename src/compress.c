@@ -0,0 +1,341 @@
+#include "compress.h"
+#include "pool.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* LZ4 block format limits: matches are at least 4 bytes, the last 5 bytes are literals and
+   the last match starts at least 12 bytes before the end */
+#define LZ4_MIN_MATCH       4
+#define LZ4_LAST_LITERALS   5
+#define LZ4_MF_LIMIT        12
+#define LZ4_HASH_BITS       13
+
+static uint32_t read32(const uint8_t *p) {
+    uint32_t v;
+    
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static void put_le32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = (uint8_t)(v >> (i * 8));
+    }
+}
+
+static uint32_t get_le32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t lz4_hash(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+/* Length continuation bytes of a 4-bit token field that overflowed by extra */
+static size_t lz4_put_length(uint8_t *dst, size_t extra) {
+    size_t n = 0;
+    
+    for (; extra >= 255; extra -= 255) {
+        dst[n++] = 255;
+    }
+    dst[n++] = (uint8_t)extra;
+    return n;
+}
+
+/* Greedy single-probe LZ4 block compression of at most COMPRESS_BLOCK_BYTES, so positions
+   fit the 16-bit table; returns the compressed size, or 0 if it would exceed capacity */
+static size_t lz4_encode(const uint8_t *src, size_t size, uint8_t *dst, size_t capacity) {
+    uint16_t table[1u << LZ4_HASH_BITS];
+    size_t ip = 1, anchor = 0, op = 0;
+    size_t ref, length, literals;
+    uint32_t sequence, h;
+    
+    memset(table, 0, sizeof(table));
+    if (size > LZ4_MF_LIMIT) {
+        size_t limit = size - LZ4_MF_LIMIT;
+        size_t match_limit = size - LZ4_LAST_LITERALS;
+        
+        while (ip < limit) {
+            sequence = read32(src + ip);
+            h = lz4_hash(sequence);
+            ref = table[h];
+            table[h] = (uint16_t)ip;
+            if (read32(src + ref) != sequence) {
+                /* Skip faster through data that does not match */
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+            while (ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1]) {
+                ip--;
+                ref--;
+            }
+            length = LZ4_MIN_MATCH;
+            while (ip + length < match_limit && src[ip + length] == src[ref + length]) {
+                length++;
+            }
+            
+            /* Token, literal run, offset and match length; worst case per 255 of either */
+            literals = ip - anchor;
+            if (op + 1 + literals + literals / 255 + 1 + 2 + (length - LZ4_MIN_MATCH) / 255 + 1 > capacity) {
+                return 0;
+            }
+            dst[op] = (uint8_t)((literals < 15 ? literals : 15) << 4);
+            dst[op] |= (uint8_t)(length - LZ4_MIN_MATCH < 15 ? length - LZ4_MIN_MATCH : 15);
+            op++;
+            if (literals >= 15) {
+                op += lz4_put_length(dst + op, literals - 15);
+            }
+            memcpy(dst + op, src + anchor, literals);
+            op += literals;
+            dst[op++] = (uint8_t)(ip - ref);
+            dst[op++] = (uint8_t)((ip - ref) >> 8);
+            if (length - LZ4_MIN_MATCH >= 15) {
+                op += lz4_put_length(dst + op, length - LZ4_MIN_MATCH - 15);
+            }
+            
+            ip += length;
+            anchor = ip;
+            if (ip - 2 < limit) {
+                table[lz4_hash(read32(src + ip - 2))] = (uint16_t)(ip - 2);
+            }
+        }
+    }
+    
+    /* The block ends on a literal run */
+    literals = size - anchor;
+    if (op + 1 + literals + literals / 255 + 1 > capacity) {
+        return 0;
+    }
+    dst[op++] = (uint8_t)((literals < 15 ? literals : 15) << 4);
+    if (literals >= 15) {
+        op += lz4_put_length(dst + op, literals - 15);
+    }
+    memcpy(dst + op, src + anchor, literals);
+    return op + literals;
+}
+
+/* Add length continuation bytes to *length; false past the end of src */
+static bool lz4_get_length(const uint8_t *src, size_t size, size_t *ip, size_t *length) {
+    unsigned b;
+    
+    do {
+        if (*ip >= size) {
+            return false;
+        }
+        b = src[(*ip)++];
+        *length += b;
+    } while (b == 255);
+    return true;
+}
+
+/* Decode one LZ4 block that must expand to exactly out_size bytes; every length and offset
+   is checked, so malformed input fails instead of reading or writing out of bounds */
+static bool lz4_decode(const uint8_t *src, size_t size, uint8_t *dst, size_t out_size) {
+    size_t ip = 0, op = 0;
+    size_t literals, length, offset;
+    unsigned token;
+    
+    for (;;) {
+        if (ip >= size) {
+            return false;
+        }
+        token = src[ip++];
+        literals = token >> 4;
+        if (literals == 15 && !lz4_get_length(src, size, &ip, &literals)) {
+            return false;
+        }
+        if (literals > size - ip || literals > out_size - op) {
+            return false;
+        }
+        memcpy(dst + op, src + ip, literals);
+        ip += literals;
+        op += literals;
+        if (ip == size) {
+            return op == out_size;
+        }
+        
+        if (size - ip < 2) {
+            return false;
+        }
+        offset = (size_t)src[ip] | ((size_t)src[ip + 1] << 8);
+        ip += 2;
+        length = token & 15;
+        if (length == 15 && !lz4_get_length(src, size, &ip, &length)) {
+            return false;
+        }
+        length += LZ4_MIN_MATCH;
+        if (offset == 0 || offset > op || length > out_size - op) {
+            return false;
+        }
+        
+        /* A match may overlap its own output (runs), which then repeats byte by byte */
+        if (offset >= length) {
+            memcpy(dst + op, dst + op - offset, length);
+        } else {
+            for (size_t i = 0; i < length; i++) {
+                dst[op + i] = dst[op + i - offset];
+            }
+        }
+        op += length;
+    }
+}
+
+size_t compress_bound(size_t size) {
+    size_t blocks = (size + COMPRESS_BLOCK_BYTES - 1) / COMPRESS_BLOCK_BYTES;
+    
+    /* Room for every block at its raw size while they are packed in parallel */
+    return COMPRESS_PREFIX_BYTES + blocks * (4 + (size_t)COMPRESS_BLOCK_BYTES);
+}
+
+typedef struct {
+    const uint8_t *src;
+    size_t size;
+    uint8_t *dst;
+} PackJob;
+
+/* Pack block index into its fixed slot at dst; a block that does not shrink is kept raw */
+static void pack_task(void *context, size_t index) {
+    const PackJob *job = (const PackJob *)context;
+    size_t lo = index * COMPRESS_BLOCK_BYTES;
+    size_t n = job->size - lo < COMPRESS_BLOCK_BYTES ? job->size - lo : COMPRESS_BLOCK_BYTES;
+    uint8_t *slot = job->dst + COMPRESS_PREFIX_BYTES + index * (4 + (size_t)COMPRESS_BLOCK_BYTES);
+    size_t packed = lz4_encode(job->src + lo, n, slot + 4, n - 1);
+    
+    if (packed) {
+        put_le32(slot, (uint32_t)packed);
+    } else {
+        put_le32(slot, (uint32_t)n | COMPRESS_RAW_FLAG);
+        memcpy(slot + 4, job->src + lo, n);
+    }
+}
+
+size_t compress_pack(const uint8_t *src, size_t size, uint8_t *dst) {
+    PackJob job;
+    size_t blocks = (size + COMPRESS_BLOCK_BYTES - 1) / COMPRESS_BLOCK_BYTES;
+    size_t out = COMPRESS_PREFIX_BYTES, length;
+    const uint8_t *slot;
+    
+    job.src = src;
+    job.size = size;
+    job.dst = dst;
+    put_le32(dst, (uint32_t)size);
+    pool_run(pack_task, &job, blocks);
+    
+    /* Close the gaps between slots; packed blocks only move down */
+    for (size_t i = 0; i < blocks; i++) {
+        slot = dst + COMPRESS_PREFIX_BYTES + i * (4 + (size_t)COMPRESS_BLOCK_BYTES);
+        length = 4 + (get_le32(slot) & ~COMPRESS_RAW_FLAG);
+        memmove(dst + out, slot, length);
+        out += length;
+    }
+    return out;
+}
+
+bool compress_unpack_begin(CompressStream *stream, CompressSinkFn sink, void *context) {
+    memset(stream, 0, sizeof(*stream));
+    stream->sink = sink;
+    stream->sink_context = context;
+    stream->in = (uint8_t *)malloc(COMPRESS_BLOCK_BYTES);
+    stream->out = (uint8_t *)malloc(COMPRESS_BLOCK_BYTES);
+    return stream->in && stream->out;
+}
+
+static bool unpack_fail(CompressStream *stream) {
+    stream->failed = true;
+    return false;
+}
+
+bool compress_unpack_write(CompressStream *stream, const uint8_t *data, size_t size) {
+    size_t n, block_out;
+    uint32_t word;
+    
+    if (stream->failed) {
+        return false;
+    }
+    while (size) {
+        if (stream->block_size == 0) {
+            /* Size prefix, then a word in front of each block */
+            n = 4 - stream->word_got < size ? 4 - stream->word_got : size;
+            memcpy(stream->word + stream->word_got, data, n);
+            stream->word_got += n;
+            data += n;
+            size -= n;
+            if (stream->word_got < 4) {
+                break;
+            }
+            stream->word_got = 0;
+            word = get_le32(stream->word);
+            if (!stream->have_size) {
+                stream->size = word;
+                stream->have_size = true;
+                continue;
+            }
+            if (stream->done == stream->size) {
+                return unpack_fail(stream);
+            }
+            stream->block_raw = (word & COMPRESS_RAW_FLAG) != 0;
+            stream->block_size = word & ~COMPRESS_RAW_FLAG;
+            stream->block_got = 0;
+            block_out = stream->size - stream->done;
+            block_out = block_out < COMPRESS_BLOCK_BYTES ? block_out : COMPRESS_BLOCK_BYTES;
+            if (stream->block_size == 0 || stream->block_size > block_out ||
+                (stream->block_raw && stream->block_size != block_out)) {
+                return unpack_fail(stream);
+            }
+            continue;
+        }
+        
+        n = stream->block_size - stream->block_got < size ? stream->block_size - stream->block_got : size;
+        if (stream->block_raw) {
+            /* Raw blocks pass straight through */
+            if (!stream->sink(stream->sink_context, data, n)) {
+                return false;
+            }
+            stream->done += n;
+        } else {
+            /* Decoded from the chunk when it holds the whole block, gathered otherwise */
+            const uint8_t *block = data;
+            
+            if (stream->block_got || n < stream->block_size) {
+                memcpy(stream->in + stream->block_got, data, n);
+                block = stream->block_got + n == stream->block_size ? stream->in : NULL;
+            }
+            if (block) {
+                block_out = stream->size - stream->done;
+                block_out = block_out < COMPRESS_BLOCK_BYTES ? block_out : COMPRESS_BLOCK_BYTES;
+                if (!lz4_decode(block, stream->block_size, stream->out, block_out)) {
+                    return unpack_fail(stream);
+                }
+                if (!stream->sink(stream->sink_context, stream->out, block_out)) {
+                    return false;
+                }
+                stream->done += block_out;
+            }
+        }
+        stream->block_got += n;
+        data += n;
+        size -= n;
+        if (stream->block_got == stream->block_size) {
+            stream->block_size = 0;
+        }
+    }
+    return true;
+}
+
+bool compress_unpack_done(const CompressStream *stream) {
+    return !stream->failed && stream->have_size && stream->done == stream->size &&
+           stream->block_size == 0 && stream->word_got == 0;
+}
+
+void compress_unpack_end(CompressStream *stream) {
+    /* Security: the blocks hold payload bytes */
+    if (stream->in) {
+        memset(stream->in, 0, COMPRESS_BLOCK_BYTES);
+        free(stream->in);
+    }
+    if (stream->out) {
+        memset(stream->out, 0, COMPRESS_BLOCK_BYTES);
+        free(stream->out);
+    }
+    memset(stream, 0, sizeof(*stream));
+}
@@ -0,0 +1,122 @@
+#include "crc32c.h"
+#include "kernel.h"
+#include "platform.h"
+#include <stdbool.h>
+#include <string.h>
+
+/* Reflected Castagnoli polynomial */
+#define CRC32C_POLY 0x82F63B78u
+
+typedef uint32_t (*Crc32cFn)(uint32_t crc, const uint8_t *p, size_t size);
+
+/* Slicing-by-8 tables, built on first use */
+static uint32_t crc_table[8][256];
+
+static void crc32c_build_tables(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c >> 1) ^ (CRC32C_POLY & (0u - (c & 1)));
+        }
+        crc_table[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int t = 1; t < 8; t++) {
+            crc_table[t][i] = (crc_table[t - 1][i] >> 8) ^ crc_table[0][crc_table[t - 1][i] & 0xFF];
+        }
+    }
+}
+
+/* Portable path: eight bytes per step through eight table lookups */
+static uint32_t crc32c_slice8(uint32_t crc, const uint8_t *p, size_t size) {
+    for (; size >= 8; size -= 8, p += 8) {
+        uint32_t lo = crc ^ ((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+        uint32_t hi = (uint32_t)p[4] | ((uint32_t)p[5] << 8) | ((uint32_t)p[6] << 16) | ((uint32_t)p[7] << 24);
+        crc = crc_table[7][lo & 0xFF] ^ crc_table[6][(lo >> 8) & 0xFF] ^
+              crc_table[5][(lo >> 16) & 0xFF] ^ crc_table[4][lo >> 24] ^
+              crc_table[3][hi & 0xFF] ^ crc_table[2][(hi >> 8) & 0xFF] ^
+              crc_table[1][(hi >> 16) & 0xFF] ^ crc_table[0][hi >> 24];
+    }
+    for (; size; size--, p++) {
+        crc = (crc >> 8) ^ crc_table[0][(crc ^ *p) & 0xFF];
+    }
+    return crc;
+}
+
+#if STEG_KERNEL_X86 && (defined(_M_X64) || defined(__x86_64__))
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define CRC_TARGET_SSE42
+#else
+#include <cpuid.h>
+#define CRC_TARGET_SSE42 __attribute__((target("sse4.2")))
+#endif
+#include <nmmintrin.h>
+
+/* SSE4.2 crc32 instruction, eight bytes at a time */
+CRC_TARGET_SSE42 static uint32_t crc32c_sse42(uint32_t crc, const uint8_t *p, size_t size) {
+    uint64_t c = crc;
+    for (; size >= 8; size -= 8, p += 8) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        c = _mm_crc32_u64(c, v);
+    }
+    crc = (uint32_t)c;
+    for (; size; size--, p++) {
+        crc = _mm_crc32_u8(crc, *p);
+    }
+    return crc;
+}
+
+static bool cpu_has_sse42(void) {
+#if defined(_MSC_VER)
+    int r[4];
+    __cpuid(r, 1);
+    return ((uint32_t)r[2] >> 20) & 1;
+#else
+    unsigned int a = 0, b = 0, c = 0, d = 0;
+    return __get_cpuid(1, &a, &b, &c, &d) && ((c >> 20) & 1);
+#endif
+}
+#endif
+
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+
+/* ARMv8 CRC32C instructions (compiled in only when the target guarantees them) */
+static uint32_t crc32c_armv8(uint32_t crc, const uint8_t *p, size_t size) {
+    for (; size >= 8; size -= 8, p += 8) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        crc = __crc32cd(crc, v);
+    }
+    for (; size; size--, p++) {
+        crc = __crc32cb(crc, *p);
+    }
+    return crc;
+}
+#endif
+
+static Crc32cFn crc_impl = NULL;
+static PlatformOnce crc_once = PLATFORM_ONCE_INIT;
+
+static void crc32c_select(void) {
+#if STEG_KERNEL_X86 && (defined(_M_X64) || defined(__x86_64__))
+    if (cpu_has_sse42()) {
+        crc_impl = crc32c_sse42;
+    }
+#endif
+#if defined(__ARM_FEATURE_CRC32)
+    crc_impl = crc32c_armv8;
+#endif
+    if (!crc_impl) {
+        crc32c_build_tables();
+        crc_impl = crc32c_slice8;
+    }
+}
+
+uint32_t crc32c_update(uint32_t crc, const void *data, size_t size) {
+    platform_once(&crc_once, crc32c_select);
+    return ~crc_impl(~crc, (const uint8_t *)data, size);
+}
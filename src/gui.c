@@ -1,4 +1,5 @@
 #include "steg.h"
+#include "platform.h"
 #include <windows.h>
 #include <commdlg.h>
 #include <stdio.h>
@@ -18,6 +19,23 @@
 #define ID_COVER_EDIT       1006
 #define ID_PAYLOAD_EDIT     1007
 #define ID_OUTPUT_EDIT      1008
+#define ID_CANCEL_BUTTON    1009
+
+/* Posted by the worker thread: progress (wParam = StegPhase, lParam = percent) and the
+   end of the operation (wParam = success, lParam = STEG_* code) */
+#define WM_STEG_PROGRESS    (WM_APP + 1)
+#define WM_STEG_DONE        (WM_APP + 2)
+
+/* One embed or extract running on the worker thread */
+typedef struct {
+    bool extract;
+    char image[MAX_PATH];
+    char data[MAX_PATH];
+    char output[MAX_PATH];
+    volatile sig_atomic_t cancel; /* StegOptions.cancel, set by the UI thread */
+    StegPhase last_phase;       /* Last progress posted, so each percent is posted once */
+    int last_percent;
+} GuiJob;
 
 /* Global variables */
 static HWND g_hWnd;
@@ -25,6 +43,9 @@ static HWND g_hCoverEdit, g_hPayloadEdit, g_hOutputEdit;
 static HWND g_hOutputLabel, g_hOutputBrowseBtn;
 static HWND g_hStatus;
 static bool g_extractMode = false;
+static GuiJob g_job;
+static PlatformThread g_worker;
+static bool g_busy = false;
 
 /* Function prototypes */
 LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
@@ -33,6 +54,10 @@ BOOL GetOpenFileName_Custom(HWND hwnd, char* buffer, const char* filter, const c
 BOOL GetSaveFileName_Custom(HWND hwnd, char* buffer, const char* filter, const char* title);
 void OnEmbedClicked(void);
 void OnExtractClicked(void);
+void StartOperation(void);
+void OnOperationDone(bool success, int status);
+void OnProgress(StegPhase phase, int percent);
+void SetBusy(bool busy);
 void UpdateStatus(const char* message);
 void SetMode(bool extractMode);
 
@@ -77,6 +102,9 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     ShowWindow(g_hWnd, nCmdShow);
     UpdateWindow(g_hWnd);
     
+    /* Keep COM and the WIC factory alive for every embed/extract of this session */
+    steg_runtime_init();
+    
     /* Message loop */
     MSG msg;
     while (GetMessage(&msg, NULL, 0, 0)) {
@@ -84,6 +112,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         DispatchMessage(&msg);
     }
     
+    steg_runtime_shutdown();
     return (int)msg.wParam;
 }
 
@@ -132,6 +161,9 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
                     break;
                 }
                 case ID_EMBED_BUTTON:
+                    if (g_busy) {
+                        break;
+                    }
                     if (g_extractMode) {
                         OnExtractClicked();
                     } else {
@@ -141,10 +173,30 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
                 case ID_EXTRACT_BUTTON:
                     SetMode(!g_extractMode);
                     break;
+                case ID_CANCEL_BUTTON:
+                    if (g_busy) {
+                        g_job.cancel = 1;
+                        UpdateStatus("Cancelling...");
+                    }
+                    break;
             }
             break;
             
+        case WM_STEG_PROGRESS:
+            OnProgress((StegPhase)wParam, (int)lParam);
+            break;
+            
+        case WM_STEG_DONE:
+            OnOperationDone(wParam != 0, (int)lParam);
+            break;
+            
         case WM_DESTROY:
+            /* The worker stops at its next row band and removes its partial output */
+            if (g_busy) {
+                g_job.cancel = 1;
+                platform_thread_join(g_worker);
+                g_busy = false;
+            }
             PostQuitMessage(0);
             break;
             
@@ -188,6 +240,8 @@ void CreateControls(HWND hwnd) {
     /* Action buttons */
     CreateWindow("BUTTON", "Embed Data", WS_VISIBLE | WS_CHILD | WS_TABSTOP | BS_DEFPUSHBUTTON,
                 20, y, 120, 30, hwnd, (HMENU)ID_EMBED_BUTTON, NULL, NULL);
+    CreateWindow("BUTTON", "Cancel", WS_VISIBLE | WS_CHILD | WS_TABSTOP | WS_DISABLED,
+                150, y, 120, 30, hwnd, (HMENU)ID_CANCEL_BUTTON, NULL, NULL);
     CreateWindow("BUTTON", "Switch to Extract", WS_VISIBLE | WS_CHILD | WS_TABSTOP,
                 280, y, 140, 30, hwnd, (HMENU)ID_EXTRACT_BUTTON, NULL, NULL);
     y += 45;
@@ -273,15 +327,12 @@ void OnEmbedClicked(void) {
         return;
     }
     
+    g_job.extract = false;
+    strcpy(g_job.image, cover);
+    strcpy(g_job.data, payload);
+    strcpy(g_job.output, output);
     UpdateStatus("Embedding data...");
-    
-    if (steg_embed(cover, payload, output)) {
-        UpdateStatus("Data embedded successfully!");
-        MessageBox(g_hWnd, "Data has been successfully hidden in the image.", "Success", MB_ICONINFORMATION);
-    } else {
-        UpdateStatus("Failed to embed data.");
-        MessageBox(g_hWnd, "Failed to embed data. Check file formats and permissions.", "Error", MB_ICONERROR);
-    }
+    StartOperation();
 }
 
 /* Extract operation */
@@ -296,17 +347,109 @@ void OnExtractClicked(void) {
         return;
     }
     
+    g_job.extract = true;
+    strcpy(g_job.image, steg);
+    strcpy(g_job.data, extract);
+    g_job.output[0] = '\0';
     UpdateStatus("Extracting data...");
+    StartOperation();
+}
+
+/* Progress callback on the worker thread: post each new percent */
+static bool ReportProgress(void *context, const StegProgress *progress) {
+    GuiJob *job = (GuiJob *)context;
+    int percent = progress->rows_total ?
+                  (int)((uint64_t)progress->rows_done * 100 / progress->rows_total) : 100;
+    
+    if (progress->phase != job->last_phase || percent != job->last_percent) {
+        job->last_phase = progress->phase;
+        job->last_percent = percent;
+        PostMessage(g_hWnd, WM_STEG_PROGRESS, (WPARAM)progress->phase, (LPARAM)percent);
+    }
+    return true;
+}
+
+/* Worker thread: runs the job and posts its result to the window */
+static PlatformThreadResult PLATFORM_THREAD_CALL OperationThread(void *param) {
+    GuiJob *job = (GuiJob *)param;
+    StegOptions options = { 0 };
+    bool success;
     
-    if (steg_extract(steg, extract)) {
-        UpdateStatus("Data extracted successfully!");
-        MessageBox(g_hWnd, "Hidden data has been successfully extracted.", "Success", MB_ICONINFORMATION);
+    options.progress = ReportProgress;
+    options.progress_context = job;
+    options.cancel = &job->cancel;
+    if (job->extract) {
+        success = steg_extract_ex(job->image, job->data, &options);
     } else {
+        success = steg_embed_ex(job->image, job->data, job->output, &options);
+    }
+    PostMessage(g_hWnd, WM_STEG_DONE, (WPARAM)success, (LPARAM)(success ? STEG_SUCCESS : steg_last_error()));
+    return 0;
+}
+
+/* Run g_job on the worker thread; the window stays responsive until WM_STEG_DONE */
+void StartOperation(void) {
+    g_job.cancel = 0;
+    g_job.last_phase = STEG_PHASE_DECODE;
+    g_job.last_percent = -1;
+    if (!platform_thread_start(&g_worker, OperationThread, &g_job)) {
+        UpdateStatus("Failed to start the operation.");
+        MessageBox(g_hWnd, "Could not start a worker thread.", "Error", MB_ICONERROR);
+        return;
+    }
+    SetBusy(true);
+}
+
+/* Show the phase and percent of the running operation */
+void OnProgress(StegPhase phase, int percent) {
+    static const char *const names[] = { "Decoding", "Embedding", "Extracting", "Encoding" };
+    char message[64];
+    
+    if (!g_busy || g_job.cancel) {
+        return;
+    }
+    snprintf(message, sizeof(message), "%s... %d%%",
+             (unsigned)phase < sizeof(names) / sizeof(names[0]) ? names[phase] : "Working", percent);
+    UpdateStatus(message);
+}
+
+/* Join the finished worker and report its result */
+void OnOperationDone(bool success, int status) {
+    if (!g_busy) {
+        return;
+    }
+    platform_thread_join(g_worker);
+    SetBusy(false);
+    
+    if (success) {
+        UpdateStatus(g_job.extract ? "Data extracted successfully!" : "Data embedded successfully!");
+        MessageBox(g_hWnd, g_job.extract ? "Hidden data has been successfully extracted." :
+                   "Data has been successfully hidden in the image.", "Success", MB_ICONINFORMATION);
+    } else if (status == STEG_ERROR_CANCELLED) {
+        UpdateStatus("Operation cancelled.");
+    } else if (g_job.extract) {
         UpdateStatus("Failed to extract data.");
         MessageBox(g_hWnd, "Failed to extract data. Image may not contain hidden data.", "Error", MB_ICONERROR);
+    } else {
+        UpdateStatus("Failed to embed data.");
+        MessageBox(g_hWnd, "Failed to embed data. Check file formats and permissions.", "Error", MB_ICONERROR);
     }
 }
 
+/* Lock the inputs while an operation runs; only Cancel stays available */
+void SetBusy(bool busy) {
+    g_busy = busy;
+    EnableWindow(GetDlgItem(g_hWnd, ID_EMBED_BUTTON), !busy);
+    EnableWindow(GetDlgItem(g_hWnd, ID_EXTRACT_BUTTON), !busy);
+    EnableWindow(GetDlgItem(g_hWnd, ID_BROWSE_COVER), !busy);
+    EnableWindow(GetDlgItem(g_hWnd, ID_BROWSE_PAYLOAD), !busy);
+    EnableWindow(GetDlgItem(g_hWnd, ID_BROWSE_OUTPUT), !busy);
+    EnableWindow(g_hCoverEdit, !busy);
+    EnableWindow(g_hPayloadEdit, !busy);
+    EnableWindow(g_hOutputEdit, !busy);
+    EnableWindow(GetDlgItem(g_hWnd, ID_CANCEL_BUTTON), busy);
+}
+
 /* Update status bar */
 void UpdateStatus(const char* message) {
     SetWindowText(g_hStatus, message);
@@ -1,6 +1,33 @@
 #include "steg.h"
+#include "image_backend.h"
+#include "platform.h"
+#include "pool.h"
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+
+/* Pixel plane alignment (cache line, enough for any SIMD load) */
+#define IMAGE_PLANE_ALIGN 64
+
+/* Codec chosen at build time: WIC on Windows unless PXPL_IMAGE_BACKEND=libpng */
+#if defined(_WIN32) && !defined(PXPL_BACKEND_LIBPNG)
+static const ImageBackend *const backend = &image_backend_wic;
+#else
+static const ImageBackend *const backend = &image_backend_libpng;
+#endif
+
+static void image_free_pixels(ImageInfo *info);
+
+bool steg_runtime_init(void) {
+    return backend->runtime_init();
+}
+
+void steg_runtime_shutdown(void) {
+    /* Parallel kernel workers are part of the runtime too; joined first so none is still
+       inside an image call when the codec state goes */
+    pool_shutdown();
+    backend->runtime_shutdown();
+}
 
 /* Calculate capacity in bits for steganography */
 static size_t calculate_capacity(const ImageInfo *info) {
@@ -12,25 +39,102 @@ static size_t calculate_capacity(const ImageInfo *info) {
         usable_channels--;
     }
     
-    /* Calculate bits per channel based on bit depth */
-    uint8_t usable_bits_per_channel = 1; /* We use LSB only for now */
-    
-    /* Total capacity = pixels * usable_channels * usable_bits_per_channel - header */
-    total_bits = (size_t)info->width * info->height * usable_channels * usable_bits_per_channel;
+    /* Total capacity = pixels * usable_channels - header, at one bit per sample; callers
+       embedding several bit planes scale it by their depth (see payload_capacity) */
+    total_bits = (size_t)info->width * info->height * usable_channels;
     
-    /* Reserve 32 bits for payload length header */
-    if (total_bits > 32) {
-        total_bits -= 32;
+    /* Reserve the payload header */
+    if (total_bits > STEG_HEADER_BITS) {
+        total_bits -= STEG_HEADER_BITS;
     } else {
         total_bits = 0;
     }
     
     return total_bits;
-}bool image_open_read(const char *filename, ImageInfo *info) {
-    HRESULT hr;
-    WCHAR wfilename[MAX_PATH];
-    WICPixelFormatGUID pixelFormat;
+}
+
+/* Default band height: about STEG_BAND_BYTES of pixels, a multiple of 8 rows so every
+   band starts on a payload byte boundary */
+static uint32_t image_band_rows(const ImageInfo *info) {
+    size_t rows = info->rowbytes ? STEG_BAND_BYTES / info->rowbytes : 0;
+    
+    rows &= ~(size_t)7;
+    if (rows < 8) {
+        rows = 8;
+    }
+    return rows > UINT32_MAX ? UINT32_MAX : (uint32_t)rows;
+}
+
+/* Allocate one aligned pixel plane of band_capacity rows with row_pointers as views into it */
+static bool image_alloc_pixels(ImageInfo *info) {
+    uint32_t rows = info->band_capacity;
+    size_t size = info->rowbytes * rows;
+    
+    if (size == 0 || size / rows != info->rowbytes || size > UINT_MAX) {
+        return false;
+    }
+    
+    info->pixels = (uint8_t*)platform_aligned_alloc(size, IMAGE_PLANE_ALIGN);
+    info->row_pointers = (uint8_t**)malloc(sizeof(uint8_t*) * rows);
+    if (!info->pixels || !info->row_pointers) {
+        image_free_pixels(info);
+        return false;
+    }
+    
+    for (uint32_t y = 0; y < rows; y++) {
+        info->row_pointers[y] = info->pixels + (size_t)y * info->rowbytes;
+    }
     
+    return true;
+}
+
+/* Release the pixel plane and its row views */
+static void image_free_pixels(ImageInfo *info) {
+    if (info->pixels_borrowed) {
+        /* Owned and released by the ImageInfo it was moved to, or by the caller (tight
+           caller-held pixels, whose row views are ours) */
+        if (info->raw_pixels) {
+            free(info->row_pointers);
+        }
+        info->pixels = NULL;
+        info->row_pointers = NULL;
+        info->pixels_borrowed = false;
+        return;
+    }
+    if (info->pixels) {
+        /* Security: zero the buffer before freeing */
+        memset(info->pixels, 0, info->rowbytes * info->band_capacity);
+        platform_aligned_free(info->pixels);
+        info->pixels = NULL;
+    }
+    free(info->row_pointers);
+    info->row_pointers = NULL;
+}
+
+/* Finish opening a decoded image: geometry-derived fields and the band plane.
+   On failure the decoder is released and info cleared. */
+static bool image_open_decoded(ImageInfo *info, uint32_t band_rows) {
+    info->rowbytes = (size_t)info->width * info->bytes_per_pixel;
+    
+    /* Calculate capacity for steganography after format is determined */
+    info->capacity = calculate_capacity(info);
+    
+    /* Allocate the pixel plane for one band of rows */
+    info->band_capacity = band_rows ? band_rows : image_band_rows(info);
+    if (info->band_capacity > info->height) {
+        info->band_capacity = info->height;
+    }
+    if (info->width == 0 || info->height == 0 || !image_alloc_pixels(info)) {
+        fprintf(stderr, "Error: Failed to allocate image buffer\n");
+        backend->close(info);
+        memset(info, 0, sizeof(ImageInfo));
+        return false;
+    }
+    
+    return true;
+}
+
+bool image_open_stream_frame(const char *filename, uint32_t frame, ImageInfo *info, uint32_t band_rows) {
     if (!filename || !info) {
         return false;
     }
@@ -38,519 +142,312 @@ static size_t calculate_capacity(const ImageInfo *info) {
     /* Initialize structure */
     memset(info, 0, sizeof(ImageInfo));
     
-    /* Initialize COM */
-    hr = CoInitialize(NULL);
-    if (FAILED(hr)) {
-        fprintf(stderr, "Error: Failed to initialize COM\n");
+    if (!backend->open_decoder(info, filename, NULL, 0, frame)) {
+        memset(info, 0, sizeof(ImageInfo));
         return false;
     }
     
-    /* Create WIC factory */
-    hr = CoCreateInstance(&CLSID_WICImagingFactory, NULL, CLSCTX_INPROC_SERVER,
-                         &IID_IWICImagingFactory, (LPVOID*)&info->wic_factory);
-    if (FAILED(hr)) {
-        fprintf(stderr, "Error: Failed to create WIC factory\n");
-        CoUninitialize();
+    return image_open_decoded(info, band_rows);
+}
+
+bool image_open_stream(const char *filename, ImageInfo *info, uint32_t band_rows) {
+    return image_open_stream_frame(filename, 0, info, band_rows);
+}
+
+bool image_open_info_frame(const char *filename, uint32_t frame, ImageInfo *info) {
+    if (!filename || !info) {
         return false;
     }
     
-    /* Convert filename to wide char */
-    MultiByteToWideChar(CP_UTF8, 0, filename, -1, wfilename, MAX_PATH);
+    /* Initialize structure */
+    memset(info, 0, sizeof(ImageInfo));
     
-    /* Create decoder from filename */
-    hr = info->wic_factory->lpVtbl->CreateDecoderFromFilename(info->wic_factory,
-                                                             wfilename, NULL, GENERIC_READ,
-                                                             WICDecodeMetadataCacheOnLoad,
-                                                             &info->decoder);
-    if (FAILED(hr)) {
-        fprintf(stderr, "Error: Cannot open file %s or not a valid image\n", filename);
-        info->wic_factory->lpVtbl->Release(info->wic_factory);
-        CoUninitialize();
+    if (!backend->open_decoder(info, filename, NULL, 0, frame)) {
+        memset(info, 0, sizeof(ImageInfo));
         return false;
     }
     
-    /* Get first frame */
-    hr = info->decoder->lpVtbl->GetFrame(info->decoder, 0, &info->frame);
-    if (FAILED(hr)) {
-        fprintf(stderr, "Error: Failed to get image frame\n");
-        info->decoder->lpVtbl->Release(info->decoder);
-        info->wic_factory->lpVtbl->Release(info->wic_factory);
-        CoUninitialize();
+    /* Geometry only: no plane, image_read_rows is not available */
+    info->rowbytes = (size_t)info->width * info->bytes_per_pixel;
+    info->capacity = calculate_capacity(info);
+    return true;
+}
+
+bool image_open_info(const char *filename, ImageInfo *info) {
+    return image_open_info_frame(filename, 0, info);
+}
+
+bool image_open_stream_mem(const void *data, size_t size, ImageInfo *info, uint32_t band_rows) {
+    if (!data || !info || size == 0) {
         return false;
     }
     
-    /* Get image dimensions */
-    hr = info->frame->lpVtbl->GetSize(info->frame, &info->width, &info->height);
-    if (FAILED(hr)) {
-        fprintf(stderr, "Error: Failed to get image dimensions\n");
-        goto cleanup_read;
-    }
+    /* Initialize structure */
+    memset(info, 0, sizeof(ImageInfo));
     
-    /* Get pixel format */
-    hr = info->frame->lpVtbl->GetPixelFormat(info->frame, &pixelFormat);
-    if (FAILED(hr)) {
-        fprintf(stderr, "Error: Failed to get pixel format\n");
-        goto cleanup_read;
+    if (!backend->open_decoder(info, NULL, data, size, 0)) {
+        memset(info, 0, sizeof(ImageInfo));
+        return false;
     }
-      /* Store original pixel format for processing decision */
-    info->bit_depth = 8; /* WIC normalizes to 8-bit */
     
-    /* Allocate row pointers */
-    info->row_pointers = (uint8_t**)malloc(sizeof(uint8_t*) * info->height);
-    if (!info->row_pointers) {
-        fprintf(stderr, "Error: Failed to allocate row pointers\n");
-        goto cleanup_read;
+    return image_open_decoded(info, band_rows);
+}
+
+bool image_open_pixels(ImageInfo *info, uint8_t *pixels, uint32_t width, uint32_t height,
+                       size_t stride, StegPixelFormat format) {
+    if (!info || !pixels || width == 0 || height == 0) {
+        return false;
     }
-      /* Copy pixels - read in original format to preserve LSBs */
-    WICRect rect = {0, 0, info->width, info->height};
     
-    /* Get original pixel format and determine the appropriate parameters */
-    if (IsEqualGUID(&pixelFormat, &GUID_WICPixelFormat24bppRGB)) {
-        /* Already 24bpp RGB, copy directly */
-        UINT stride = info->width * 3;
-        UINT bufferSize = stride * info->height;
-        uint8_t *buffer = (uint8_t*)malloc(bufferSize);
-        
-        if (!buffer) {
-            fprintf(stderr, "Error: Failed to allocate image buffer\n");
-            goto cleanup_read;
-        }
-          hr = info->frame->lpVtbl->CopyPixels(info->frame, &rect, stride, bufferSize, buffer);
-          if (SUCCEEDED(hr)) {
-            /* Set final format parameters */
+    memset(info, 0, sizeof(ImageInfo));
+    switch (format) {
+        case STEG_PIXELS_GRAY8:
+            info->channels = 1;
+            info->color_type = PNG_COLOR_GRAYSCALE;
+            break;
+        case STEG_PIXELS_RGB24:
+        case STEG_PIXELS_BGR24:
             info->channels = 3;
-            info->has_alpha = false;
-            info->bytes_per_pixel = 3;
-            info->rowbytes = info->width * 3;
-            
-            /* Allocate memory for image data */
-            for (uint32_t y = 0; y < info->height; y++) {
-                info->row_pointers[y] = (uint8_t*)malloc(info->rowbytes);
-                if (!info->row_pointers[y]) {
-                    fprintf(stderr, "Error: Failed to allocate row %u\n", y);
-                    /* Clean up previously allocated rows */
-                    for (uint32_t i = 0; i < y; i++) {
-                        free(info->row_pointers[i]);
-                    }
-                    free(info->row_pointers);
-                    free(buffer);
-                    goto cleanup_read;
-                }
-            }
-            
-            /* Copy to row pointers and convert BGR back to RGB */
-            for (uint32_t y = 0; y < info->height; y++) {
-                uint8_t *src_row = buffer + (y * stride);
-                uint8_t *dst_row = info->row_pointers[y];
-                
-                for (uint32_t x = 0; x < info->width; x++) {
-                    // Convert BGR back to RGB
-                    dst_row[x * 3 + 0] = src_row[x * 3 + 2]; // Red = src Blue
-                    dst_row[x * 3 + 1] = src_row[x * 3 + 1]; // Green = src Green
-                    dst_row[x * 3 + 2] = src_row[x * 3 + 0]; // Blue = src Red
-                }
-            }
-        }
-          free(buffer);
-    } else if (IsEqualGUID(&pixelFormat, &GUID_WICPixelFormat32bppRGBA) ||
-               IsEqualGUID(&pixelFormat, &GUID_WICPixelFormat32bppBGRA)) {
-        /* Handle RGBA formats - preserve alpha channel */
-        UINT stride = info->width * 4;
-        UINT bufferSize = stride * info->height;
-        uint8_t *buffer = (uint8_t*)malloc(bufferSize);
-        
-        if (!buffer) {
-            fprintf(stderr, "Error: Failed to allocate image buffer\n");
-            goto cleanup_read;
-        }        /* Create format converter to standardize to RGBA */
-        IWICFormatConverter *converter = NULL;
-        hr = info->wic_factory->lpVtbl->CreateFormatConverter(info->wic_factory, &converter);
-        if (SUCCEEDED(hr)) {
-            hr = converter->lpVtbl->Initialize(converter, (IWICBitmapSource*)info->frame,
-                                              &GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone,
-                                              NULL, 0.0, WICBitmapPaletteTypeCustom);
-            if (SUCCEEDED(hr)) {
-                hr = converter->lpVtbl->CopyPixels(converter, &rect, stride, bufferSize, buffer);
-            }
-            converter->lpVtbl->Release(converter);
-        }
-          if (SUCCEEDED(hr)) {
-            /* Set final format parameters */
+            info->color_type = PNG_COLOR_RGB;
+            break;
+        case STEG_PIXELS_RGBA32:
+        case STEG_PIXELS_BGRA32:
             info->channels = 4;
             info->has_alpha = true;
-            info->bytes_per_pixel = 4;
-            info->rowbytes = info->width * 4;
-            
-            /* Allocate memory for image data */
-            for (uint32_t y = 0; y < info->height; y++) {
-                info->row_pointers[y] = (uint8_t*)malloc(info->rowbytes);
-                if (!info->row_pointers[y]) {
-                    fprintf(stderr, "Error: Failed to allocate row %u\n", y);
-                    /* Clean up previously allocated rows */
-                    for (uint32_t i = 0; i < y; i++) {
-                        free(info->row_pointers[i]);
-                    }
-                    free(info->row_pointers);
-                    free(buffer);
-                    goto cleanup_read;
-                }
-            }
-            
-            /* Copy to row pointers - RGBA format */
-            for (uint32_t y = 0; y < info->height; y++) {
-                memcpy(info->row_pointers[y], buffer + (y * stride), stride);
-            }
-        }
-        
-        free(buffer);
-    } else {
-        /* Convert to 24bpp RGB for other formats */
-        UINT stride = info->width * 3;
-        UINT bufferSize = stride * info->height;
-        uint8_t *buffer = (uint8_t*)malloc(bufferSize);
-        
-        if (!buffer) {
+            info->color_type = PNG_COLOR_RGBA;
+            break;
+        default:
+            return false;
+    }
+    info->width = width;
+    info->height = height;
+    info->bit_depth = 8;
+    info->bytes_per_pixel = info->channels;
+    info->frame_count = 1;
+    info->bgr_order = format == STEG_PIXELS_BGR24 || format == STEG_PIXELS_BGRA32;
+    info->rowbytes = (size_t)width * info->bytes_per_pixel;
+    info->capacity = calculate_capacity(info);
+    if (stride < info->rowbytes) {
+        return false;
+    }
+    info->raw_pixels = pixels;
+    info->raw_stride = stride;
+    
+    /* A tight buffer is the plane itself, with row views of its own that image_read_rows
+       points at each band; a padded one gets a band plane to copy through */
+    if (stride == info->rowbytes) {
+        info->row_pointers = (uint8_t**)malloc(sizeof(uint8_t*) * height);
+        if (!info->row_pointers) {
             fprintf(stderr, "Error: Failed to allocate image buffer\n");
-            goto cleanup_read;
-        }
-        
-        /* Create format converter */
-        IWICFormatConverter *converter = NULL;
-        hr = info->wic_factory->lpVtbl->CreateFormatConverter(info->wic_factory, &converter);
-        if (SUCCEEDED(hr)) {
-            hr = converter->lpVtbl->Initialize(converter, (IWICBitmapSource*)info->frame,
-                                              &GUID_WICPixelFormat24bppRGB, WICBitmapDitherTypeNone,
-                                              NULL, 0.0, WICBitmapPaletteTypeCustom);
-            if (SUCCEEDED(hr)) {
-                hr = converter->lpVtbl->CopyPixels(converter, &rect, stride, bufferSize, buffer);
-            }
-            converter->lpVtbl->Release(converter);
-        }
-          if (SUCCEEDED(hr)) {
-            /* Set final format parameters */
-            info->channels = 3;
-            info->has_alpha = false;
-            info->bytes_per_pixel = 3;
-            info->rowbytes = info->width * 3;
-            
-            /* Allocate memory for image data */
-            for (uint32_t y = 0; y < info->height; y++) {
-                info->row_pointers[y] = (uint8_t*)malloc(info->rowbytes);
-                if (!info->row_pointers[y]) {
-                    fprintf(stderr, "Error: Failed to allocate row %u\n", y);
-                    /* Clean up previously allocated rows */
-                    for (uint32_t i = 0; i < y; i++) {
-                        free(info->row_pointers[i]);
-                    }
-                    free(info->row_pointers);
-                    free(buffer);
-                    goto cleanup_read;
-                }
-            }
-            
-            /* Copy to row pointers */
-            for (uint32_t y = 0; y < info->height; y++) {
-                memcpy(info->row_pointers[y], buffer + (y * stride), stride);
-            }
+            memset(info, 0, sizeof(ImageInfo));
+            return false;
         }
-          free(buffer);
+        info->pixels = pixels;
+        info->pixels_borrowed = true;
+        info->band_capacity = height;
+        return true;
+    }
+    info->band_capacity = image_band_rows(info);
+    if (info->band_capacity > height) {
+        info->band_capacity = height;
+    }
+    if (!image_alloc_pixels(info)) {
+        fprintf(stderr, "Error: Failed to allocate image buffer\n");
+        memset(info, 0, sizeof(ImageInfo));
+        return false;
+    }
+    return true;
+}
+
+/* Copy rows between a padded caller buffer and the band plane */
+static void image_copy_raw_rows(ImageInfo *info, uint32_t y, uint32_t count, bool to_plane) {
+    for (uint32_t r = 0; r < count; r++) {
+        uint8_t *raw = info->raw_pixels + (size_t)(y + r) * info->raw_stride;
+        uint8_t *row = info->pixels + (size_t)r * info->rowbytes;
+        memcpy(to_plane ? row : raw, to_plane ? raw : row, info->rowbytes);
+    }
+}
+
+bool image_read_rows(ImageInfo *info, uint32_t y, uint32_t count) {
+    if (!info || !info->pixels || count == 0 || count > info->band_capacity ||
+        y >= info->height || count > info->height - y) {
+        return false;
     }
-      /* Calculate capacity for steganography after format is determined */
-    info->capacity = calculate_capacity(info);
     
-    if (FAILED(hr)) {
-        fprintf(stderr, "Error: Failed to copy image pixels\n");
-        goto cleanup_read;
+    if (info->raw_pixels) {
+        /* Caller-held pixels: a tight buffer is viewed in place from row y */
+        if (info->raw_stride == info->rowbytes) {
+            info->pixels = info->raw_pixels + (size_t)y * info->raw_stride;
+            for (uint32_t r = 0; r < count; r++) {
+                info->row_pointers[r] = info->pixels + (size_t)r * info->rowbytes;
+            }
+        } else {
+            image_copy_raw_rows(info, y, count, true);
+        }
+    } else if (!info->codec || !backend->read_rows(info, y, count)) {
+        info->band_rows = 0;
+        return false;
     }
     
+    info->band_y = y;
+    info->band_rows = count;
     return true;
+}
 
-cleanup_read:
-    if (info->row_pointers) {
-        for (uint32_t y = 0; y < info->height; y++) {
-            if (info->row_pointers[y]) {
-                free(info->row_pointers[y]);
-            }
-        }
-        free(info->row_pointers);
+bool image_open_read(const char *filename, ImageInfo *info) {
+    /* One band covering the whole image */
+    if (!image_open_stream(filename, info, UINT32_MAX)) {
+        return false;
+    }
+    if (!image_read_rows(info, 0, info->height)) {
+        image_close(info);
+        return false;
     }
-    if (info->frame) info->frame->lpVtbl->Release(info->frame);
-    if (info->decoder) info->decoder->lpVtbl->Release(info->decoder);
-    if (info->wic_factory) info->wic_factory->lpVtbl->Release(info->wic_factory);
-    CoUninitialize();
-    return false;
+    return true;
 }
 
-bool image_open_write(const char *filename, ImageInfo *info, const ImageInfo *template) {
-    HRESULT hr;
-    WCHAR wfilename[MAX_PATH];
-    
-    if (!filename || !info || !template) {
+/* Create the PNG encoder for filename (NULL = in memory), or the next frame of container,
+   with the geometry of template; the plane is left to the caller */
+static bool image_open_encoder(const char *filename, ImageInfo *container, ImageInfo *info,
+                               const ImageInfo *template) {
+    if (!info || !template) {
         return false;
     }
     
     /* Copy template information */
     memcpy(info, template, sizeof(ImageInfo));
     
-    /* Reset WIC structures */
-    info->wic_factory = NULL;
-    info->encoder = NULL;
-    info->frame_encode = NULL;
-    info->stream = NULL;
-    info->decoder = NULL;
-    info->frame = NULL;
-    info->fp = NULL;
-    info->current_row = NULL;
-    
-    /* Initialize COM */
-    hr = CoInitialize(NULL);
-    if (FAILED(hr)) {
-        fprintf(stderr, "Error: Failed to initialize COM for writing\n");
-        return false;
-    }
-    
-    /* Create WIC factory */
-    hr = CoCreateInstance(&CLSID_WICImagingFactory, NULL, CLSCTX_INPROC_SERVER,
-                         &IID_IWICImagingFactory, (LPVOID*)&info->wic_factory);
-    if (FAILED(hr)) {
-        fprintf(stderr, "Error: Failed to create WIC factory for writing\n");
-        CoUninitialize();
-        return false;
-    }
-    
-    /* Convert filename to wide char */
-    MultiByteToWideChar(CP_UTF8, 0, filename, -1, wfilename, MAX_PATH);
-    
-    /* Create stream */
-    hr = info->wic_factory->lpVtbl->CreateStream(info->wic_factory, &info->stream);
-    if (FAILED(hr)) {
-        fprintf(stderr, "Error: Failed to create WIC stream\n");
-        goto cleanup_write;
-    }
-    
-    /* Initialize stream from filename */
-    hr = info->stream->lpVtbl->InitializeFromFilename(info->stream, wfilename, GENERIC_WRITE);
-    if (FAILED(hr)) {
-        fprintf(stderr, "Error: Cannot create file %s\n", filename);
-        goto cleanup_write;
-    }
-    
-    /* Create PNG encoder */
-    hr = info->wic_factory->lpVtbl->CreateEncoder(info->wic_factory, &GUID_ContainerFormatPng,
-                                                 NULL, &info->encoder);
-    if (FAILED(hr)) {
-        fprintf(stderr, "Error: Failed to create PNG encoder\n");
-        goto cleanup_write;
-    }
-      /* Initialize encoder */
-    hr = info->encoder->lpVtbl->Initialize(info->encoder, (IStream*)info->stream,
-                                          WICBitmapEncoderNoCache);
-    if (FAILED(hr)) {
-        fprintf(stderr, "Error: Failed to initialize PNG encoder\n");
-        goto cleanup_write;
-    }
-      /* Create frame encoder */
-    IPropertyBag2 *propertyBag = NULL;
-    hr = info->encoder->lpVtbl->CreateNewFrame(info->encoder, &info->frame_encode, &propertyBag);
-    if (FAILED(hr)) {
-        fprintf(stderr, "Error: Failed to create PNG frame encoder\n");
-        goto cleanup_write;
-    }
-      /* Configure PNG encoder for lossless steganography */    if (propertyBag) {
-        PROPBAG2 option = { 0 };
-        VARIANT varValue;
-        
-        /* Set PNG filter to NONE to preserve exact pixel values */
-        option.pstrName = L"FilterOption";
-        VariantInit(&varValue);
-        varValue.vt = VT_UI1;
-        varValue.bVal = WICPngFilterNone;  /* No filtering - preserves LSBs */
-        propertyBag->lpVtbl->Write(propertyBag, 1, &option, &varValue);
-        VariantClear(&varValue);
-        
-        /* Disable interlacing to maintain pixel order */
-        option.pstrName = L"InterlaceOption";
-        VariantInit(&varValue);
-        varValue.vt = VT_BOOL;
-        varValue.boolVal = VARIANT_FALSE;
-        propertyBag->lpVtbl->Write(propertyBag, 1, &option, &varValue);
-        VariantClear(&varValue);
-        
-        /* Set minimal compression to preserve LSBs */
-        option.pstrName = L"CompressionLevel";
-        VariantInit(&varValue);
-        varValue.vt = VT_R4;
-        varValue.fltVal = 0.0f;  /* Minimal compression */
-        propertyBag->lpVtbl->Write(propertyBag, 1, &option, &varValue);
-        VariantClear(&varValue);
-        
-        /* Force bit depth to 8 to ensure no bit depth conversion */
-        option.pstrName = L"BitDepth";
-        VariantInit(&varValue);
-        varValue.vt = VT_UI1;
-        varValue.bVal = 8;
-        propertyBag->lpVtbl->Write(propertyBag, 1, &option, &varValue);
-        VariantClear(&varValue);
-        
-        /* Disable gamma correction to preserve raw pixel values */
-        option.pstrName = L"EnableV5Header32bppBGRA";
-        VariantInit(&varValue);
-        varValue.vt = VT_BOOL;
-        varValue.boolVal = VARIANT_FALSE;
-        propertyBag->lpVtbl->Write(propertyBag, 1, &option, &varValue);
-        VariantClear(&varValue);
-    }
-    
-    /* Initialize frame encoder */
-    hr = info->frame_encode->lpVtbl->Initialize(info->frame_encode, propertyBag);
-    if (propertyBag) {
-        propertyBag->lpVtbl->Release(propertyBag);
-    }
-    if (FAILED(hr)) {
-        fprintf(stderr, "Error: Failed to initialize PNG frame encoder\n");
-        goto cleanup_write;
-    }
-    
-    /* Set frame size */
-    hr = info->frame_encode->lpVtbl->SetSize(info->frame_encode, info->width, info->height);
-    if (FAILED(hr)) {
-        fprintf(stderr, "Error: Failed to set frame size\n");
-        goto cleanup_write;
-    }    /* Set pixel format based on whether image has alpha channel */
-    WICPixelFormatGUID pixelFormat;
-    if (info->has_alpha) {
-        pixelFormat = GUID_WICPixelFormat32bppBGRA;  /* Use BGRA instead of RGBA */
-    } else {
-        pixelFormat = GUID_WICPixelFormat24bppBGR;
-    }
-    hr = info->frame_encode->lpVtbl->SetPixelFormat(info->frame_encode, &pixelFormat);
-    if (FAILED(hr)) {
-        fprintf(stderr, "Error: Failed to set pixel format\n");
-        goto cleanup_write;
+    /* Reset the decoder side; unknown profiles fall back to the default */
+    info->codec = NULL;
+    info->raw_pixels = NULL;
+    info->pixels = NULL;
+    info->row_pointers = NULL;
+    info->pixels_borrowed = false;
+    info->band_y = 0;
+    info->band_rows = 0;
+    info->rows_written = 0;
+    if (info->png_profile > STEG_PNG_SMALL) {
+        info->png_profile = STEG_PNG_FAST;
+    }
+    
+    if (container ? !backend->open_frame_encoder(info, container) : !backend->open_encoder(info, filename)) {
+        memset(info, 0, sizeof(ImageInfo));
+        return false;
     }
-    
-    /* Allocate row pointers for writing */
-    info->row_pointers = (uint8_t**)malloc(sizeof(uint8_t*) * info->height);
-    if (!info->row_pointers) {
-        fprintf(stderr, "Error: Failed to allocate row pointers for writing\n");
-        goto cleanup_write;
+    return true;
+}
+
+bool image_open_write(const char *filename, ImageInfo *info, const ImageInfo *template) {
+    if (!image_open_encoder(filename, NULL, info, template)) {
+        return false;
     }
     
-    /* Allocate memory for each row */
-    for (uint32_t y = 0; y < info->height; y++) {
-        info->row_pointers[y] = (uint8_t*)malloc(info->rowbytes);
-        if (!info->row_pointers[y]) {
-            fprintf(stderr, "Error: Failed to allocate row %u for writing\n", y);
-            /* Clean up previously allocated rows */
-            for (uint32_t i = 0; i < y; i++) {
-                free(info->row_pointers[i]);
-            }
-            free(info->row_pointers);
-            info->row_pointers = NULL;
-            goto cleanup_write;
-        }
+    /* Allocate the pixel plane for writing (same band height as the template) */
+    if (!image_alloc_pixels(info)) {
+        fprintf(stderr, "Error: Failed to allocate image buffer for writing\n");
+        image_close(info);
+        return false;
     }
     
     return true;
+}
 
-cleanup_write:
-    if (info->frame_encode) {
-        info->frame_encode->lpVtbl->Release(info->frame_encode);
-        info->frame_encode = NULL;
-    }
-    if (info->encoder) {
-        info->encoder->lpVtbl->Release(info->encoder);
-        info->encoder = NULL;
-    }
-    if (info->stream) {
-        info->stream->lpVtbl->Release(info->stream);
-        info->stream = NULL;
+/* image_open_write_from into a file of its own, or into the next frame of container */
+static bool image_open_from(const char *filename, ImageInfo *container, ImageInfo *info, ImageInfo *source) {
+    if (!source || !source->pixels || source->pixels_borrowed) {
+        return false;
     }
-    if (info->wic_factory) {
-        info->wic_factory->lpVtbl->Release(info->wic_factory);
-        info->wic_factory = NULL;
+    if (!image_open_encoder(filename, container, info, source)) {
+        return false;
     }
-    CoUninitialize();
-    return false;
+    
+    /* Take over the source plane; the source keeps decoding into it as a borrowed view */
+    info->pixels = source->pixels;
+    info->row_pointers = source->row_pointers;
+    source->pixels_borrowed = true;
+    
+    return true;
+}
+
+bool image_open_write_from(const char *filename, ImageInfo *info, ImageInfo *source) {
+    return image_open_from(filename, NULL, info, source);
 }
 
-bool image_read_row(ImageInfo *info, uint32_t y) {
-    if (!info || !info->row_pointers || y >= info->height) {
+bool image_open_container(const char *filename, ImageInfo *container) {
+    if (!filename || !container) {
         return false;
     }
     
-    /* Set current row pointer */
-    info->current_row = info->row_pointers[y];
+    memset(container, 0, sizeof(ImageInfo));
+    if (!backend->open_container) {
+        fprintf(stderr, "Error: The %s backend has no multi-frame output\n", backend->name);
+        return false;
+    }
+    if (!backend->open_container(container, filename)) {
+        memset(container, 0, sizeof(ImageInfo));
+        return false;
+    }
     return true;
 }
 
-bool image_write_row(ImageInfo *info, uint32_t y) {
-    /* For PNG, we'll write all rows at once in finalize_write */
-    /* This function just validates parameters */
-    return (info && info->row_pointers && y < info->height);
+bool image_open_write_frame(ImageInfo *container, ImageInfo *info, ImageInfo *source) {
+    if (!container || !container->codec) {
+        return false;
+    }
+    return image_open_from(NULL, container, info, source);
 }
 
-bool image_finalize_write(ImageInfo *info) {
-    HRESULT hr;
-    
-    if (!info || !info->frame_encode || !info->encoder || !info->row_pointers) {
+bool image_finalize_container(ImageInfo *container) {
+    if (!container || !container->codec) {
         return false;
     }
-      /* Create a single buffer with all image data */
-    UINT stride = info->width * info->bytes_per_pixel;
-    UINT bufferSize = stride * info->height;
-    uint8_t *buffer = (uint8_t*)malloc(bufferSize);
-    
-    if (!buffer) {
-        fprintf(stderr, "Error: Failed to allocate write buffer\n");
+    return backend->finalize_container(container);
+}
+
+bool image_write_rows(ImageInfo *info, uint32_t count) {
+    if (!info || !info->pixels || count == 0 || count > info->band_capacity ||
+        count > info->height - info->rows_written) {
         return false;
     }
-      /* Copy row data to single buffer and handle RGB/RGBA conversion for WIC */
-    for (uint32_t y = 0; y < info->height; y++) {
-        uint8_t *src_row = info->row_pointers[y];
-        uint8_t *dst_row = buffer + (y * stride);        if (info->has_alpha) {
-            /* Handle RGBA -> BGRA conversion for WIC PNG encoder */
-            for (uint32_t x = 0; x < info->width; x++) {
-                dst_row[x * 4 + 0] = src_row[x * 4 + 2]; // Blue = src Red
-                dst_row[x * 4 + 1] = src_row[x * 4 + 1]; // Green = src Green  
-                dst_row[x * 4 + 2] = src_row[x * 4 + 0]; // Red = src Blue
-                dst_row[x * 4 + 3] = src_row[x * 4 + 3]; // Alpha = src Alpha
-            }
-        } else {
-            /* Handle RGB - convert RGB to BGR for WIC */
-            for (uint32_t x = 0; x < info->width; x++) {
-                dst_row[x * 3 + 0] = src_row[x * 3 + 2]; // Blue = src Red
-                dst_row[x * 3 + 1] = src_row[x * 3 + 1]; // Green = src Green  
-                dst_row[x * 3 + 2] = src_row[x * 3 + 0]; // Red = src Blue
-            }
+    
+    if (info->raw_pixels) {
+        /* Caller-held pixels: copy the band back unless it was modified in place */
+        if (info->raw_stride != info->rowbytes) {
+            image_copy_raw_rows(info, info->rows_written, count, false);
         }
+    } else if (!info->codec || !backend->write_rows(info, count)) {
+        return false;
     }
     
-    /* Write pixels to frame */
-    hr = info->frame_encode->lpVtbl->WritePixels(info->frame_encode, info->height,
-                                                stride, bufferSize, buffer);
-    free(buffer);
-    
-    if (FAILED(hr)) {
-        fprintf(stderr, "Error: Failed to write pixels to PNG\n");
+    info->rows_written += count;
+    return true;
+}
+
+bool image_finalize_write(ImageInfo *info) {
+    if (!info || !info->codec) {
         return false;
     }
     
-    /* Commit frame */
-    hr = info->frame_encode->lpVtbl->Commit(info->frame_encode);
-    if (FAILED(hr)) {
-        fprintf(stderr, "Error: Failed to commit PNG frame\n");
+    /* A fully held image that was not streamed is written in one go */
+    if (info->rows_written == 0 && info->band_capacity == info->height) {
+        if (!image_write_rows(info, info->height)) {
+            return false;
+        }
+    }
+    if (info->rows_written != info->height) {
+        fprintf(stderr, "Error: Incomplete PNG output (%u of %u rows)\n",
+                info->rows_written, info->height);
         return false;
     }
     
-    /* Commit encoder */
-    hr = info->encoder->lpVtbl->Commit(info->encoder);
-    if (FAILED(hr)) {
-        fprintf(stderr, "Error: Failed to commit PNG encoder\n");
+    return backend->finalize_write(info);
+}
+
+bool image_encoded_data(ImageInfo *info, uint8_t **data, size_t *size) {
+    if (!info || !info->codec || !data || !size) {
         return false;
     }
-    
-    return true;
+    return backend->encoded_data(info, data, size);
 }
 
 void image_close(ImageInfo *info) {
@@ -558,54 +455,14 @@ void image_close(ImageInfo *info) {
         return;
     }
     
-    /* Clean up row pointers */
-    if (info->row_pointers) {
-        for (uint32_t y = 0; y < info->height; y++) {
-            if (info->row_pointers[y]) {
-                /* Security: zero the buffer before freeing */
-                memset(info->row_pointers[y], 0, info->rowbytes);
-                free(info->row_pointers[y]);
-            }
-        }
-        free(info->row_pointers);
-        info->row_pointers = NULL;
-    }
-    
-    /* Clean up WIC structures */
-    if (info->frame_encode) {
-        info->frame_encode->lpVtbl->Release(info->frame_encode);
-        info->frame_encode = NULL;
-    }
-    if (info->encoder) {
-        info->encoder->lpVtbl->Release(info->encoder);
-        info->encoder = NULL;
-    }
-    if (info->stream) {
-        info->stream->lpVtbl->Release(info->stream);
-        info->stream = NULL;
-    }
-    if (info->frame) {
-        info->frame->lpVtbl->Release(info->frame);
-        info->frame = NULL;
-    }
-    if (info->decoder) {
-        info->decoder->lpVtbl->Release(info->decoder);
-        info->decoder = NULL;
-    }
-    if (info->wic_factory) {
-        info->wic_factory->lpVtbl->Release(info->wic_factory);
-        info->wic_factory = NULL;
-    }
+    /* Clean up pixel plane */
+    image_free_pixels(info);
     
-    /* Close file handle if present */
-    if (info->fp) {
-        fclose(info->fp);
-        info->fp = NULL;
+    /* Release decoder/encoder objects */
+    if (info->codec) {
+        backend->close(info);
     }
     
-    /* Uninitialize COM */
-    CoUninitialize();
-    
     /* Clear structure */
     memset(info, 0, sizeof(ImageInfo));
 }
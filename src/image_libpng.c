@@ -0,0 +1,420 @@
+#include "image_backend.h"
+#include <png.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* libpng objects of one open image. Rows are decoded and encoded strictly in order;
+   interlaced images are decoded whole on the first read (Adam7 passes cannot be banded). */
+typedef struct {
+    png_structp png;
+    png_infop png_info;
+    bool writing;
+    FILE *fp;                   /* File being decoded or written, NULL for memory */
+    
+    /* Memory source (decoder) */
+    const uint8_t *src;
+    size_t src_size;
+    size_t src_pos;
+    
+    /* Memory sink (encoder), handed out by encoded_data */
+    uint8_t *out;
+    size_t out_size;
+    size_t out_capacity;
+    
+    uint32_t next_row;          /* Next row the decoder delivers */
+    uint8_t *scratch;           /* One row for skipped rows, or the whole interlaced image */
+} PngCodec;
+
+/* zlib level and row filters per StegPngProfile */
+static const struct {
+    int filters;
+    int level;
+} png_profiles[] = {
+    { PNG_FILTER_NONE, 1 },     /* STEG_PNG_FAST */
+    { PNG_FILTER_SUB, 6 },      /* STEG_PNG_BALANCED */
+    { PNG_ALL_FILTERS, 9 }      /* STEG_PNG_SMALL */
+};
+
+static void libpng_error(png_structp png, png_const_charp message) {
+    fprintf(stderr, "Error: PNG %s\n", message);
+    png_longjmp(png, 1);
+}
+
+static void libpng_warning(png_structp png, png_const_charp message) {
+    (void)png;
+    (void)message;
+}
+
+static void libpng_read_mem(png_structp png, png_bytep data, png_size_t length) {
+    PngCodec *codec = (PngCodec*)png_get_io_ptr(png);
+    
+    if (length > codec->src_size - codec->src_pos) {
+        png_error(png, "data truncated");
+    }
+    memcpy(data, codec->src + codec->src_pos, length);
+    codec->src_pos += length;
+}
+
+static void libpng_write_mem(png_structp png, png_bytep data, png_size_t length) {
+    PngCodec *codec = (PngCodec*)png_get_io_ptr(png);
+    
+    if (length > codec->out_capacity - codec->out_size) {
+        size_t grow = codec->out_capacity ? codec->out_capacity : 1u << 16;
+        uint8_t *out;
+        
+        while (grow - codec->out_size < length) {
+            if (grow > SIZE_MAX / 2) {
+                png_error(png, "output too large");
+            }
+            grow *= 2;
+        }
+        out = (uint8_t*)realloc(codec->out, grow);
+        if (!out) {
+            png_error(png, "out of memory");
+        }
+        codec->out = out;
+        codec->out_capacity = grow;
+    }
+    memcpy(codec->out + codec->out_size, data, length);
+    codec->out_size += length;
+}
+
+static void libpng_flush_mem(png_structp png) {
+    (void)png;
+}
+
+static bool libpng_runtime_init(void) {
+    return true;
+}
+
+static void libpng_runtime_shutdown(void) {
+}
+
+static void libpng_close(ImageInfo *info) {
+    PngCodec *codec = (PngCodec*)info->codec;
+    
+    if (!codec) {
+        return;
+    }
+    if (codec->png) {
+        if (codec->writing) {
+            png_destroy_write_struct(&codec->png, &codec->png_info);
+        } else {
+            png_destroy_read_struct(&codec->png, &codec->png_info, NULL);
+        }
+    }
+    if (codec->fp) {
+        fclose(codec->fp);
+    }
+    if (codec->scratch) {
+        /* Security: zero the buffer before freeing */
+        memset(codec->scratch, 0, info->interlaced ? info->rowbytes * info->height : info->rowbytes);
+        free(codec->scratch);
+    }
+    free(codec->out);
+    free(codec);
+    info->codec = NULL;
+}
+
+static bool libpng_open_decoder(ImageInfo *info, const char *filename, const void *data, size_t size,
+                                uint32_t frame) {
+    PngCodec *codec;
+    png_byte signature[8];
+    int color_type, bit_depth;
+    
+    /* libpng decodes the default image only (APNG animation frames are skipped) */
+    if (frame > 0) {
+        fprintf(stderr, "Error: Image has no frame %u\n", frame);
+        return false;
+    }
+    codec = (PngCodec*)calloc(1, sizeof(PngCodec));
+    if (!codec) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return false;
+    }
+    info->codec = codec;
+    
+    /* Check the signature before handing the stream to libpng */
+    if (filename) {
+        codec->fp = fopen(filename, "rb");
+        if (!codec->fp || fread(signature, 1, 8, codec->fp) != 8 || png_sig_cmp(signature, 0, 8)) {
+            fprintf(stderr, "Error: Cannot open file %s or not a valid image\n", filename);
+            libpng_close(info);
+            return false;
+        }
+    } else if (size < 8 || png_sig_cmp((png_const_bytep)data, 0, 8)) {
+        fprintf(stderr, "Error: Buffer is not a valid image\n");
+        libpng_close(info);
+        return false;
+    }
+    
+    codec->png = png_create_read_struct(PNG_LIBPNG_VER_STRING, codec, libpng_error, libpng_warning);
+    codec->png_info = codec->png ? png_create_info_struct(codec->png) : NULL;
+    if (!codec->png_info) {
+        fprintf(stderr, "Error: Failed to create PNG decoder\n");
+        libpng_close(info);
+        return false;
+    }
+    if (setjmp(png_jmpbuf(codec->png))) {
+        libpng_close(info);
+        return false;
+    }
+    
+    if (codec->fp) {
+        png_init_io(codec->png, codec->fp);
+        png_set_sig_bytes(codec->png, 8);
+    } else {
+        codec->src = (const uint8_t*)data;
+        codec->src_size = size;
+        png_set_read_fn(codec->png, codec, libpng_read_mem);
+    }
+    png_read_info(codec->png, codec->png_info);
+    
+    /* Samples keep their native layout: gray, gray + alpha, RGB or RGBA at 8 or 16 bits.
+       Palettes become RGB(A) and low-depth gray 8-bit gray; 16-bit samples are swapped to
+       low byte first like the WIC formats. */
+    color_type = png_get_color_type(codec->png, codec->png_info);
+    bit_depth = png_get_bit_depth(codec->png, codec->png_info);
+    if (color_type == PNG_COLOR_TYPE_PALETTE) {
+        png_set_palette_to_rgb(codec->png);
+        if (png_get_valid(codec->png, codec->png_info, PNG_INFO_tRNS)) {
+            png_set_tRNS_to_alpha(codec->png);
+        }
+    }
+    if (color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8) {
+        png_set_expand_gray_1_2_4_to_8(codec->png);
+    }
+    if (bit_depth == 16) {
+        png_set_swap(codec->png);
+    }
+    info->interlaced = png_get_interlace_type(codec->png, codec->png_info) != PNG_INTERLACE_NONE;
+    if (info->interlaced) {
+        png_set_interlace_handling(codec->png);
+    }
+    png_read_update_info(codec->png, codec->png_info);
+    
+    info->width = png_get_image_width(codec->png, codec->png_info);
+    info->height = png_get_image_height(codec->png, codec->png_info);
+    info->channels = png_get_channels(codec->png, codec->png_info);
+    info->color_type = png_get_color_type(codec->png, codec->png_info);
+    info->has_alpha = (info->color_type & PNG_COLOR_MASK_ALPHA) != 0;
+    info->bit_depth = png_get_bit_depth(codec->png, codec->png_info);
+    info->bgr_order = false;
+    info->bytes_per_pixel = (uint8_t)(info->channels * (info->bit_depth / 8));
+    info->frame_count = 1;
+    if (png_get_rowbytes(codec->png, codec->png_info) != (size_t)info->width * info->bytes_per_pixel) {
+        fprintf(stderr, "Error: Unsupported PNG layout\n");
+        libpng_close(info);
+        return false;
+    }
+    
+    return true;
+}
+
+/* Decode an interlaced image whole into the scratch buffer */
+static bool libpng_read_interlaced(ImageInfo *info, PngCodec *codec) {
+    png_bytep *rows;
+    uint32_t y;
+    
+    if (info->rowbytes * info->height / info->height != info->rowbytes) {
+        fprintf(stderr, "Error: Image too large\n");
+        return false;
+    }
+    codec->scratch = (uint8_t*)malloc(info->rowbytes * info->height);
+    rows = (png_bytep*)malloc(sizeof(png_bytep) * info->height);
+    if (!codec->scratch || !rows) {
+        free(rows);
+        fprintf(stderr, "Error: Failed to allocate image buffer\n");
+        return false;
+    }
+    for (y = 0; y < info->height; y++) {
+        rows[y] = codec->scratch + (size_t)y * info->rowbytes;
+    }
+    if (setjmp(png_jmpbuf(codec->png))) {
+        free(rows);
+        return false;
+    }
+    png_read_image(codec->png, rows);
+    free(rows);
+    codec->next_row = info->height;
+    return true;
+}
+
+static bool libpng_read_rows(ImageInfo *info, uint32_t y, uint32_t count) {
+    PngCodec *codec = (PngCodec*)info->codec;
+    uint32_t r;
+    
+    if (codec->writing) {
+        return false;
+    }
+    
+    if (info->interlaced) {
+        if (!codec->scratch && !libpng_read_interlaced(info, codec)) {
+            return false;
+        }
+        memcpy(info->pixels, codec->scratch + (size_t)y * info->rowbytes, info->rowbytes * count);
+        return true;
+    }
+    
+    /* Sequential decoder: earlier rows are gone, later ones are skipped through one row */
+    if (y < codec->next_row) {
+        fprintf(stderr, "Error: PNG rows must be decoded in order\n");
+        return false;
+    }
+    if (y > codec->next_row && !codec->scratch) {
+        codec->scratch = (uint8_t*)malloc(info->rowbytes);
+        if (!codec->scratch) {
+            fprintf(stderr, "Error: Memory allocation failed\n");
+            return false;
+        }
+    }
+    if (setjmp(png_jmpbuf(codec->png))) {
+        return false;
+    }
+    while (codec->next_row < y) {
+        png_read_row(codec->png, codec->scratch, NULL);
+        codec->next_row++;
+    }
+    for (r = 0; r < count; r++) {
+        png_read_row(codec->png, info->pixels + (size_t)r * info->rowbytes, NULL);
+        codec->next_row++;
+    }
+    return true;
+}
+
+static bool libpng_open_encoder(ImageInfo *info, const char *filename) {
+    static const int color_types[] = {
+        PNG_COLOR_TYPE_GRAY, PNG_COLOR_TYPE_GRAY_ALPHA, PNG_COLOR_TYPE_RGB, PNG_COLOR_TYPE_RGB_ALPHA
+    };
+    PngCodec *codec;
+    
+    if (info->channels < 1 || info->channels > 4 || (info->bit_depth != 8 && info->bit_depth != 16) ||
+        (info->bgr_order && info->bit_depth != 8)) {
+        fprintf(stderr, "Error: Unsupported pixel layout for PNG output\n");
+        return false;
+    }
+    
+    codec = (PngCodec*)calloc(1, sizeof(PngCodec));
+    if (!codec) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return false;
+    }
+    codec->writing = true;
+    info->codec = codec;
+    
+    if (filename) {
+        codec->fp = fopen(filename, "wb");
+        if (!codec->fp) {
+            fprintf(stderr, "Error: Cannot create file %s\n", filename);
+            libpng_close(info);
+            return false;
+        }
+    }
+    
+    codec->png = png_create_write_struct(PNG_LIBPNG_VER_STRING, codec, libpng_error, libpng_warning);
+    codec->png_info = codec->png ? png_create_info_struct(codec->png) : NULL;
+    if (!codec->png_info) {
+        fprintf(stderr, "Error: Failed to create PNG encoder\n");
+        libpng_close(info);
+        return false;
+    }
+    if (setjmp(png_jmpbuf(codec->png))) {
+        libpng_close(info);
+        return false;
+    }
+    
+    if (codec->fp) {
+        png_init_io(codec->png, codec->fp);
+    } else {
+        png_set_write_fn(codec->png, codec, libpng_write_mem, libpng_flush_mem);
+    }
+    
+    /* Filtering and compression only change how rows are coded - pixels stay exact */
+    png_set_IHDR(codec->png, codec->png_info, info->width, info->height, info->bit_depth,
+                 color_types[info->channels - 1], PNG_INTERLACE_NONE,
+                 PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_set_filter(codec->png, PNG_FILTER_TYPE_BASE, png_profiles[info->png_profile].filters);
+    png_set_compression_level(codec->png, png_profiles[info->png_profile].level);
+    png_write_info(codec->png, codec->png_info);
+    
+    /* Planes decoded by WIC arrive as BGR(A); 16-bit planes hold the low byte first */
+    if (info->bgr_order) {
+        png_set_bgr(codec->png);
+    }
+    if (info->bit_depth == 16) {
+        png_set_swap(codec->png);
+    }
+    
+    return true;
+}
+
+static bool libpng_write_rows(ImageInfo *info, uint32_t count) {
+    PngCodec *codec = (PngCodec*)info->codec;
+    uint32_t r;
+    
+    if (!codec->writing) {
+        return false;
+    }
+    if (setjmp(png_jmpbuf(codec->png))) {
+        return false;
+    }
+    for (r = 0; r < count; r++) {
+        png_write_row(codec->png, info->pixels + (size_t)r * info->rowbytes);
+    }
+    return true;
+}
+
+static bool libpng_finalize_write(ImageInfo *info) {
+    PngCodec *codec = (PngCodec*)info->codec;
+    bool success;
+    
+    if (!codec->writing) {
+        return false;
+    }
+    if (setjmp(png_jmpbuf(codec->png))) {
+        return false;
+    }
+    png_write_end(codec->png, NULL);
+    
+    /* Close now so write errors are reported here rather than lost in image_close */
+    if (!codec->fp) {
+        return true;
+    }
+    success = fflush(codec->fp) == 0 && !ferror(codec->fp);
+    success = fclose(codec->fp) == 0 && success;
+    codec->fp = NULL;
+    if (!success) {
+        fprintf(stderr, "Error: Failed to write PNG output\n");
+    }
+    return success;
+}
+
+static bool libpng_encoded_data(ImageInfo *info, uint8_t **data, size_t *size) {
+    PngCodec *codec = (PngCodec*)info->codec;
+    
+    if (!codec->writing || codec->fp || !codec->out) {
+        return false;
+    }
+    
+    /* The sink buffer itself is handed over */
+    *data = codec->out;
+    *size = codec->out_size;
+    codec->out = NULL;
+    codec->out_size = 0;
+    codec->out_capacity = 0;
+    return true;
+}
+
+const ImageBackend image_backend_libpng = {
+    "libpng",
+    libpng_runtime_init,
+    libpng_runtime_shutdown,
+    libpng_open_decoder,
+    libpng_read_rows,
+    libpng_open_encoder,
+    libpng_write_rows,
+    libpng_finalize_write,
+    libpng_encoded_data,
+    NULL, NULL, NULL,           /* PNG output only, no multi-frame containers */
+    libpng_close
+};
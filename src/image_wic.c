@@ -0,0 +1,669 @@
+#include "image_backend.h"
+#include <windows.h>
+#include <wincodec.h>
+#include <combaseapi.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* WIC objects of one open image */
+typedef struct {
+    IWICImagingFactory *factory;        /* Reference to the shared factory */
+    IWICBitmapDecoder *decoder;         /* WIC decoder */
+    IWICBitmapFrameDecode *frame;       /* WIC frame decoder */
+    IWICFormatConverter *converter;     /* WIC converter for non-native formats */
+    IWICBitmapEncoder *encoder;         /* WIC encoder */
+    IWICBitmapFrameEncode *frame_encode; /* WIC frame encoder */
+    IWICStream *stream;                 /* WIC stream */
+    IStream *mem_stream;                /* In-memory encoder target */
+    bool com_entered;                   /* COM entered for this codec, left by wic_close */
+    bool container_frame;               /* Frame of a multi-frame container, sharing its encoder */
+} WicCodec;
+
+/* Filter and compression per StegPngProfile */
+static const struct {
+    uint8_t filter;
+    float compression;
+} png_profiles[] = {
+    { WICPngFilterNone, 0.0f },         /* STEG_PNG_FAST */
+    { WICPngFilterSub, 0.5f },          /* STEG_PNG_BALANCED */
+    { WICPngFilterAdaptive, 1.0f }      /* STEG_PNG_SMALL */
+};
+
+/* Lossless TIFF compression per StegPngProfile, for multi-frame output */
+static const uint8_t tiff_profiles[] = {
+    WICTiffCompressionNone,             /* STEG_PNG_FAST */
+    WICTiffCompressionLZW,              /* STEG_PNG_BALANCED */
+    WICTiffCompressionZIP               /* STEG_PNG_SMALL */
+};
+
+/* Process-wide WIC factory shared by all image operations (WIC factories are free threaded).
+   An MTA usage cookie keeps the multithreaded apartment it lives in alive while threads
+   enter and leave COM around each image. */
+static IWICImagingFactory *g_wic_factory = NULL;
+static CO_MTA_USAGE_COOKIE g_wic_mta = NULL;
+static INIT_ONCE g_wic_once = INIT_ONCE_STATIC_INIT;
+
+/* Enter COM on the calling thread for the lifetime of one codec: the multithreaded
+   apartment, or the one the caller already joined. *entered tells whether a matching
+   CoUninitialize is owed. */
+static bool wic_enter_thread(bool *entered) {
+    HRESULT hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+    
+    *entered = SUCCEEDED(hr);
+    if (hr == RPC_E_CHANGED_MODE) {
+        /* The caller owns a single-threaded apartment - WIC works in either */
+        return true;
+    }
+    if (FAILED(hr)) {
+        fprintf(stderr, "Error: Failed to initialize COM\n");
+        return false;
+    }
+    return true;
+}
+
+static BOOL CALLBACK wic_create_factory(PINIT_ONCE once, PVOID param, PVOID *context) {
+    HRESULT hr;
+    bool entered;
+    
+    (void)once;
+    (void)param;
+    (void)context;
+    
+    if (!wic_enter_thread(&entered)) {
+        return FALSE;
+    }
+    hr = CoIncrementMTAUsage(&g_wic_mta);
+    if (SUCCEEDED(hr)) {
+        hr = CoCreateInstance(&CLSID_WICImagingFactory, NULL, CLSCTX_INPROC_SERVER,
+                             &IID_IWICImagingFactory, (LPVOID*)&g_wic_factory);
+    }
+    if (FAILED(hr)) {
+        g_wic_factory = NULL;
+        if (g_wic_mta) {
+            CoDecrementMTAUsage(g_wic_mta);
+            g_wic_mta = NULL;
+        }
+    }
+    if (entered) {
+        CoUninitialize();
+    }
+    return SUCCEEDED(hr) ? TRUE : FALSE;  /* Not marked done on failure - a later call retries */
+}
+
+static bool wic_runtime_init(void) {
+    if (!InitOnceExecuteOnce(&g_wic_once, wic_create_factory, NULL, NULL)) {
+        fprintf(stderr, "Error: Failed to create WIC factory\n");
+        return false;
+    }
+    return true;
+}
+
+/* Only valid once every image is closed and the worker pool is joined (steg_runtime_shutdown
+   stops the pool first), so no thread is inside wic_runtime_init */
+static void wic_runtime_shutdown(void) {
+    if (g_wic_factory) {
+        g_wic_factory->lpVtbl->Release(g_wic_factory);
+        g_wic_factory = NULL;
+    }
+    if (g_wic_mta) {
+        CoDecrementMTAUsage(g_wic_mta);
+        g_wic_mta = NULL;
+    }
+    InitOnceInitialize(&g_wic_once);
+}
+
+/* Codec state holding a reference to the shared factory, creating it on first use */
+static WicCodec *wic_codec_create(ImageInfo *info) {
+    WicCodec *codec;
+    bool entered;
+    
+    if (!wic_runtime_init() || !wic_enter_thread(&entered)) {
+        return NULL;
+    }
+    codec = (WicCodec*)calloc(1, sizeof(WicCodec));
+    if (!codec) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        if (entered) {
+            CoUninitialize();
+        }
+        return NULL;
+    }
+    
+    codec->com_entered = entered;
+    g_wic_factory->lpVtbl->AddRef(g_wic_factory);
+    codec->factory = g_wic_factory;
+    info->codec = codec;
+    return codec;
+}
+
+static void wic_close(ImageInfo *info) {
+    WicCodec *codec = (WicCodec*)info->codec;
+    
+    if (!codec) {
+        return;
+    }
+    if (codec->frame_encode) codec->frame_encode->lpVtbl->Release(codec->frame_encode);
+    if (codec->encoder) codec->encoder->lpVtbl->Release(codec->encoder);
+    if (codec->stream) codec->stream->lpVtbl->Release(codec->stream);
+    if (codec->mem_stream) codec->mem_stream->lpVtbl->Release(codec->mem_stream);
+    if (codec->converter) codec->converter->lpVtbl->Release(codec->converter);
+    if (codec->frame) codec->frame->lpVtbl->Release(codec->frame);
+    if (codec->decoder) codec->decoder->lpVtbl->Release(codec->decoder);
+    if (codec->factory) codec->factory->lpVtbl->Release(codec->factory);
+    if (codec->com_entered) CoUninitialize();
+    free(codec);
+    info->codec = NULL;
+}
+
+/* Read geometry and pixel layout of frame from the decoder of codec */
+static bool wic_open_frame(ImageInfo *info, WicCodec *codec, uint32_t frame) {
+    HRESULT hr;
+    WICPixelFormatGUID pixelFormat;
+    UINT frames = 0;
+    
+    /* Multi-frame containers (TIFF pages, GIF frames, ICO sizes) list their frames */
+    hr = codec->decoder->lpVtbl->GetFrameCount(codec->decoder, &frames);
+    if (FAILED(hr) || frame >= frames) {
+        fprintf(stderr, "Error: Image has no frame %u\n", frame);
+        return false;
+    }
+    info->frame_count = frames;
+    
+    hr = codec->decoder->lpVtbl->GetFrame(codec->decoder, frame, &codec->frame);
+    if (FAILED(hr)) {
+        fprintf(stderr, "Error: Failed to get image frame\n");
+        return false;
+    }
+    
+    /* Get image dimensions */
+    hr = codec->frame->lpVtbl->GetSize(codec->frame, &info->width, &info->height);
+    if (FAILED(hr)) {
+        fprintf(stderr, "Error: Failed to get image dimensions\n");
+        return false;
+    }
+    
+    /* Get pixel format */
+    hr = codec->frame->lpVtbl->GetPixelFormat(codec->frame, &pixelFormat);
+    if (FAILED(hr)) {
+        fprintf(stderr, "Error: Failed to get pixel format\n");
+        return false;
+    }
+    
+    /* Keep the native WIC layout: 8/16-bit gray, BGR/BGRA, or 48/64bpp RGB(A) with 16-bit
+       samples; other formats are converted by the nearest layout as part of the single
+       copy out of the decoder */
+    const WICPixelFormatGUID *convertFormat = NULL;
+    info->bit_depth = 8;
+    info->has_alpha = false;
+    info->bgr_order = false;
+    if (IsEqualGUID(&pixelFormat, &GUID_WICPixelFormat8bppGray)) {
+        info->channels = 1;
+    } else if (IsEqualGUID(&pixelFormat, &GUID_WICPixelFormat16bppGray)) {
+        info->channels = 1;
+        info->bit_depth = 16;
+    } else if (IsEqualGUID(&pixelFormat, &GUID_WICPixelFormatBlackWhite) ||
+               IsEqualGUID(&pixelFormat, &GUID_WICPixelFormat2bppGray) ||
+               IsEqualGUID(&pixelFormat, &GUID_WICPixelFormat4bppGray)) {
+        /* Low-depth gray is unpacked to one byte per sample */
+        info->channels = 1;
+        convertFormat = &GUID_WICPixelFormat8bppGray;
+    } else if (IsEqualGUID(&pixelFormat, &GUID_WICPixelFormat48bppRGB)) {
+        info->channels = 3;
+        info->bit_depth = 16;
+    } else if (IsEqualGUID(&pixelFormat, &GUID_WICPixelFormat64bppRGBA)) {
+        info->channels = 4;
+        info->bit_depth = 16;
+        info->has_alpha = true;
+    } else if (IsEqualGUID(&pixelFormat, &GUID_WICPixelFormat24bppBGR)) {
+        info->channels = 3;
+        info->bgr_order = true;
+    } else if (IsEqualGUID(&pixelFormat, &GUID_WICPixelFormat32bppBGRA)) {
+        info->channels = 4;
+        info->has_alpha = true;
+        info->bgr_order = true;
+    } else if (IsEqualGUID(&pixelFormat, &GUID_WICPixelFormat32bppRGBA)) {
+        /* Handle RGBA formats - preserve alpha channel */
+        info->channels = 4;
+        info->has_alpha = true;
+        info->bgr_order = true;
+        convertFormat = &GUID_WICPixelFormat32bppBGRA;
+    } else {
+        /* Convert to 24bpp BGR for other formats (palettes) */
+        info->channels = 3;
+        info->bgr_order = true;
+        convertFormat = &GUID_WICPixelFormat24bppBGR;
+    }
+    info->color_type = info->channels == 1 ? PNG_COLOR_GRAYSCALE :
+                       (info->has_alpha ? PNG_COLOR_RGBA : PNG_COLOR_RGB);
+    info->bytes_per_pixel = (uint8_t)(info->channels * (info->bit_depth / 8));
+    
+    /* Format converter stays open so bands can be pulled through it */
+    if (convertFormat) {
+        hr = codec->factory->lpVtbl->CreateFormatConverter(codec->factory, &codec->converter);
+        if (SUCCEEDED(hr)) {
+            hr = codec->converter->lpVtbl->Initialize(codec->converter, (IWICBitmapSource*)codec->frame,
+                                                     convertFormat, WICBitmapDitherTypeNone,
+                                                     NULL, 0.0, WICBitmapPaletteTypeCustom);
+        }
+        if (FAILED(hr)) {
+            fprintf(stderr, "Error: Failed to create pixel format converter\n");
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+static bool wic_open_decoder(ImageInfo *info, const char *filename, const void *data, size_t size,
+                             uint32_t frame) {
+    HRESULT hr;
+    WCHAR wfilename[MAX_PATH];
+    WicCodec *codec;
+    
+    codec = wic_codec_create(info);
+    if (!codec) {
+        return false;
+    }
+    
+    if (filename) {
+        /* Convert filename to wide char */
+        MultiByteToWideChar(CP_UTF8, 0, filename, -1, wfilename, MAX_PATH);
+        
+        /* Create decoder from filename */
+        hr = codec->factory->lpVtbl->CreateDecoderFromFilename(codec->factory,
+                                                              wfilename, NULL, GENERIC_READ,
+                                                              WICDecodeMetadataCacheOnLoad,
+                                                              &codec->decoder);
+        if (FAILED(hr)) {
+            fprintf(stderr, "Error: Cannot open file %s or not a valid image\n", filename);
+            wic_close(info);
+            return false;
+        }
+    } else {
+        /* Decode straight out of the caller's buffer, which must outlive the image */
+        hr = size <= MAXDWORD ? codec->factory->lpVtbl->CreateStream(codec->factory, &codec->stream) : E_INVALIDARG;
+        if (SUCCEEDED(hr)) {
+            hr = codec->stream->lpVtbl->InitializeFromMemory(codec->stream, (BYTE*)data, (DWORD)size);
+        }
+        if (SUCCEEDED(hr)) {
+            hr = codec->factory->lpVtbl->CreateDecoderFromStream(codec->factory, (IStream*)codec->stream,
+                                                                NULL, WICDecodeMetadataCacheOnLoad,
+                                                                &codec->decoder);
+        }
+        if (FAILED(hr)) {
+            fprintf(stderr, "Error: Buffer is not a valid image\n");
+            wic_close(info);
+            return false;
+        }
+    }
+    
+    if (!wic_open_frame(info, codec, frame)) {
+        wic_close(info);
+        return false;
+    }
+    return true;
+}
+
+static bool wic_read_rows(ImageInfo *info, uint32_t y, uint32_t count) {
+    WicCodec *codec = (WicCodec*)info->codec;
+    HRESULT hr;
+    
+    if (!codec->frame) {
+        return false;
+    }
+    
+    /* Decode the rows straight into the plane - read in original format to preserve LSBs */
+    WICRect rect = {0, (INT)y, (INT)info->width, (INT)count};
+    UINT stride = (UINT)info->rowbytes;
+    UINT bufferSize = (UINT)(info->rowbytes * count);
+    
+    if (codec->converter) {
+        hr = codec->converter->lpVtbl->CopyPixels(codec->converter, &rect, stride, bufferSize, info->pixels);
+    } else {
+        hr = codec->frame->lpVtbl->CopyPixels(codec->frame, &rect, stride, bufferSize, info->pixels);
+    }
+    if (FAILED(hr)) {
+        fprintf(stderr, "Error: Failed to copy image pixels\n");
+        return false;
+    }
+    return true;
+}
+
+/* Encoder of format on filename (NULL = memory, handed out by image_encoded_data) */
+static bool wic_create_encoder(WicCodec *codec, const char *filename, const GUID *format, const char *name) {
+    HRESULT hr;
+    WCHAR wfilename[MAX_PATH];
+    IStream *target;
+    
+    if (filename) {
+        /* Convert filename to wide char */
+        MultiByteToWideChar(CP_UTF8, 0, filename, -1, wfilename, MAX_PATH);
+        
+        /* Create stream */
+        hr = codec->factory->lpVtbl->CreateStream(codec->factory, &codec->stream);
+        if (FAILED(hr)) {
+            fprintf(stderr, "Error: Failed to create WIC stream\n");
+            return false;
+        }
+        
+        /* Initialize stream from filename */
+        hr = codec->stream->lpVtbl->InitializeFromFilename(codec->stream, wfilename, GENERIC_WRITE);
+        if (FAILED(hr)) {
+            fprintf(stderr, "Error: Cannot create file %s\n", filename);
+            return false;
+        }
+        target = (IStream*)codec->stream;
+    } else {
+        /* Growable memory stream, handed out by image_encoded_data */
+        hr = CreateStreamOnHGlobal(NULL, TRUE, &codec->mem_stream);
+        if (FAILED(hr)) {
+            fprintf(stderr, "Error: Failed to create memory stream\n");
+            return false;
+        }
+        target = codec->mem_stream;
+    }
+    
+    /* Create encoder */
+    hr = codec->factory->lpVtbl->CreateEncoder(codec->factory, format, NULL, &codec->encoder);
+    if (FAILED(hr)) {
+        fprintf(stderr, "Error: Failed to create %s encoder\n", name);
+        return false;
+    }
+    
+    /* Initialize encoder */
+    hr = codec->encoder->lpVtbl->Initialize(codec->encoder, target, WICBitmapEncoderNoCache);
+    if (FAILED(hr)) {
+        fprintf(stderr, "Error: Failed to initialize %s encoder\n", name);
+        return false;
+    }
+    return true;
+}
+
+/* Next frame of codec->encoder with the geometry and layout of info; tiff selects the
+   options of a TIFF page instead of a PNG image */
+static bool wic_create_frame(ImageInfo *info, WicCodec *codec, bool tiff) {
+    HRESULT hr;
+    const char *name = tiff ? "TIFF" : "PNG";
+    
+    /* WIC has no gray + alpha format and writes 8-bit color only as BGR(A) */
+    if (info->channels == 2 || (info->channels > 2 && info->bit_depth == 8 && !info->bgr_order)) {
+        fprintf(stderr, "Error: Unsupported pixel layout for %s output\n", name);
+        return false;
+    }
+    
+    /* Create frame encoder */
+    IPropertyBag2 *propertyBag = NULL;
+    hr = codec->encoder->lpVtbl->CreateNewFrame(codec->encoder, &codec->frame_encode, &propertyBag);
+    if (FAILED(hr)) {
+        fprintf(stderr, "Error: Failed to create %s frame encoder\n", name);
+        return false;
+    }
+    
+    /* Configure the encoder for lossless steganography */
+    if (propertyBag && tiff) {
+        PROPBAG2 option = { 0 };
+        VARIANT varValue;
+        
+        /* Every TIFF compression method offered is lossless */
+        option.pstrName = L"TiffCompressionMethod";
+        VariantInit(&varValue);
+        varValue.vt = VT_UI1;
+        varValue.bVal = tiff_profiles[info->png_profile];
+        propertyBag->lpVtbl->Write(propertyBag, 1, &option, &varValue);
+        VariantClear(&varValue);
+    } else if (propertyBag) {
+        PROPBAG2 option = { 0 };
+        VARIANT varValue;
+        
+        /* Filtering only changes how rows are coded - decoded pixels are identical */
+        option.pstrName = L"FilterOption";
+        VariantInit(&varValue);
+        varValue.vt = VT_UI1;
+        varValue.bVal = png_profiles[info->png_profile].filter;
+        propertyBag->lpVtbl->Write(propertyBag, 1, &option, &varValue);
+        VariantClear(&varValue);
+        
+        /* Disable interlacing to maintain pixel order */
+        option.pstrName = L"InterlaceOption";
+        VariantInit(&varValue);
+        varValue.vt = VT_BOOL;
+        varValue.boolVal = VARIANT_FALSE;
+        propertyBag->lpVtbl->Write(propertyBag, 1, &option, &varValue);
+        VariantClear(&varValue);
+        
+        /* zlib effort - lossless at every level */
+        option.pstrName = L"CompressionLevel";
+        VariantInit(&varValue);
+        varValue.vt = VT_R4;
+        varValue.fltVal = png_profiles[info->png_profile].compression;
+        propertyBag->lpVtbl->Write(propertyBag, 1, &option, &varValue);
+        VariantClear(&varValue);
+        
+        /* Keep the plane's bit depth to ensure no bit depth conversion */
+        option.pstrName = L"BitDepth";
+        VariantInit(&varValue);
+        varValue.vt = VT_UI1;
+        varValue.bVal = info->bit_depth;
+        propertyBag->lpVtbl->Write(propertyBag, 1, &option, &varValue);
+        VariantClear(&varValue);
+        
+        /* Disable gamma correction to preserve raw pixel values */
+        option.pstrName = L"EnableV5Header32bppBGRA";
+        VariantInit(&varValue);
+        varValue.vt = VT_BOOL;
+        varValue.boolVal = VARIANT_FALSE;
+        propertyBag->lpVtbl->Write(propertyBag, 1, &option, &varValue);
+        VariantClear(&varValue);
+    }
+    
+    /* Initialize frame encoder */
+    hr = codec->frame_encode->lpVtbl->Initialize(codec->frame_encode, propertyBag);
+    if (propertyBag) {
+        propertyBag->lpVtbl->Release(propertyBag);
+    }
+    if (FAILED(hr)) {
+        fprintf(stderr, "Error: Failed to initialize %s frame encoder\n", name);
+        return false;
+    }
+    
+    /* Set frame size */
+    hr = codec->frame_encode->lpVtbl->SetSize(codec->frame_encode, info->width, info->height);
+    if (FAILED(hr)) {
+        fprintf(stderr, "Error: Failed to set frame size\n");
+        return false;
+    }
+    
+    /* Same layout as the plane, so rows are written without conversion */
+    WICPixelFormatGUID pixelFormat, requested;
+    if (info->channels == 1) {
+        requested = info->bit_depth == 16 ? GUID_WICPixelFormat16bppGray : GUID_WICPixelFormat8bppGray;
+    } else if (info->bit_depth == 16) {
+        requested = info->has_alpha ? GUID_WICPixelFormat64bppRGBA : GUID_WICPixelFormat48bppRGB;
+    } else if (info->has_alpha) {
+        requested = GUID_WICPixelFormat32bppBGRA;
+    } else {
+        requested = GUID_WICPixelFormat24bppBGR;
+    }
+    pixelFormat = requested;
+    hr = codec->frame_encode->lpVtbl->SetPixelFormat(codec->frame_encode, &pixelFormat);
+    if (FAILED(hr) || !IsEqualGUID(&pixelFormat, &requested)) {
+        /* The encoder substitutes formats it cannot write; that would reinterpret the plane */
+        fprintf(stderr, "Error: Failed to set pixel format\n");
+        return false;
+    }
+    
+    return true;
+}
+
+static bool wic_open_encoder(ImageInfo *info, const char *filename) {
+    WicCodec *codec = wic_codec_create(info);
+    
+    if (!codec) {
+        return false;
+    }
+    if (!wic_create_encoder(codec, filename, &GUID_ContainerFormatPng, "PNG") ||
+        !wic_create_frame(info, codec, false)) {
+        wic_close(info);
+        return false;
+    }
+    return true;
+}
+
+/* Multi-page TIFF: the container holds the encoder, each frame a reference to it */
+static bool wic_open_container(ImageInfo *container, const char *filename) {
+    WicCodec *codec = wic_codec_create(container);
+    
+    if (!codec) {
+        return false;
+    }
+    if (!wic_create_encoder(codec, filename, &GUID_ContainerFormatTiff, "TIFF")) {
+        wic_close(container);
+        return false;
+    }
+    return true;
+}
+
+static bool wic_open_frame_encoder(ImageInfo *info, ImageInfo *container) {
+    WicCodec *pages = (WicCodec*)container->codec;
+    WicCodec *codec;
+    
+    if (!pages || !pages->encoder) {
+        return false;
+    }
+    codec = wic_codec_create(info);
+    if (!codec) {
+        return false;
+    }
+    pages->encoder->lpVtbl->AddRef(pages->encoder);
+    codec->encoder = pages->encoder;
+    codec->container_frame = true;
+    if (!wic_create_frame(info, codec, true)) {
+        wic_close(info);
+        return false;
+    }
+    return true;
+}
+
+static bool wic_finalize_container(ImageInfo *container) {
+    WicCodec *codec = (WicCodec*)container->codec;
+    HRESULT hr;
+    
+    if (!codec->encoder) {
+        return false;
+    }
+    
+    /* Every frame is committed already */
+    hr = codec->encoder->lpVtbl->Commit(codec->encoder);
+    if (FAILED(hr)) {
+        fprintf(stderr, "Error: Failed to commit TIFF encoder\n");
+        return false;
+    }
+    return true;
+}
+
+static bool wic_write_rows(ImageInfo *info, uint32_t count) {
+    WicCodec *codec = (WicCodec*)info->codec;
+    HRESULT hr;
+    
+    if (!codec->frame_encode) {
+        return false;
+    }
+    
+    /* Rows are appended in order - the plane is already in the encoder's BGR/BGRA layout */
+    UINT stride = (UINT)info->rowbytes;
+    UINT bufferSize = (UINT)(info->rowbytes * count);
+    hr = codec->frame_encode->lpVtbl->WritePixels(codec->frame_encode, count,
+                                                 stride, bufferSize, info->pixels);
+    if (FAILED(hr)) {
+        fprintf(stderr, "Error: Failed to write pixels to PNG\n");
+        return false;
+    }
+    return true;
+}
+
+static bool wic_finalize_write(ImageInfo *info) {
+    WicCodec *codec = (WicCodec*)info->codec;
+    HRESULT hr;
+    
+    if (!codec->frame_encode || !codec->encoder) {
+        return false;
+    }
+    
+    /* Commit frame */
+    hr = codec->frame_encode->lpVtbl->Commit(codec->frame_encode);
+    if (FAILED(hr)) {
+        fprintf(stderr, "Error: Failed to commit %s frame\n", codec->container_frame ? "TIFF" : "PNG");
+        return false;
+    }
+    
+    /* The encoder of a container is committed after its last frame */
+    if (codec->container_frame) {
+        return true;
+    }
+    
+    /* Commit encoder */
+    hr = codec->encoder->lpVtbl->Commit(codec->encoder);
+    if (FAILED(hr)) {
+        fprintf(stderr, "Error: Failed to commit PNG encoder\n");
+        return false;
+    }
+    
+    return true;
+}
+
+static bool wic_encoded_data(ImageInfo *info, uint8_t **data, size_t *size) {
+    WicCodec *codec = (WicCodec*)info->codec;
+    HGLOBAL global = NULL;
+    LARGE_INTEGER zero;
+    ULARGE_INTEGER end;
+    const void *bytes;
+    HRESULT hr;
+    
+    if (!codec->mem_stream) {
+        return false;
+    }
+    
+    /* The stream position after the encoder commit is the encoded length */
+    zero.QuadPart = 0;
+    hr = codec->mem_stream->lpVtbl->Seek(codec->mem_stream, zero, STREAM_SEEK_CUR, &end);
+    if (SUCCEEDED(hr)) {
+        hr = GetHGlobalFromStream(codec->mem_stream, &global);
+    }
+    if (FAILED(hr) || end.QuadPart == 0 || end.QuadPart > SIZE_MAX) {
+        fprintf(stderr, "Error: Failed to read encoded PNG\n");
+        return false;
+    }
+    
+    *data = (uint8_t*)malloc((size_t)end.QuadPart);
+    bytes = GlobalLock(global);
+    if (!*data || !bytes) {
+        if (bytes) {
+            GlobalUnlock(global);
+        }
+        free(*data);
+        *data = NULL;
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return false;
+    }
+    memcpy(*data, bytes, (size_t)end.QuadPart);
+    GlobalUnlock(global);
+    
+    *size = (size_t)end.QuadPart;
+    return true;
+}
+
+const ImageBackend image_backend_wic = {
+    "wic",
+    wic_runtime_init,
+    wic_runtime_shutdown,
+    wic_open_decoder,
+    wic_read_rows,
+    wic_open_encoder,
+    wic_write_rows,
+    wic_finalize_write,
+    wic_encoded_data,
+    wic_open_container,
+    wic_open_frame_encoder,
+    wic_finalize_container,
+    wic_close
+};
@@ -0,0 +1,819 @@
+#include "steg.h"
+#include "kernel.h"
+#include "pool.h"
+#include "platform.h"
+#include <string.h>
+
+/* LSB of each byte in a 64-bit word */
+#define LSB_MASK_64 0x0101010101010101ULL
+
+/* LSB of each even byte: the low byte of 16-bit samples, or the gray byte of gray + alpha */
+#define WIDE_LSB_MASK_64 0x0001000100010001ULL
+
+/* R, G and B low-byte LSBs of one RGBA64 pixel */
+#define RGBA64_LSB_MASK_64 0x0000000100010001ULL
+
+/* Transfers at least this long are split across the shared thread pool */
+#define KERNEL_PARALLEL_MIN_BITS (1u << 20)
+
+/* Parallel slices are multiples of 24 bits so each starts on a payload byte with the same
+   channel phase; 192 keeps whole 8-pixel groups for the 3-channel kernels and is a multiple
+   of every bit-plane depth, so slices also start on a sample */
+#define KERNEL_PARALLEL_ALIGN_BITS 192u
+
+/* Sample bytes kept intact when embedding into two RGBA pixels (alpha bytes untouched) */
+#define RGBA_KEEP_64 0xFFFEFEFEFFFEFEFEULL
+
+/* Cursor over usable samples of the pixel plane, in canonical channel order */
+typedef struct {
+    uint8_t *pixel;         /* Current pixel */
+    const uint8_t *order;   /* Byte index of each canonical channel within a pixel */
+    uint8_t channel;        /* Canonical channel of the current sample */
+    uint8_t usable;         /* Usable channels per pixel */
+    uint8_t bpp;            /* Bytes per pixel */
+} SampleCursor;
+
+/* Canonical R,G,B(,A) channel -> byte index of its LSB for each memory order */
+static const uint8_t order_rgb[4] = { 0, 1, 2, 3 };
+static const uint8_t order_bgr[4] = { 2, 1, 0, 3 };
+static const uint8_t order_rgb16[4] = { 0, 2, 4, 6 };
+
+/* Little-endian 64-bit access to eight sample bytes */
+static inline uint64_t load64(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void store64(uint8_t *p, uint64_t v) {
+    memcpy(p, &v, sizeof(v));
+}
+
+/* Spread bit k of b into the LSB of byte k */
+static inline uint64_t spread_bits(uint8_t b) {
+    uint64_t x = b;
+    x = (x | (x << 28)) & 0x0000000F0000000FULL;
+    x = (x | (x << 14)) & 0x0003000300030003ULL;
+    x = (x | (x << 7)) & LSB_MASK_64;
+    return x;
+}
+
+/* Gather the LSB of byte k into bit k */
+static inline uint8_t gather_bits(uint64_t v) {
+    return (uint8_t)(((v & LSB_MASK_64) * 0x0102040810204080ULL) >> 56);
+}
+
+/* Spread bits 0-3 of b into the LSBs of bytes 0, 2, 4 and 6 */
+static inline uint64_t spread_bits_wide(uint8_t b) {
+    uint64_t x = spread_bits((uint8_t)(b & 0x0F));
+    x = (x | (x << 16)) & 0x0000FFFF0000FFFFULL;
+    return (x | (x << 8)) & 0x00FF00FF00FF00FFULL;
+}
+
+/* Gather the LSBs of bytes 0, 2, 4 and 6 into bits 0-3 */
+static inline uint8_t gather_bits_wide(uint64_t v) {
+    uint64_t x = v & WIDE_LSB_MASK_64;
+    x = (x | (x >> 8)) & 0x0000FFFF0000FFFFULL;
+    return gather_bits((x | (x >> 16)) & 0xFFFFFFFFULL);
+}
+
+/* Position a cursor at a stream bit offset (the only division in a transfer) */
+static void cursor_init(SampleCursor *cur, const ImageInfo *img, size_t offset) {
+    cur->usable = (uint8_t)(img->channels - (img->has_alpha ? 1 : 0));
+    cur->bpp = img->bytes_per_pixel;
+    if (img->bgr_order && cur->usable == 3) {
+        cur->order = order_bgr;
+    } else {
+        /* 16-bit samples are stored low byte first */
+        cur->order = img->bit_depth == 16 ? order_rgb16 : order_rgb;
+    }
+    cur->channel = (uint8_t)(offset % cur->usable);
+    cur->pixel = img->pixels + (offset / cur->usable) * img->bytes_per_pixel;
+}
+
+static inline uint8_t *cursor_sample(const SampleCursor *cur) {
+    return cur->pixel + cur->order[cur->channel];
+}
+
+/* Advance by a whole number of samples (dense layouts only, where every byte is a sample) */
+static inline void cursor_advance(SampleCursor *cur, size_t samples) {
+    size_t pos = cur->channel + samples;
+    cur->pixel += (pos / cur->usable) * cur->bpp;
+    cur->channel = (uint8_t)(pos % cur->usable);
+}
+
+static inline void cursor_next(SampleCursor *cur) {
+    if (++cur->channel == cur->usable) {
+        cur->channel = 0;
+        cur->pixel += cur->bpp;
+    }
+}
+
+/* Per-bit cursor walk used for unaligned heads and tails */
+static void cursor_embed(SampleCursor *cur, const uint8_t *src, size_t first, size_t count) {
+    for (size_t i = first; i < first + count; i++) {
+        uint8_t *p = cursor_sample(cur);
+        *p = (uint8_t)((*p & 0xFE) | ((src[i >> 3] >> (i & 7)) & 1));
+        cursor_next(cur);
+    }
+}
+
+static void cursor_extract(SampleCursor *cur, uint8_t *dst, size_t first, size_t count) {
+    for (size_t i = first; i < first + count; i++) {
+        dst[i >> 3] |= (uint8_t)((*cursor_sample(cur) & 1) << (i & 7));
+        cursor_next(cur);
+    }
+}
+
+/* Dense layouts (every byte is a sample): one payload byte per 8 sample bytes */
+void lsb_embed_dense_scalar(uint8_t *p, const uint8_t *src, size_t nbytes) {
+    for (size_t i = 0; i < nbytes; i++, p += 8) {
+        store64(p, (load64(p) & ~LSB_MASK_64) | spread_bits(src[i]));
+    }
+}
+
+void lsb_extract_dense_scalar(const uint8_t *p, uint8_t *dst, size_t nbytes) {
+    for (size_t i = 0; i < nbytes; i++, p += 8) {
+        dst[i] = gather_bits(load64(p));
+    }
+}
+
+/* Wide layouts: one payload byte per 8 samples spaced two bytes apart */
+void lsb_embed_wide_scalar(uint8_t *p, const uint8_t *src, size_t nbytes) {
+    for (size_t i = 0; i < nbytes; i++, p += 16) {
+        store64(p, (load64(p) & ~WIDE_LSB_MASK_64) | spread_bits_wide(src[i]));
+        store64(p + 8, (load64(p + 8) & ~WIDE_LSB_MASK_64) | spread_bits_wide((uint8_t)(src[i] >> 4)));
+    }
+}
+
+void lsb_extract_wide_scalar(const uint8_t *p, uint8_t *dst, size_t nbytes) {
+    for (size_t i = 0; i < nbytes; i++, p += 16) {
+        dst[i] = (uint8_t)(gather_bits_wide(load64(p)) | (gather_bits_wide(load64(p + 8)) << 4));
+    }
+}
+
+/* RGBA: three payload bytes per 8 pixels (32 sample bytes), alpha skipped */
+void lsb_embed_rgba_scalar(uint8_t *p, const uint8_t *src, size_t ngroups) {
+    for (size_t g = 0; g < ngroups; g++, src += 3) {
+        uint32_t bits = (uint32_t)src[0] | ((uint32_t)src[1] << 8) | ((uint32_t)src[2] << 16);
+        for (int k = 0; k < 4; k++, p += 8, bits >>= 6) {
+            /* Six payload bits for two pixels, with a gap at each alpha position */
+            uint8_t e = (uint8_t)((bits & 0x07) | ((bits & 0x38) << 1));
+            store64(p, (load64(p) & RGBA_KEEP_64) | spread_bits(e));
+        }
+    }
+}
+
+void lsb_extract_rgba_scalar(const uint8_t *p, uint8_t *dst, size_t ngroups) {
+    for (size_t g = 0; g < ngroups; g++, dst += 3) {
+        uint32_t bits = 0;
+        for (int k = 0; k < 4; k++, p += 8) {
+            uint32_t m = gather_bits(load64(p));
+            bits |= ((m & 0x07) | ((m >> 1) & 0x38)) << (6 * k);
+        }
+        dst[0] = (uint8_t)bits;
+        dst[1] = (uint8_t)(bits >> 8);
+        dst[2] = (uint8_t)(bits >> 16);
+    }
+}
+
+/* BGR: three payload bytes per 8 pixels (24 sample bytes), channels reordered to R,G,B */
+void lsb_embed_bgr_scalar(uint8_t *p, const uint8_t *src, size_t ngroups) {
+    for (size_t g = 0; g < ngroups; g++, src += 3) {
+        uint64_t bits = bgr_swap_bits((uint64_t)src[0] | ((uint64_t)src[1] << 8) | ((uint64_t)src[2] << 16));
+        for (int k = 0; k < 3; k++, p += 8, bits >>= 8) {
+            store64(p, (load64(p) & ~LSB_MASK_64) | spread_bits((uint8_t)bits));
+        }
+    }
+}
+
+void lsb_extract_bgr_scalar(const uint8_t *p, uint8_t *dst, size_t ngroups) {
+    for (size_t g = 0; g < ngroups; g++, dst += 3, p += 24) {
+        uint64_t m = (uint64_t)gather_bits(load64(p)) | ((uint64_t)gather_bits(load64(p + 8)) << 8) |
+                     ((uint64_t)gather_bits(load64(p + 16)) << 16);
+        uint64_t bits = bgr_swap_bits(m);
+        dst[0] = (uint8_t)bits;
+        dst[1] = (uint8_t)(bits >> 8);
+        dst[2] = (uint8_t)(bits >> 16);
+    }
+}
+
+/* BGRA: as RGBA, with the color channels of each pixel reordered to R,G,B */
+void lsb_embed_bgra_scalar(uint8_t *p, const uint8_t *src, size_t ngroups) {
+    for (size_t g = 0; g < ngroups; g++, src += 3) {
+        uint32_t bits = (uint32_t)src[0] | ((uint32_t)src[1] << 8) | ((uint32_t)src[2] << 16);
+        for (int k = 0; k < 4; k++, p += 8, bits >>= 6) {
+            uint8_t e = (uint8_t)bgra_swap_bits((bits & 0x07) | ((bits & 0x38) << 1));
+            store64(p, (load64(p) & RGBA_KEEP_64) | spread_bits(e));
+        }
+    }
+}
+
+void lsb_extract_bgra_scalar(const uint8_t *p, uint8_t *dst, size_t ngroups) {
+    for (size_t g = 0; g < ngroups; g++, dst += 3) {
+        uint32_t bits = 0;
+        for (int k = 0; k < 4; k++, p += 8) {
+            uint32_t m = bgra_swap_bits(gather_bits(load64(p)));
+            bits |= ((m & 0x07) | ((m >> 1) & 0x38)) << (6 * k);
+        }
+        dst[0] = (uint8_t)bits;
+        dst[1] = (uint8_t)(bits >> 8);
+        dst[2] = (uint8_t)(bits >> 16);
+    }
+}
+
+/* RGBA64: three payload bytes per 8 pixels (64 bytes), one pixel per word, alpha skipped */
+void lsb_embed_rgba64_scalar(uint8_t *p, const uint8_t *src, size_t ngroups) {
+    for (size_t g = 0; g < ngroups; g++, src += 3) {
+        uint32_t bits = (uint32_t)src[0] | ((uint32_t)src[1] << 8) | ((uint32_t)src[2] << 16);
+        for (int k = 0; k < 8; k++, p += 8, bits >>= 3) {
+            store64(p, (load64(p) & ~RGBA64_LSB_MASK_64) | spread_bits_wide((uint8_t)(bits & 0x07)));
+        }
+    }
+}
+
+void lsb_extract_rgba64_scalar(const uint8_t *p, uint8_t *dst, size_t ngroups) {
+    for (size_t g = 0; g < ngroups; g++, dst += 3) {
+        uint32_t bits = 0;
+        for (int k = 0; k < 8; k++, p += 8) {
+            bits |= (uint32_t)(gather_bits_wide(load64(p)) & 0x07) << (3 * k);
+        }
+        dst[0] = (uint8_t)bits;
+        dst[1] = (uint8_t)(bits >> 8);
+        dst[2] = (uint8_t)(bits >> 16);
+    }
+}
+
+static const StegKernelOps kernel_scalar = {
+    STEG_KERNEL_SCALAR, "scalar",
+    lsb_embed_dense_scalar, lsb_extract_dense_scalar,
+    lsb_embed_wide_scalar, lsb_extract_wide_scalar,
+    lsb_embed_bgr_scalar, lsb_extract_bgr_scalar,
+    lsb_embed_rgba_scalar, lsb_extract_rgba_scalar,
+    lsb_embed_bgra_scalar, lsb_extract_bgra_scalar,
+    lsb_embed_rgba64_scalar, lsb_extract_rgba64_scalar
+};
+
+/* Selected kernel table; resolved on first use (every thread resolves the same table) */
+static const StegKernelOps *active_kernel = NULL;
+static PlatformOnce g_kernel_once = PLATFORM_ONCE_INIT;
+
+const StegKernelOps *steg_kernel_ops(StegKernelVariant variant) {
+    static const StegKernelVariant preference[] = { STEG_KERNEL_AVX2, STEG_KERNEL_SSE2, STEG_KERNEL_NEON };
+    
+    switch (variant) {
+        case STEG_KERNEL_AUTO:
+            for (size_t i = 0; i < sizeof(preference) / sizeof(preference[0]); i++) {
+                const StegKernelOps *ops = kernel_simd_ops(preference[i]);
+                if (ops) {
+                    return ops;
+                }
+            }
+            return &kernel_scalar;
+        case STEG_KERNEL_SCALAR:
+            return &kernel_scalar;
+        default:
+            return kernel_simd_ops(variant);
+    }
+}
+
+bool steg_kernel_select(StegKernelVariant variant) {
+    const StegKernelOps *ops = steg_kernel_ops(variant);
+    if (!ops) {
+        return false;
+    }
+    active_kernel = ops;
+    return true;
+}
+
+static void kernel_select_auto(void) {
+    if (!active_kernel) {
+        active_kernel = steg_kernel_ops(STEG_KERNEL_AUTO);
+    }
+}
+
+const StegKernelOps *steg_kernel_active(void) {
+    /* Concurrent first transfers (batch workers) must not race on the dispatch */
+    platform_once(&g_kernel_once, kernel_select_auto);
+    return active_kernel;
+}
+
+/* ---- Multi-bit-plane transfers: sample s carries stream bits [s * depth, (s + 1) * depth),
+   lowest plane first. The helpers are forced inline into the per-depth wrappers below (a
+   plain inline hint is not enough for compilers to copy them three times), so every depth
+   gets its own code with constant shifts and masks. ---- */
+
+/* Low n bits set, for n up to 63 */
+#define LOW_BITS_64(n) ((1ULL << (n)) - 1)
+
+/* Little-endian access to n payload bytes (n <= 8) */
+static inline uint64_t load_bytes(const uint8_t *p, const unsigned n) {
+    uint64_t v = 0;
+    for (unsigned i = 0; i < n; i++) {
+        v |= (uint64_t)p[i] << (8 * i);
+    }
+    return v;
+}
+
+static inline void store_bytes(uint8_t *p, uint64_t v, const unsigned n) {
+    for (unsigned i = 0; i < n; i++) {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+/* spread_bits for depth-bit fields: field k of x (8 * depth bits) into the low bits of byte k */
+static inline uint64_t spread_planes(uint64_t x, const unsigned depth) {
+    x = (x | (x << (32 - 4 * depth))) & (0x0000000100000001ULL * LOW_BITS_64(4 * depth));
+    x = (x | (x << (16 - 2 * depth))) & (0x0001000100010001ULL * LOW_BITS_64(2 * depth));
+    return (x | (x << (8 - depth))) & (LSB_MASK_64 * LOW_BITS_64(depth));
+}
+
+/* Inverse of spread_planes */
+static inline uint64_t gather_planes(uint64_t v, const unsigned depth) {
+    uint64_t x = v & (LSB_MASK_64 * LOW_BITS_64(depth));
+    x = (x | (x >> (8 - depth))) & (0x0001000100010001ULL * LOW_BITS_64(2 * depth));
+    x = (x | (x >> (16 - 2 * depth))) & (0x0000000100000001ULL * LOW_BITS_64(4 * depth));
+    return (x | (x >> (32 - 4 * depth))) & LOW_BITS_64(8 * depth);
+}
+
+/* Four depth-bit fields of x into the low bits of bytes 0, 2, 4 and 6 */
+static inline uint64_t spread_planes_wide(uint64_t x, const unsigned depth) {
+    x = (x | (x << (32 - 2 * depth))) & (0x0000000100000001ULL * LOW_BITS_64(2 * depth));
+    return (x | (x << (16 - depth))) & (WIDE_LSB_MASK_64 * LOW_BITS_64(depth));
+}
+
+static inline uint64_t gather_planes_wide(uint64_t v, const unsigned depth) {
+    uint64_t x = v & (WIDE_LSB_MASK_64 * LOW_BITS_64(depth));
+    x = (x | (x >> (16 - depth))) & (0x0000000100000001ULL * LOW_BITS_64(2 * depth));
+    return (x | (x >> (32 - 2 * depth))) & LOW_BITS_64(4 * depth);
+}
+
+/* bgr_swap_bits for depth-bit fields: swap the outer fields of each of the first four
+   3-field pixels of m; it is its own inverse */
+static inline uint64_t bgr_swap_planes(uint64_t m, const unsigned depth) {
+    uint64_t field = LOW_BITS_64(depth);
+    uint64_t outer = 0;
+    uint64_t inner = 0;
+    for (unsigned i = 0; i < 4; i++) {
+        outer |= field << (3 * depth * i);
+        inner |= field << (3 * depth * i + depth);
+    }
+    return (m & inner) | ((m >> (2 * depth)) & outer) | ((m << (2 * depth)) & (outer << (2 * depth)));
+}
+
+/* Groups of 8 samples spaced step bytes apart (1 = dense, 2 = wide): depth payload bytes each */
+static PLATFORM_FORCE_INLINE void depth_embed_groups(uint8_t *p, const uint8_t *src, size_t ngroups,
+                                                     const unsigned depth, const unsigned step) {
+    const uint64_t keep = ~((step == 1 ? LSB_MASK_64 : WIDE_LSB_MASK_64) * LOW_BITS_64(depth));
+    
+    for (size_t g = 0; g < ngroups; g++, p += 8 * step, src += depth) {
+        uint64_t bits = load_bytes(src, depth);
+        if (step == 1) {
+            store64(p, (load64(p) & keep) | spread_planes(bits, depth));
+        } else {
+            store64(p, (load64(p) & keep) | spread_planes_wide(bits & LOW_BITS_64(4 * depth), depth));
+            store64(p + 8, (load64(p + 8) & keep) | spread_planes_wide(bits >> (4 * depth), depth));
+        }
+    }
+}
+
+static PLATFORM_FORCE_INLINE void depth_extract_groups(const uint8_t *p, uint8_t *dst, size_t ngroups,
+                                                       const unsigned depth, const unsigned step) {
+    for (size_t g = 0; g < ngroups; g++, p += 8 * step, dst += depth) {
+        uint64_t bits;
+        if (step == 1) {
+            bits = gather_planes(load64(p), depth);
+        } else {
+            bits = gather_planes_wide(load64(p), depth) | (gather_planes_wide(load64(p + 8), depth) << (4 * depth));
+        }
+        store_bytes(dst, bits, depth);
+    }
+}
+
+/* Groups of 8 pixels with 3 usable channels (24 samples, 3 * depth payload bytes), held as two
+   halves of 4 pixels each. bpp 3 is BGR, bpp 4 RGBA or BGRA and 8 RGBA64; alpha is untouched
+   and BGR memory order is swapped to R,G,B as in the depth 1 kernels. */
+static inline void depth_load_pixels(const uint8_t *src, uint64_t half[2], const unsigned depth) {
+    const unsigned n = 3 * depth;
+    uint64_t lo = load_bytes(src, n < 8 ? n : 8);
+    uint64_t hi = n > 8 ? load_bytes(src + 8, n - 8) : 0;
+    
+    half[0] = lo & LOW_BITS_64(12 * depth);
+    half[1] = ((lo >> (12 * depth)) | (hi << (64 - 12 * depth))) & LOW_BITS_64(12 * depth);
+}
+
+static inline void depth_store_pixels(uint8_t *dst, const uint64_t half[2], const unsigned depth) {
+    const unsigned n = 3 * depth;
+    
+    store_bytes(dst, half[0] | (half[1] << (12 * depth)), n < 8 ? n : 8);
+    if (n > 8) {
+        store_bytes(dst + 8, half[1] >> (64 - 12 * depth), n - 8);
+    }
+}
+
+static PLATFORM_FORCE_INLINE void depth_embed_pixels(uint8_t *p, const uint8_t *src, size_t ngroups,
+                                                     const unsigned depth, const unsigned bpp, bool bgr) {
+    const uint64_t field = LOW_BITS_64(depth);
+    
+    for (size_t g = 0; g < ngroups; g++, p += 8 * bpp, src += 3 * depth) {
+        uint64_t half[2];
+        depth_load_pixels(src, half, depth);
+        if (bgr) {
+            half[0] = bgr_swap_planes(half[0], depth);
+            half[1] = bgr_swap_planes(half[1], depth);
+        }
+        if (bpp == 3) {
+            const uint64_t keep = ~(LSB_MASK_64 * field);
+            uint64_t w[3];
+            w[0] = half[0] & LOW_BITS_64(8 * depth);
+            w[1] = ((half[0] >> (8 * depth)) | (half[1] << (4 * depth))) & LOW_BITS_64(8 * depth);
+            w[2] = half[1] >> (4 * depth);
+            for (unsigned k = 0; k < 3; k++) {
+                store64(p + 8 * k, (load64(p + 8 * k) & keep) | spread_planes(w[k], depth));
+            }
+        } else if (bpp == 4) {
+            /* Two pixels per word, with an empty field at each alpha position */
+            const uint64_t keep = ~((LSB_MASK_64 * field) & 0x00FFFFFF00FFFFFFULL);
+            for (unsigned k = 0; k < 4; k++) {
+                uint64_t c = (half[k >> 1] >> (6 * depth * (k & 1))) & LOW_BITS_64(6 * depth);
+                uint64_t e = (c & LOW_BITS_64(3 * depth)) | ((c >> (3 * depth)) << (4 * depth));
+                store64(p + 8 * k, (load64(p + 8 * k) & keep) | spread_planes(e, depth));
+            }
+        } else {
+            const uint64_t keep = ~(RGBA64_LSB_MASK_64 * field);
+            for (unsigned k = 0; k < 8; k++) {
+                uint64_t c = (half[k >> 2] >> (3 * depth * (k & 3))) & LOW_BITS_64(3 * depth);
+                store64(p + 8 * k, (load64(p + 8 * k) & keep) | spread_planes_wide(c, depth));
+            }
+        }
+    }
+}
+
+static PLATFORM_FORCE_INLINE void depth_extract_pixels(const uint8_t *p, uint8_t *dst, size_t ngroups,
+                                                       const unsigned depth, const unsigned bpp, bool bgr) {
+    for (size_t g = 0; g < ngroups; g++, p += 8 * bpp, dst += 3 * depth) {
+        uint64_t half[2] = { 0, 0 };
+        if (bpp == 3) {
+            uint64_t w0 = gather_planes(load64(p), depth);
+            uint64_t w1 = gather_planes(load64(p + 8), depth);
+            uint64_t w2 = gather_planes(load64(p + 16), depth);
+            half[0] = w0 | ((w1 & LOW_BITS_64(4 * depth)) << (8 * depth));
+            half[1] = (w1 >> (4 * depth)) | (w2 << (4 * depth));
+        } else if (bpp == 4) {
+            for (unsigned k = 0; k < 4; k++) {
+                uint64_t e = gather_planes(load64(p + 8 * k), depth);
+                uint64_t c = (e & LOW_BITS_64(3 * depth)) | (((e >> (4 * depth)) & LOW_BITS_64(3 * depth)) << (3 * depth));
+                half[k >> 1] |= c << (6 * depth * (k & 1));
+            }
+        } else {
+            for (unsigned k = 0; k < 8; k++) {
+                uint64_t c = gather_planes_wide(load64(p + 8 * k), depth) & LOW_BITS_64(3 * depth);
+                half[k >> 2] |= c << (3 * depth * (k & 3));
+            }
+        }
+        if (bgr) {
+            half[0] = bgr_swap_planes(half[0], depth);
+            half[1] = bgr_swap_planes(half[1], depth);
+        }
+        depth_store_pixels(dst, half, depth);
+    }
+}
+
+/* Per-sample cursor walk over stream bits [first, first + count); the first sample is entered
+   at bit plane phase and the last one may take fewer than depth bits */
+static PLATFORM_FORCE_INLINE void depth_embed_walk(SampleCursor *cur, const uint8_t *src, size_t first,
+                                                   size_t count, unsigned phase, const unsigned depth) {
+    size_t end = first + count;
+    
+    for (size_t i = first; i < end; phase = 0) {
+        unsigned n = end - i < depth - phase ? (unsigned)(end - i) : depth - phase;
+        unsigned shift = (unsigned)(i & 7);
+        unsigned value = src[i >> 3] >> shift;
+        unsigned mask = ((1u << n) - 1) << phase;
+        uint8_t *p = cursor_sample(cur);
+        
+        /* Samples straddle payload bytes only at depth 3 or off phase */
+        if (shift + n > 8) {
+            value |= (unsigned)src[(i >> 3) + 1] << (8 - shift);
+        }
+        *p = (uint8_t)((*p & ~mask) | ((value << phase) & mask));
+        cursor_next(cur);
+        i += n;
+    }
+}
+
+/* Bytes of dst touched are expected to be zeroed */
+static PLATFORM_FORCE_INLINE void depth_extract_walk(SampleCursor *cur, uint8_t *dst, size_t first,
+                                                     size_t count, unsigned phase, const unsigned depth) {
+    size_t end = first + count;
+    
+    for (size_t i = first; i < end; phase = 0) {
+        unsigned n = end - i < depth - phase ? (unsigned)(end - i) : depth - phase;
+        unsigned shift = (unsigned)(i & 7);
+        unsigned value = (*cursor_sample(cur) >> phase) & ((1u << n) - 1);
+        
+        dst[i >> 3] |= (uint8_t)(value << shift);
+        if (shift + n > 8) {
+            dst[(i >> 3) + 1] |= (uint8_t)(value >> (8 - shift));
+        }
+        cursor_next(cur);
+        i += n;
+    }
+}
+
+/* Number of head bits to walk before a pixel group kernel can take over, or SIZE_MAX if
+   stream bit start_offset never lines up with one */
+static size_t group_head_bits(size_t start_offset, unsigned depth) {
+    /* Need a payload byte boundary that is also the lowest plane of the first channel of a pixel */
+    size_t head = 0;
+    while ((start_offset + head) % (3 * depth) != 0) {
+        head += 8;
+        if (head >= 24 * depth) {
+            return SIZE_MAX;
+        }
+    }
+    return head;
+}
+
+/* Word kernels for layouts whose sample bytes are evenly spaced or form 3-channel pixels, the
+   cursor for the rest, for heads up to a group boundary and for tails */
+static PLATFORM_FORCE_INLINE void depth_embed_range(const ImageInfo *img, const uint8_t *src, size_t nbits,
+                                                    size_t start_offset, const unsigned depth) {
+    SampleCursor cur;
+    unsigned phase = (unsigned)(start_offset % depth);
+    size_t ngroups = phase ? 0 : nbits / (8 * depth);
+    size_t done = 0;
+    
+    cursor_init(&cur, img, start_offset / depth);
+    
+    if (cur.bpp == cur.usable && cur.order == order_rgb) {
+        depth_embed_groups(cursor_sample(&cur), src, ngroups, depth, 1);
+        cursor_advance(&cur, ngroups * 8);
+        done = ngroups * 8 * depth;
+    } else if (cur.bpp == cur.usable * 2 && cur.order != order_bgr) {
+        depth_embed_groups(cursor_sample(&cur), src, ngroups, depth, 2);
+        cursor_advance(&cur, ngroups * 8);
+        done = ngroups * 8 * depth;
+    } else if (cur.usable == 3) {
+        size_t head = group_head_bits(start_offset, depth);
+        if (head < nbits) {
+            depth_embed_walk(&cur, src, 0, head, phase, depth);
+            phase = 0;
+            ngroups = (nbits - head) / (24 * depth);
+            depth_embed_pixels(cur.pixel, src + (head >> 3), ngroups, depth, cur.bpp,
+                               cur.order == order_bgr);
+            cur.pixel += ngroups * 8 * cur.bpp;
+            done = head + ngroups * 24 * depth;
+        }
+    }
+    depth_embed_walk(&cur, src, done, nbits - done, phase, depth);
+}
+
+static PLATFORM_FORCE_INLINE void depth_extract_range(const ImageInfo *img, uint8_t *dst, size_t nbits,
+                                                      size_t start_offset, const unsigned depth) {
+    SampleCursor cur;
+    unsigned phase = (unsigned)(start_offset % depth);
+    size_t ngroups = phase ? 0 : nbits / (8 * depth);
+    size_t done = 0;
+    
+    cursor_init(&cur, img, start_offset / depth);
+    
+    if (cur.bpp == cur.usable && cur.order == order_rgb) {
+        depth_extract_groups(cursor_sample(&cur), dst, ngroups, depth, 1);
+        cursor_advance(&cur, ngroups * 8);
+        done = ngroups * 8 * depth;
+    } else if (cur.bpp == cur.usable * 2 && cur.order != order_bgr) {
+        depth_extract_groups(cursor_sample(&cur), dst, ngroups, depth, 2);
+        cursor_advance(&cur, ngroups * 8);
+        done = ngroups * 8 * depth;
+    } else if (cur.usable == 3) {
+        size_t head = group_head_bits(start_offset, depth);
+        if (head < nbits) {
+            memset(dst, 0, head >> 3);
+            depth_extract_walk(&cur, dst, 0, head, phase, depth);
+            phase = 0;
+            ngroups = (nbits - head) / (24 * depth);
+            depth_extract_pixels(cur.pixel, dst + (head >> 3), ngroups, depth, cur.bpp,
+                                 cur.order == order_bgr);
+            cur.pixel += ngroups * 8 * cur.bpp;
+            done = head + ngroups * 24 * depth;
+        }
+    }
+    memset(dst + (done >> 3), 0, ((nbits + 7) >> 3) - (done >> 3));
+    depth_extract_walk(&cur, dst, done, nbits - done, phase, depth);
+}
+
+typedef void (*DepthEmbedFn)(const ImageInfo *img, const uint8_t *src, size_t nbits, size_t start_offset);
+typedef void (*DepthExtractFn)(const ImageInfo *img, uint8_t *dst, size_t nbits, size_t start_offset);
+
+#define DEPTH_KERNELS(d) \
+    static void depth_embed_##d(const ImageInfo *img, const uint8_t *src, size_t nbits, size_t start_offset) { \
+        depth_embed_range(img, src, nbits, start_offset, d); \
+    } \
+    static void depth_extract_##d(const ImageInfo *img, uint8_t *dst, size_t nbits, size_t start_offset) { \
+        depth_extract_range(img, dst, nbits, start_offset, d); \
+    }
+
+DEPTH_KERNELS(2)
+DEPTH_KERNELS(3)
+DEPTH_KERNELS(4)
+
+/* Indexed by depth; depth 1 uses the LSB kernel tables */
+static const DepthEmbedFn depth_embed[STEG_MAX_DEPTH + 1] = { NULL, NULL, depth_embed_2, depth_embed_3, depth_embed_4 };
+static const DepthExtractFn depth_extract[STEG_MAX_DEPTH + 1] = {
+    NULL, NULL, depth_extract_2, depth_extract_3, depth_extract_4
+};
+
+/* Bits per sample of a transfer (0 in a zeroed context means the LSB only) */
+static unsigned transfer_depth(const StegContext *ctx) {
+    return ctx->depth ? ctx->depth : 1;
+}
+
+/* Validate a transfer of nbits starting at start_offset and make the offset band relative */
+static bool transfer_valid(const StegContext *ctx, size_t nbits, size_t *start_offset) {
+    if (!ctx || !ctx->image || !ctx->image->pixels || ctx->depth > STEG_MAX_DEPTH) {
+        return false;
+    }
+    
+    const ImageInfo *img = ctx->image;
+    unsigned depth = transfer_depth(ctx);
+    size_t row_bits = (size_t)img->width * (img->channels - (img->has_alpha ? 1 : 0)) * depth;
+    size_t band_lo = row_bits * img->band_y;
+    size_t band_bits = row_bits * img->band_rows;
+    
+    if (*start_offset < band_lo || *start_offset - band_lo > band_bits ||
+        nbits > band_bits - (*start_offset - band_lo)) {
+        return false;
+    }
+    *start_offset -= band_lo;
+    return true;
+}
+
+/* Embed nbits at a band relative start_offset on the calling thread */
+static void embed_range(const ImageInfo *img, const StegKernelOps *ops, unsigned depth,
+                        const uint8_t *src, size_t nbits, size_t start_offset) {
+    SampleCursor cur;
+    size_t done = 0;
+    
+    if (depth > 1) {
+        depth_embed[depth](img, src, nbits, start_offset);
+        return;
+    }
+    
+    cursor_init(&cur, img, start_offset);
+    
+    if (cur.bpp == cur.usable && cur.order == order_rgb) {
+        /* Dense layout in canonical order - payload bytes map directly onto byte runs */
+        size_t nbytes = nbits >> 3;
+        ops->embed_dense(cursor_sample(&cur), src, nbytes);
+        cursor_advance(&cur, nbytes * 8);
+        done = nbytes * 8;
+    } else if (cur.bpp == cur.usable * 2 && cur.order != order_bgr) {
+        /* Wide layout - every other byte carries a sample LSB */
+        size_t nbytes = nbits >> 3;
+        ops->embed_wide(cursor_sample(&cur), src, nbytes);
+        cursor_advance(&cur, nbytes * 8);
+        done = nbytes * 8;
+    } else if (cur.usable == 3) {
+        /* BGR/RGBA/BGRA/RGBA64 - walk to a pixel group boundary, then 24 bits at a time */
+        LsbEmbedFn embed = cur.bpp == 3 ? ops->embed_bgr : cur.bpp == 8 ? ops->embed_rgba64 :
+                           (cur.order == order_bgr ? ops->embed_bgra : ops->embed_rgba);
+        size_t head = group_head_bits(start_offset, 1);
+        if (head < nbits) {
+            cursor_embed(&cur, src, 0, head);
+            size_t ngroups = (nbits - head) / 24;
+            embed(cur.pixel, src + (head >> 3), ngroups);
+            cur.pixel += ngroups * 8 * cur.bpp;
+            done = head + ngroups * 24;
+        }
+    }
+    
+    /* Remaining bits (tail, or layouts without a word kernel) */
+    cursor_embed(&cur, src, done, nbits - done);
+}
+
+/* Extract nbits at a band relative start_offset on the calling thread */
+static void extract_range(const ImageInfo *img, const StegKernelOps *ops, unsigned depth,
+                          uint8_t *dst, size_t nbits, size_t start_offset) {
+    SampleCursor cur;
+    size_t done = 0;
+    
+    if (depth > 1) {
+        depth_extract[depth](img, dst, nbits, start_offset);
+        return;
+    }
+    
+    /* Partial trailing byte is accumulated bit by bit */
+    if (nbits & 7) {
+        dst[nbits >> 3] = 0;
+    }
+    
+    cursor_init(&cur, img, start_offset);
+    
+    if (cur.bpp == cur.usable && cur.order == order_rgb) {
+        size_t nbytes = nbits >> 3;
+        ops->extract_dense(cursor_sample(&cur), dst, nbytes);
+        cursor_advance(&cur, nbytes * 8);
+        done = nbytes * 8;
+    } else if (cur.bpp == cur.usable * 2 && cur.order != order_bgr) {
+        size_t nbytes = nbits >> 3;
+        ops->extract_wide(cursor_sample(&cur), dst, nbytes);
+        cursor_advance(&cur, nbytes * 8);
+        done = nbytes * 8;
+    } else if (cur.usable == 3) {
+        LsbExtractFn extract = cur.bpp == 3 ? ops->extract_bgr : cur.bpp == 8 ? ops->extract_rgba64 :
+                               (cur.order == order_bgr ? ops->extract_bgra : ops->extract_rgba);
+        size_t head = group_head_bits(start_offset, 1);
+        if (head < nbits) {
+            memset(dst, 0, head >> 3);
+            cursor_extract(&cur, dst, 0, head);
+            size_t ngroups = (nbits - head) / 24;
+            extract(cur.pixel, dst + (head >> 3), ngroups);
+            cur.pixel += ngroups * 8 * cur.bpp;
+            done = head + ngroups * 24;
+        }
+    }
+    
+    /* Clear whole bytes the tail walk will OR into */
+    if (nbits - done >= 8) {
+        memset(dst + (done >> 3), 0, (nbits - done) >> 3);
+    }
+    cursor_extract(&cur, dst, done, nbits - done);
+}
+
+/* One transfer split into slices for the thread pool */
+typedef struct {
+    const ImageInfo *img;
+    const StegKernelOps *ops;
+    unsigned depth;
+    const uint8_t *src;
+    uint8_t *dst;
+    size_t nbits;
+    size_t start_offset;
+    size_t slice_bits;
+} ParallelTransfer;
+
+static void parallel_slice(void *context, size_t index) {
+    const ParallelTransfer *t = (const ParallelTransfer *)context;
+    size_t lo = index * t->slice_bits;
+    size_t n = t->nbits - lo < t->slice_bits ? t->nbits - lo : t->slice_bits;
+    
+    /* Slices start on payload bytes, so they never share an output byte */
+    if (t->src) {
+        embed_range(t->img, t->ops, t->depth, t->src + (lo >> 3), n, t->start_offset + lo);
+    } else {
+        extract_range(t->img, t->ops, t->depth, t->dst + (lo >> 3), n, t->start_offset + lo);
+    }
+}
+
+/* Run a transfer on the pool when it is long enough, inline otherwise */
+static void transfer_range(const ImageInfo *img, unsigned depth, const uint8_t *src, uint8_t *dst,
+                           size_t nbits, size_t start_offset) {
+    const StegKernelOps *ops = steg_kernel_active();
+    unsigned int threads = nbits >= KERNEL_PARALLEL_MIN_BITS ? pool_threads() : 1;
+    
+    if (threads > 1) {
+        ParallelTransfer t;
+        
+        /* A few slices per thread evens out uneven progress */
+        t.slice_bits = nbits / ((size_t)threads * 4);
+        t.slice_bits += KERNEL_PARALLEL_ALIGN_BITS - 1;
+        t.slice_bits -= t.slice_bits % KERNEL_PARALLEL_ALIGN_BITS;
+        t.img = img;
+        t.ops = ops;
+        t.depth = depth;
+        t.src = src;
+        t.dst = dst;
+        t.nbits = nbits;
+        t.start_offset = start_offset;
+        pool_run(parallel_slice, &t, (nbits + t.slice_bits - 1) / t.slice_bits);
+    } else if (src) {
+        embed_range(img, ops, depth, src, nbits, start_offset);
+    } else {
+        extract_range(img, ops, depth, dst, nbits, start_offset);
+    }
+}
+
+bool steg_embed_bits(StegContext *ctx, const uint8_t *src, size_t nbits, size_t start_offset) {
+    if ((nbits && !src) || !transfer_valid(ctx, nbits, &start_offset)) {
+        return false;
+    }
+    
+    if (nbits) {
+        transfer_range(ctx->image, transfer_depth(ctx), src, NULL, nbits, start_offset);
+    }
+    ctx->bits_processed += nbits;
+    return true;
+}
+
+bool steg_extract_bits(StegContext *ctx, uint8_t *dst, size_t nbits, size_t start_offset) {
+    if ((nbits && !dst) || !transfer_valid(ctx, nbits, &start_offset)) {
+        return false;
+    }
+    
+    if (nbits) {
+        transfer_range(ctx->image, transfer_depth(ctx), NULL, dst, nbits, start_offset);
+    }
+    ctx->bits_processed += nbits;
+    return true;
+}
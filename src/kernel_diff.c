@@ -0,0 +1,489 @@
+#include "steg.h"
+#include "kernel.h"
+#include "pool.h"
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Differential test of the bulk transfers (steg_embed_bits/steg_extract_bits) against the
+   per-bit reference: every kernel variant, inline and on the pool, over random geometries,
+   layouts, bands, offsets and depths. Built as pxpl-kernel-diff with its own driver, or as
+   a libFuzzer target with PXPL_FUZZ_LIBFUZZER (the entry point takes the same case bytes). */
+
+/* Native plane layouts the backends produce */
+typedef struct {
+    const char *name;
+    uint8_t channels;
+    bool has_alpha;
+    uint8_t bit_depth;
+    bool bgr_order;
+} DiffLayout;
+
+static const DiffLayout layouts[] = {
+    { "gray8", 1, false, 8, false },
+    { "graya8", 2, true, 8, false },
+    { "rgb8", 3, false, 8, false },
+    { "bgr8", 3, false, 8, true },
+    { "rgba8", 4, true, 8, false },
+    { "bgra8", 4, true, 8, true },
+    { "gray16", 1, false, 16, false },
+    { "graya16", 2, true, 16, false },
+    { "rgb16", 3, false, 16, false },
+    { "rgba16", 4, true, 16, false }
+};
+
+#define LAYOUT_COUNT (sizeof(layouts) / sizeof(layouts[0]))
+
+static const StegKernelVariant variants[] = {
+    STEG_KERNEL_SCALAR, STEG_KERNEL_SSE2, STEG_KERNEL_AVX2, STEG_KERNEL_NEON
+};
+
+#define VARIANT_COUNT (sizeof(variants) / sizeof(variants[0]))
+
+/* Case bytes: layout, depth, flags, then 16-bit width, height, band start and band rows,
+   32-bit start and bit count (both reduced into the band) and a 32-bit content seed;
+   missing bytes read as zero */
+#define CASE_BYTES 23
+#define CASE_FLAG_LARGE 0x01
+
+/* Small cases stay quick; large ones pass the pool's split threshold */
+#define SMALL_MAX_WIDTH 96
+#define SMALL_MAX_HEIGHT 48
+#define LARGE_MAX_WIDTH 2048
+#define LARGE_MAX_HEIGHT 1024
+
+typedef struct {
+    const DiffLayout *layout;
+    unsigned depth;
+    uint32_t width;
+    uint32_t height;
+    uint32_t band_y;
+    uint32_t band_rows;
+    size_t start;               /* Image-wide stream offset */
+    size_t nbits;
+    uint32_t seed;
+} DiffCase;
+
+/* Deterministic content from a seed */
+static uint32_t diff_random(uint32_t *state) {
+    uint32_t x = *state;
+    
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static void diff_fill(uint8_t *data, size_t size, uint32_t *state) {
+    for (size_t i = 0; i < size; i++) {
+        data[i] = (uint8_t)(diff_random(state) >> 24);
+    }
+}
+
+static uint32_t case_get(const uint8_t *data, size_t size, size_t at, unsigned bytes) {
+    uint32_t v = 0;
+    
+    for (unsigned i = 0; i < bytes; i++) {
+        v |= (uint32_t)(at + i < size ? data[at + i] : 0) << (8 * i);
+    }
+    return v;
+}
+
+/* Map any byte string onto a valid case */
+static void case_decode(DiffCase *c, const uint8_t *data, size_t size) {
+    bool large = (case_get(data, size, 2, 1) & CASE_FLAG_LARGE) != 0;
+    uint32_t max_width = large ? LARGE_MAX_WIDTH : SMALL_MAX_WIDTH;
+    uint32_t max_height = large ? LARGE_MAX_HEIGHT : SMALL_MAX_HEIGHT;
+    size_t row_bits, band_lo, band_bits;
+    
+    c->layout = &layouts[case_get(data, size, 0, 1) % LAYOUT_COUNT];
+    c->depth = case_get(data, size, 1, 1) % STEG_MAX_DEPTH + 1;
+    c->width = case_get(data, size, 3, 2) % max_width + 1;
+    c->height = case_get(data, size, 5, 2) % max_height + 1;
+    c->band_y = case_get(data, size, 7, 2) % c->height;
+    c->band_rows = case_get(data, size, 9, 2) % (c->height - c->band_y) + 1;
+    
+    row_bits = (size_t)c->width * (c->layout->channels - (c->layout->has_alpha ? 1 : 0)) * c->depth;
+    band_lo = row_bits * c->band_y;
+    band_bits = row_bits * c->band_rows;
+    c->start = band_lo + case_get(data, size, 11, 4) % (band_bits + 1);
+    c->nbits = case_get(data, size, 15, 4) % (band_lo + band_bits - c->start + 1);
+    c->seed = case_get(data, size, 19, 4) | 1;
+}
+
+/* Reference sample of stream sample s, addressed like steg_write_bit */
+static uint8_t *reference_sample(const ImageInfo *img, size_t s) {
+    uint32_t usable = img->channels - (img->has_alpha ? 1 : 0);
+    size_t y = s / ((size_t)img->width * usable);
+    size_t x = (s % ((size_t)img->width * usable)) / usable;
+    uint32_t channel = (uint32_t)(s % usable);
+    
+    if (img->bgr_order && usable == 3) {
+        channel = 2 - channel;
+    }
+    return &img->row_pointers[y][x * img->bytes_per_pixel + channel * (img->bit_depth / 8)];
+}
+
+/* Per-bit embed: steg_write_bit for the LSB plane, the same addressing per plane above it */
+static void reference_embed(StegContext *ctx, const uint8_t *src, size_t nbits, size_t start, unsigned depth) {
+    for (size_t i = 0; i < nbits; i++) {
+        uint8_t bit = (uint8_t)((src[i >> 3] >> (i & 7)) & 1);
+        size_t offset = start + i;
+        
+        if (depth == 1) {
+            steg_write_bit(ctx, bit, (uint32_t)offset);
+        } else {
+            uint8_t *p = reference_sample(ctx->image, offset / depth);
+            unsigned plane = (unsigned)(offset % depth);
+            
+            *p = (uint8_t)((*p & ~(1u << plane)) | ((unsigned)bit << plane));
+        }
+    }
+}
+
+static void reference_extract(StegContext *ctx, uint8_t *dst, size_t nbits, size_t start, unsigned depth) {
+    memset(dst, 0, (nbits + 7) / 8);
+    for (size_t i = 0; i < nbits; i++) {
+        size_t offset = start + i;
+        uint8_t bit;
+        
+        if (depth == 1) {
+            bit = steg_read_bit(ctx, (uint32_t)offset);
+        } else {
+            bit = (uint8_t)((*reference_sample(ctx->image, offset / depth) >> (offset % depth)) & 1);
+        }
+        dst[i >> 3] |= (uint8_t)(bit << (i & 7));
+    }
+}
+
+/* Whole plane of a case with row views; band_y 0 and every row held */
+static void plane_init(ImageInfo *img, const DiffCase *c, uint8_t *pixels, uint8_t **rows) {
+    memset(img, 0, sizeof(*img));
+    img->width = c->width;
+    img->height = c->height;
+    img->channels = c->layout->channels;
+    img->has_alpha = c->layout->has_alpha;
+    img->bit_depth = c->layout->bit_depth;
+    img->bgr_order = c->layout->bgr_order;
+    img->bytes_per_pixel = (uint8_t)(c->layout->channels * (c->layout->bit_depth / 8));
+    img->rowbytes = (size_t)c->width * img->bytes_per_pixel;
+    img->pixels = pixels;
+    img->row_pointers = rows;
+    img->band_rows = c->height;
+    img->band_capacity = c->height;
+    for (uint32_t y = 0; y < c->height; y++) {
+        rows[y] = pixels + (size_t)y * img->rowbytes;
+    }
+}
+
+static void case_describe(const DiffCase *c, const char *variant, bool parallel) {
+    fprintf(stderr, "  %s %ux%u depth %u, band %u+%u, bits [%llu, %llu), %s %s, seed %u\n",
+            c->layout->name, c->width, c->height, c->depth, c->band_y, c->band_rows,
+            (unsigned long long)c->start, (unsigned long long)(c->start + c->nbits), variant,
+            parallel ? "pool" : "inline", c->seed);
+}
+
+/* Run one case through every variant, inline and on the pool; false after reporting the
+   first mismatch (or failed allocation) */
+static bool case_run(const DiffCase *c) {
+    ImageInfo full, band;
+    StegContext ctx = {0};
+    uint32_t state = c->seed;
+    size_t plane_size = (size_t)c->width * c->layout->channels * (c->layout->bit_depth / 8) * c->height;
+    size_t payload_size = (c->nbits + 7) / 8;
+    uint8_t *original = (uint8_t *)malloc(plane_size);
+    uint8_t *expected = (uint8_t *)malloc(plane_size);
+    uint8_t *actual = (uint8_t *)malloc(plane_size);
+    uint8_t *src = (uint8_t *)malloc(payload_size + 1);
+    uint8_t *want = (uint8_t *)malloc(payload_size + 1);
+    uint8_t *got = (uint8_t *)malloc(payload_size + 1);
+    uint8_t **rows = (uint8_t **)malloc(sizeof(uint8_t *) * c->height);
+    const StegKernelOps *ops;
+    bool success = false;
+    
+    if (!original || !expected || !actual || !src || !want || !got || !rows) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        goto cleanup;
+    }
+    diff_fill(original, plane_size, &state);
+    diff_fill(src, payload_size + 1, &state);
+    
+    /* Reference results on the whole image */
+    memcpy(expected, original, plane_size);
+    plane_init(&full, c, expected, rows);
+    ctx.image = &full;
+    reference_embed(&ctx, src, c->nbits, c->start, c->depth);
+    memcpy(actual, original, plane_size);
+    plane_init(&full, c, actual, rows);
+    reference_extract(&ctx, want, c->nbits, c->start, c->depth);
+    
+    for (size_t v = 0; v < VARIANT_COUNT; v++) {
+        if (!steg_kernel_select(variants[v])) {
+            continue;
+        }
+        ops = steg_kernel_active();
+        for (int parallel = 0; parallel < 2; parallel++) {
+            pool_set_thread_parallel(parallel != 0);
+            
+            /* The kernels see only the band, as in the banded loops */
+            memcpy(actual, original, plane_size);
+            plane_init(&band, c, actual, rows);
+            band.pixels = actual + (size_t)c->band_y * band.rowbytes;
+            band.band_y = c->band_y;
+            band.band_rows = c->band_rows;
+            ctx.image = &band;
+            ctx.depth = (uint8_t)c->depth;
+            
+            memset(got, 0xA5, payload_size + 1);
+            if (!steg_extract_bits(&ctx, got, c->nbits, c->start) ||
+                memcmp(got, want, payload_size) != 0 || got[payload_size] != 0xA5) {
+                fprintf(stderr, "Error: Extract differs from the reference\n");
+                case_describe(c, ops->name, parallel != 0);
+                goto cleanup;
+            }
+            if (!steg_embed_bits(&ctx, src, c->nbits, c->start) ||
+                memcmp(actual, expected, plane_size) != 0) {
+                fprintf(stderr, "Error: Embed differs from the reference\n");
+                case_describe(c, ops->name, parallel != 0);
+                goto cleanup;
+            }
+        }
+    }
+    success = true;
+    
+cleanup:
+    pool_set_thread_parallel(true);
+    steg_kernel_select(STEG_KERNEL_AUTO);
+    free(original);
+    free(expected);
+    free(actual);
+    free(src);
+    free(want);
+    free(got);
+    free(rows);
+    return success;
+}
+
+/* libFuzzer entry point; a mismatch aborts so the fuzzer keeps the input */
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    DiffCase c;
+    
+    case_decode(&c, data, size);
+    if (!case_run(&c)) {
+        abort();
+    }
+    return 0;
+}
+
+#ifndef PXPL_FUZZ_LIBFUZZER
+
+/* Every 64th random case is large so the pool splits it */
+#define DIFF_LARGE_EVERY 64
+#define DIFF_DEFAULT_ITERATIONS 10000
+#define BENCH_WIDTH 1920
+#define BENCH_HEIGHT 1080
+
+static void show_usage(void) {
+    fprintf(stderr, "LSB Kernel Differential Test\n"
+                    "Usage:\n"
+                    "  pxpl-kernel-diff [--iterations N] [--seed S]   random cases (default 10000)\n"
+                    "  pxpl-kernel-diff <case-file>...              replay cases, e.g. fuzzer inputs\n"
+                    "  pxpl-kernel-diff --bench [--reps N]          throughput per variant\n"
+                    "Each case runs every kernel variant, inline and on the pool, against the\n"
+                    "per-bit reference (steg_write_bit/steg_read_bit) and checks both directions.\n"
+                    "--bench prints one tab-separated line per case on stdout:\n"
+                    "  <variant> <layout> <depth> <op> <bits> <threads> <ns> <MB/s> <ns/bit>\n"
+                    "Return codes:\n"
+                    "  0 - All cases match\n"
+                    "  1 - Incorrect arguments\n"
+                    "  2 - A variant differs from the reference\n"
+                    "  4 - I/O error\n");
+}
+
+static int run_random(unsigned long iterations, uint32_t seed) {
+    uint8_t bytes[CASE_BYTES];
+    uint32_t state = seed | 1;
+    DiffCase c;
+    
+    for (unsigned long i = 0; i < iterations; i++) {
+        diff_fill(bytes, sizeof(bytes), &state);
+        bytes[2] = (uint8_t)(i % DIFF_LARGE_EVERY == DIFF_LARGE_EVERY - 1 ? CASE_FLAG_LARGE : 0);
+        case_decode(&c, bytes, sizeof(bytes));
+        if (!case_run(&c)) {
+            fprintf(stderr, "  case %lu of --seed %u\n", i, seed);
+            return STEG_ERROR_FORMAT;
+        }
+    }
+    printf("%lu cases match on every variant\n", iterations);
+    return STEG_SUCCESS;
+}
+
+static int run_files(int count, char **paths) {
+    uint8_t bytes[CASE_BYTES];
+    size_t size;
+    FILE *fp;
+    DiffCase c;
+    
+    for (int i = 0; i < count; i++) {
+        fp = fopen(paths[i], "rb");
+        if (!fp) {
+            fprintf(stderr, "Error: Cannot open %s\n", paths[i]);
+            return STEG_ERROR_IO;
+        }
+        size = fread(bytes, 1, sizeof(bytes), fp);
+        fclose(fp);
+        case_decode(&c, bytes, size);
+        if (!case_run(&c)) {
+            fprintf(stderr, "  case file %s\n", paths[i]);
+            return STEG_ERROR_FORMAT;
+        }
+    }
+    printf("%d cases match on every variant\n", count);
+    return STEG_SUCCESS;
+}
+
+static void bench_report(const char *variant, const char *layout, unsigned depth, const char *op,
+                         size_t nbits, unsigned threads, uint64_t ns) {
+    printf("%s\t%s\t%u\t%s\t%llu\t%u\t%llu\t%.1f\t%.3f\n", variant, layout, depth, op,
+           (unsigned long long)nbits, threads, (unsigned long long)ns,
+           ns ? (double)nbits / 8.0 * 1000.0 / (double)ns : 0.0, nbits ? (double)ns / (double)nbits : 0.0);
+    fflush(stdout);
+}
+
+/* Whole-image transfers per layout and depth: the reference once, then every variant
+   inline and on the pool, best of reps */
+static int run_bench(unsigned reps) {
+    DiffCase c = {0};
+    ImageInfo img;
+    StegContext ctx = {0};
+    uint32_t state = 1;
+    size_t plane_size, payload_size;
+    uint8_t *pixels = NULL, *payload = NULL;
+    uint8_t **rows = NULL;
+    uint64_t start, ns, best_embed, best_extract;
+    unsigned threads;
+    int status = STEG_SUCCESS;
+    
+    c.width = BENCH_WIDTH;
+    c.height = BENCH_HEIGHT;
+    c.band_rows = BENCH_HEIGHT;
+    printf("variant\tlayout\tdepth\top\tbits\tthreads\tns\tmb_per_s\tns_per_bit\n");
+    for (size_t l = 0; l < LAYOUT_COUNT && status == STEG_SUCCESS; l++) {
+        c.layout = &layouts[l];
+        plane_size = (size_t)c.width * c.layout->channels * (c.layout->bit_depth / 8) * c.height;
+        pixels = (uint8_t *)malloc(plane_size);
+        payload = (uint8_t *)malloc((size_t)c.width * c.height * 3 * STEG_MAX_DEPTH / 8 + 1);
+        rows = (uint8_t **)malloc(sizeof(uint8_t *) * c.height);
+        if (!pixels || !payload || !rows) {
+            fprintf(stderr, "Error: Memory allocation failed\n");
+            status = STEG_ERROR_IO;
+        }
+        for (unsigned depth = 1; depth <= STEG_MAX_DEPTH && status == STEG_SUCCESS; depth++) {
+            c.depth = depth;
+            c.nbits = (size_t)c.width * c.height * (c.layout->channels - (c.layout->has_alpha ? 1 : 0)) * depth;
+            payload_size = (c.nbits + 7) / 8;
+            diff_fill(pixels, plane_size, &state);
+            diff_fill(payload, payload_size, &state);
+            plane_init(&img, &c, pixels, rows);
+            ctx.image = &img;
+            ctx.depth = (uint8_t)depth;
+            
+            start = platform_time_ns();
+            reference_embed(&ctx, payload, c.nbits, 0, depth);
+            bench_report("reference", c.layout->name, depth, "embed", c.nbits, 1, platform_time_ns() - start);
+            start = platform_time_ns();
+            reference_extract(&ctx, payload, c.nbits, 0, depth);
+            bench_report("reference", c.layout->name, depth, "extract", c.nbits, 1, platform_time_ns() - start);
+            
+            for (size_t v = 0; v < VARIANT_COUNT; v++) {
+                if (!steg_kernel_select(variants[v])) {
+                    continue;
+                }
+                for (int parallel = 0; parallel < 2; parallel++) {
+                    pool_set_thread_parallel(parallel != 0);
+                    threads = pool_threads();
+                    if (parallel && threads == 1) {
+                        continue;
+                    }
+                    best_embed = best_extract = UINT64_MAX;
+                    for (unsigned r = 0; r < reps; r++) {
+                        start = platform_time_ns();
+                        steg_embed_bits(&ctx, payload, c.nbits, 0);
+                        ns = platform_time_ns() - start;
+                        best_embed = ns < best_embed ? ns : best_embed;
+                        
+                        start = platform_time_ns();
+                        steg_extract_bits(&ctx, payload, c.nbits, 0);
+                        ns = platform_time_ns() - start;
+                        best_extract = ns < best_extract ? ns : best_extract;
+                    }
+                    bench_report(steg_kernel_active()->name, c.layout->name, depth, "embed", c.nbits, threads,
+                                 best_embed);
+                    bench_report(steg_kernel_active()->name, c.layout->name, depth, "extract", c.nbits, threads,
+                                 best_extract);
+                }
+            }
+            pool_set_thread_parallel(true);
+            steg_kernel_select(STEG_KERNEL_AUTO);
+        }
+        free(pixels);
+        free(payload);
+        free(rows);
+        pixels = payload = NULL;
+        rows = NULL;
+    }
+    return status;
+}
+
+int main(int argc, char **argv) {
+    unsigned long iterations = DIFF_DEFAULT_ITERATIONS;
+    unsigned long seed = 1;
+    unsigned long reps = 3;
+    bool bench = false;
+    int first = argc;
+    char *end;
+    int status;
+    
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bench") == 0) {
+            bench = true;
+        } else if (strncmp(argv[i], "--", 2) == 0) {
+            if (i + 1 >= argc) {
+                show_usage();
+                return STEG_ERROR_ARGS;
+            }
+            if (strcmp(argv[i], "--iterations") == 0) {
+                iterations = strtoul(argv[++i], &end, 10);
+            } else if (strcmp(argv[i], "--seed") == 0) {
+                seed = strtoul(argv[++i], &end, 10);
+            } else if (strcmp(argv[i], "--reps") == 0) {
+                reps = strtoul(argv[++i], &end, 10);
+            } else {
+                show_usage();
+                return STEG_ERROR_ARGS;
+            }
+            if (*end != '\0' || seed > UINT32_MAX || reps == 0 || reps > 1000) {
+                fprintf(stderr, "Error: Invalid value for %s\n", argv[i - 1]);
+                return STEG_ERROR_ARGS;
+            }
+        } else {
+            first = i;
+            break;
+        }
+    }
+    
+    if (bench) {
+        status = run_bench((unsigned)reps);
+    } else if (first < argc) {
+        status = run_files(argc - first, argv + first);
+    } else {
+        status = run_random(iterations, (uint32_t)seed);
+    }
+    
+    pool_shutdown();
+    return status;
+}
+
+#endif /* PXPL_FUZZ_LIBFUZZER */
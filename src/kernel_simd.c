@@ -0,0 +1,473 @@
+#include "kernel.h"
+#include <string.h>
+
+/* RGBA bit masks: drop the alpha bit of every 4-bit pixel group (12 of 16, 24 of 32 bits) */
+static inline uint32_t rgba_compact16(uint32_t m) {
+    return (m & 0x007) | ((m >> 1) & 0x038) | ((m >> 2) & 0x1C0) | ((m >> 3) & 0xE00);
+}
+
+static inline uint32_t rgba_compact32(uint32_t m) {
+    uint32_t t = (m & 0x07070707u) | ((m >> 1) & 0x38383838u);
+    return (t & 0x3F) | ((t >> 2) & 0xFC0) | ((t >> 4) & 0x3F000) | ((t >> 6) & 0xFC0000);
+}
+
+/* Inverse of the above: open a zero gap at every alpha position */
+static inline uint32_t rgba_expand16(uint32_t r) {
+    return (r & 0x007) | ((r & 0x038) << 1) | ((r & 0x1C0) << 2) | ((r & 0xE00) << 3);
+}
+
+static inline uint32_t rgba_expand32(uint32_t r) {
+    uint32_t t = (r & 0x3F) | ((r & 0xFC0) << 2) | ((r & 0x3F000) << 4) | ((r & 0xFC0000) << 6);
+    return (t & 0x07070707u) | ((t & 0x38383838u) << 1);
+}
+
+static inline uint32_t load24(const uint8_t *src) {
+    return (uint32_t)src[0] | ((uint32_t)src[1] << 8) | ((uint32_t)src[2] << 16);
+}
+
+static inline void store24(uint8_t *dst, uint32_t bits) {
+    dst[0] = (uint8_t)bits;
+    dst[1] = (uint8_t)(bits >> 8);
+    dst[2] = (uint8_t)(bits >> 16);
+}
+
+#if STEG_KERNEL_X86
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define KERNEL_TARGET_SSE2
+#define KERNEL_TARGET_AVX2
+#else
+#include <cpuid.h>
+#define KERNEL_TARGET_SSE2 __attribute__((target("sse2")))
+#define KERNEL_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#include <emmintrin.h>
+#include <immintrin.h>
+
+/* ---- SSE2: 16 sample bytes per vector ---- */
+
+/* Byte i of the result is 0x01 when bit (i % 8) of its source byte is set */
+KERNEL_TARGET_SSE2 static inline __m128i sse2_bits_to_bytes(uint8_t lo, uint8_t hi) {
+    const __m128i sel = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    __m128i rep = _mm_unpacklo_epi64(_mm_set1_epi8((char)lo), _mm_set1_epi8((char)hi));
+    return _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(rep, sel), sel), _mm_set1_epi8(1));
+}
+
+/* Bit i of the result is the LSB of sample byte i */
+KERNEL_TARGET_SSE2 static inline uint32_t sse2_lsb_mask(const uint8_t *p) {
+    return (uint32_t)_mm_movemask_epi8(_mm_slli_epi16(_mm_loadu_si128((const __m128i*)p), 7));
+}
+
+KERNEL_TARGET_SSE2 static inline void sse2_blend(uint8_t *p, __m128i keep, __m128i bits) {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    _mm_storeu_si128((__m128i*)p, _mm_or_si128(_mm_and_si128(v, keep), bits));
+}
+
+KERNEL_TARGET_SSE2 static void lsb_embed_dense_sse2(uint8_t *p, const uint8_t *src, size_t nbytes) {
+    const __m128i keep = _mm_set1_epi8((char)0xFE);
+    size_t i = 0;
+    for (; i + 2 <= nbytes; i += 2, p += 16) {
+        sse2_blend(p, keep, sse2_bits_to_bytes(src[i], src[i + 1]));
+    }
+    lsb_embed_dense_scalar(p, src + i, nbytes - i);
+}
+
+KERNEL_TARGET_SSE2 static void lsb_extract_dense_sse2(const uint8_t *p, uint8_t *dst, size_t nbytes) {
+    size_t i = 0;
+    for (; i + 2 <= nbytes; i += 2, p += 16) {
+        uint32_t m = sse2_lsb_mask(p);
+        dst[i] = (uint8_t)m;
+        dst[i + 1] = (uint8_t)(m >> 8);
+    }
+    lsb_extract_dense_scalar(p, dst + i, nbytes - i);
+}
+
+/* Wide layouts: the sample bytes are the low bytes of 16-bit lanes - two vectors per
+   payload byte pair, packed to one for the mask */
+KERNEL_TARGET_SSE2 static void lsb_embed_wide_sse2(uint8_t *p, const uint8_t *src, size_t nbytes) {
+    const __m128i keep = _mm_set1_epi16((short)0xFFFE);
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 2 <= nbytes; i += 2, p += 32) {
+        __m128i bits = sse2_bits_to_bytes(src[i], src[i + 1]);
+        sse2_blend(p, keep, _mm_unpacklo_epi8(bits, zero));
+        sse2_blend(p + 16, keep, _mm_unpackhi_epi8(bits, zero));
+    }
+    lsb_embed_wide_scalar(p, src + i, nbytes - i);
+}
+
+KERNEL_TARGET_SSE2 static void lsb_extract_wide_sse2(const uint8_t *p, uint8_t *dst, size_t nbytes) {
+    const __m128i lsb = _mm_set1_epi16(1);
+    size_t i = 0;
+    for (; i + 2 <= nbytes; i += 2, p += 32) {
+        __m128i lo = _mm_and_si128(_mm_loadu_si128((const __m128i*)p), lsb);
+        __m128i hi = _mm_and_si128(_mm_loadu_si128((const __m128i*)(p + 16)), lsb);
+        uint32_t m = (uint32_t)_mm_movemask_epi8(_mm_slli_epi16(_mm_packus_epi16(lo, hi), 7));
+        dst[i] = (uint8_t)m;
+        dst[i + 1] = (uint8_t)(m >> 8);
+    }
+    lsb_extract_wide_scalar(p, dst + i, nbytes - i);
+}
+
+KERNEL_TARGET_SSE2 static void lsb_embed_rgba_sse2(uint8_t *p, const uint8_t *src, size_t ngroups) {
+    const __m128i keep = _mm_set1_epi32((int)0xFFFEFEFE);
+    for (size_t g = 0; g < ngroups; g++, src += 3, p += 32) {
+        uint32_t bits = load24(src);
+        uint32_t lo = rgba_expand16(bits & 0xFFF);
+        uint32_t hi = rgba_expand16(bits >> 12);
+        sse2_blend(p, keep, sse2_bits_to_bytes((uint8_t)lo, (uint8_t)(lo >> 8)));
+        sse2_blend(p + 16, keep, sse2_bits_to_bytes((uint8_t)hi, (uint8_t)(hi >> 8)));
+    }
+}
+
+KERNEL_TARGET_SSE2 static void lsb_extract_rgba_sse2(const uint8_t *p, uint8_t *dst, size_t ngroups) {
+    for (size_t g = 0; g < ngroups; g++, dst += 3, p += 32) {
+        store24(dst, rgba_compact16(sse2_lsb_mask(p)) | (rgba_compact16(sse2_lsb_mask(p + 16)) << 12));
+    }
+}
+
+/* BGR: 48 samples (two pixel groups) per step so the bit reorder stays pixel aligned */
+KERNEL_TARGET_SSE2 static void lsb_embed_bgr_sse2(uint8_t *p, const uint8_t *src, size_t ngroups) {
+    const __m128i keep = _mm_set1_epi8((char)0xFE);
+    size_t g = 0;
+    for (; g + 2 <= ngroups; g += 2, src += 6, p += 48) {
+        uint64_t bits = bgr_swap_bits((uint64_t)load24(src) | ((uint64_t)load24(src + 3) << 24));
+        for (int k = 0; k < 3; k++, bits >>= 16) {
+            sse2_blend(p + 16 * k, keep, sse2_bits_to_bytes((uint8_t)bits, (uint8_t)(bits >> 8)));
+        }
+    }
+    lsb_embed_bgr_scalar(p, src, ngroups - g);
+}
+
+KERNEL_TARGET_SSE2 static void lsb_extract_bgr_sse2(const uint8_t *p, uint8_t *dst, size_t ngroups) {
+    size_t g = 0;
+    for (; g + 2 <= ngroups; g += 2, dst += 6, p += 48) {
+        uint64_t m = (uint64_t)sse2_lsb_mask(p) | ((uint64_t)sse2_lsb_mask(p + 16) << 16) |
+                     ((uint64_t)sse2_lsb_mask(p + 32) << 32);
+        uint64_t bits = bgr_swap_bits(m);
+        store24(dst, (uint32_t)bits & 0xFFFFFF);
+        store24(dst + 3, (uint32_t)(bits >> 24) & 0xFFFFFF);
+    }
+    lsb_extract_bgr_scalar(p, dst, ngroups - g);
+}
+
+KERNEL_TARGET_SSE2 static void lsb_embed_bgra_sse2(uint8_t *p, const uint8_t *src, size_t ngroups) {
+    const __m128i keep = _mm_set1_epi32((int)0xFFFEFEFE);
+    for (size_t g = 0; g < ngroups; g++, src += 3, p += 32) {
+        uint32_t bits = load24(src);
+        uint32_t lo = bgra_swap_bits(rgba_expand16(bits & 0xFFF));
+        uint32_t hi = bgra_swap_bits(rgba_expand16(bits >> 12));
+        sse2_blend(p, keep, sse2_bits_to_bytes((uint8_t)lo, (uint8_t)(lo >> 8)));
+        sse2_blend(p + 16, keep, sse2_bits_to_bytes((uint8_t)hi, (uint8_t)(hi >> 8)));
+    }
+}
+
+KERNEL_TARGET_SSE2 static void lsb_extract_bgra_sse2(const uint8_t *p, uint8_t *dst, size_t ngroups) {
+    for (size_t g = 0; g < ngroups; g++, dst += 3, p += 32) {
+        store24(dst, rgba_compact16(bgra_swap_bits(sse2_lsb_mask(p))) |
+                     (rgba_compact16(bgra_swap_bits(sse2_lsb_mask(p + 16))) << 12));
+    }
+}
+
+/* ---- AVX2: 32 sample bytes per vector ---- */
+
+/* Byte i of the result is 0x01 when bit (i % 8) of byte (i / 8) of w is set */
+KERNEL_TARGET_AVX2 static inline __m256i avx2_bits_to_bytes(uint32_t w) {
+    const __m256i idx = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                         2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    const __m256i sel = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+                                         1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    __m256i rep = _mm256_shuffle_epi8(_mm256_set1_epi32((int)w), idx);
+    return _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(rep, sel), sel), _mm256_set1_epi8(1));
+}
+
+KERNEL_TARGET_AVX2 static inline uint32_t avx2_lsb_mask(const uint8_t *p) {
+    return (uint32_t)_mm256_movemask_epi8(_mm256_slli_epi16(_mm256_loadu_si256((const __m256i*)p), 7));
+}
+
+KERNEL_TARGET_AVX2 static inline void avx2_blend(uint8_t *p, __m256i keep, __m256i bits) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    _mm256_storeu_si256((__m256i*)p, _mm256_or_si256(_mm256_and_si256(v, keep), bits));
+}
+
+KERNEL_TARGET_AVX2 static void lsb_embed_dense_avx2(uint8_t *p, const uint8_t *src, size_t nbytes) {
+    const __m256i keep = _mm256_set1_epi8((char)0xFE);
+    size_t i = 0;
+    for (; i + 4 <= nbytes; i += 4, p += 32) {
+        uint32_t w;
+        memcpy(&w, src + i, sizeof(w));
+        avx2_blend(p, keep, avx2_bits_to_bytes(w));
+    }
+    _mm256_zeroupper();
+    lsb_embed_dense_scalar(p, src + i, nbytes - i);
+}
+
+KERNEL_TARGET_AVX2 static void lsb_extract_dense_avx2(const uint8_t *p, uint8_t *dst, size_t nbytes) {
+    size_t i = 0;
+    for (; i + 4 <= nbytes; i += 4, p += 32) {
+        uint32_t m = avx2_lsb_mask(p);
+        memcpy(dst + i, &m, sizeof(m));
+    }
+    _mm256_zeroupper();
+    lsb_extract_dense_scalar(p, dst + i, nbytes - i);
+}
+
+KERNEL_TARGET_AVX2 static void lsb_embed_rgba_avx2(uint8_t *p, const uint8_t *src, size_t ngroups) {
+    const __m256i keep = _mm256_set1_epi32((int)0xFFFEFEFE);
+    for (size_t g = 0; g < ngroups; g++, src += 3, p += 32) {
+        avx2_blend(p, keep, avx2_bits_to_bytes(rgba_expand32(load24(src))));
+    }
+    _mm256_zeroupper();
+}
+
+KERNEL_TARGET_AVX2 static void lsb_extract_rgba_avx2(const uint8_t *p, uint8_t *dst, size_t ngroups) {
+    for (size_t g = 0; g < ngroups; g++, dst += 3, p += 32) {
+        store24(dst, rgba_compact32(avx2_lsb_mask(p)));
+    }
+    _mm256_zeroupper();
+}
+
+/* BGR: 96 samples (four pixel groups) per step, reordered as two pixel-aligned 48-bit halves */
+KERNEL_TARGET_AVX2 static void lsb_embed_bgr_avx2(uint8_t *p, const uint8_t *src, size_t ngroups) {
+    const __m256i keep = _mm256_set1_epi8((char)0xFE);
+    size_t g = 0;
+    for (; g + 4 <= ngroups; g += 4, src += 12, p += 96) {
+        uint64_t lo = bgr_swap_bits((uint64_t)load24(src) | ((uint64_t)load24(src + 3) << 24));
+        uint64_t hi = bgr_swap_bits((uint64_t)load24(src + 6) | ((uint64_t)load24(src + 9) << 24));
+        avx2_blend(p, keep, avx2_bits_to_bytes((uint32_t)lo));
+        avx2_blend(p + 32, keep, avx2_bits_to_bytes((uint32_t)((lo >> 32) | (hi << 16))));
+        avx2_blend(p + 64, keep, avx2_bits_to_bytes((uint32_t)(hi >> 16)));
+    }
+    _mm256_zeroupper();
+    lsb_embed_bgr_scalar(p, src, ngroups - g);
+}
+
+KERNEL_TARGET_AVX2 static void lsb_extract_bgr_avx2(const uint8_t *p, uint8_t *dst, size_t ngroups) {
+    size_t g = 0;
+    for (; g + 4 <= ngroups; g += 4, dst += 12, p += 96) {
+        uint64_t m0 = avx2_lsb_mask(p);
+        uint64_t m1 = avx2_lsb_mask(p + 32);
+        uint64_t m2 = avx2_lsb_mask(p + 64);
+        uint64_t lo = bgr_swap_bits((m0 | (m1 << 32)) & 0xFFFFFFFFFFFFULL);
+        uint64_t hi = bgr_swap_bits((m1 >> 16) | (m2 << 16));
+        store24(dst, (uint32_t)lo & 0xFFFFFF);
+        store24(dst + 3, (uint32_t)(lo >> 24) & 0xFFFFFF);
+        store24(dst + 6, (uint32_t)hi & 0xFFFFFF);
+        store24(dst + 9, (uint32_t)(hi >> 24) & 0xFFFFFF);
+    }
+    _mm256_zeroupper();
+    lsb_extract_bgr_scalar(p, dst, ngroups - g);
+}
+
+KERNEL_TARGET_AVX2 static void lsb_embed_bgra_avx2(uint8_t *p, const uint8_t *src, size_t ngroups) {
+    const __m256i keep = _mm256_set1_epi32((int)0xFFFEFEFE);
+    for (size_t g = 0; g < ngroups; g++, src += 3, p += 32) {
+        avx2_blend(p, keep, avx2_bits_to_bytes(bgra_swap_bits(rgba_expand32(load24(src)))));
+    }
+    _mm256_zeroupper();
+}
+
+KERNEL_TARGET_AVX2 static void lsb_extract_bgra_avx2(const uint8_t *p, uint8_t *dst, size_t ngroups) {
+    for (size_t g = 0; g < ngroups; g++, dst += 3, p += 32) {
+        store24(dst, rgba_compact32(bgra_swap_bits(avx2_lsb_mask(p))));
+    }
+    _mm256_zeroupper();
+}
+
+/* ---- CPU feature detection ---- */
+
+static void cpuid(uint32_t leaf, uint32_t regs[4]) {
+#if defined(_MSC_VER)
+    int r[4];
+    __cpuidex(r, (int)leaf, 0);
+    for (int i = 0; i < 4; i++) {
+        regs[i] = (uint32_t)r[i];
+    }
+#else
+    regs[0] = regs[1] = regs[2] = regs[3] = 0;
+    __get_cpuid_count(leaf, 0, &regs[0], &regs[1], &regs[2], &regs[3]);
+#endif
+}
+
+static uint64_t xgetbv0(void) {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    uint32_t lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((uint64_t)hi << 32) | lo;
+#endif
+}
+
+static bool cpu_has_sse2(void) {
+    uint32_t r[4];
+    cpuid(1, r);
+    return (r[3] >> 26) & 1;
+}
+
+static bool cpu_has_avx2(void) {
+    uint32_t r[4];
+    cpuid(0, r);
+    if (r[0] < 7) {
+        return false;
+    }
+    cpuid(1, r);
+    /* OSXSAVE and AVX, and the OS must save YMM state */
+    if (((r[2] >> 27) & 1) == 0 || ((r[2] >> 28) & 1) == 0 || (xgetbv0() & 0x6) != 0x6) {
+        return false;
+    }
+    cpuid(7, r);
+    return (r[1] >> 5) & 1;
+}
+
+static const StegKernelOps kernel_sse2 = {
+    STEG_KERNEL_SSE2, "sse2",
+    lsb_embed_dense_sse2, lsb_extract_dense_sse2,
+    lsb_embed_wide_sse2, lsb_extract_wide_sse2,
+    lsb_embed_bgr_sse2, lsb_extract_bgr_sse2,
+    lsb_embed_rgba_sse2, lsb_extract_rgba_sse2,
+    lsb_embed_bgra_sse2, lsb_extract_bgra_sse2,
+    lsb_embed_rgba64_scalar, lsb_extract_rgba64_scalar
+};
+
+static const StegKernelOps kernel_avx2 = {
+    STEG_KERNEL_AVX2, "avx2",
+    lsb_embed_dense_avx2, lsb_extract_dense_avx2,
+    lsb_embed_wide_sse2, lsb_extract_wide_sse2,
+    lsb_embed_bgr_avx2, lsb_extract_bgr_avx2,
+    lsb_embed_rgba_avx2, lsb_extract_rgba_avx2,
+    lsb_embed_bgra_avx2, lsb_extract_bgra_avx2,
+    lsb_embed_rgba64_scalar, lsb_extract_rgba64_scalar
+};
+
+#endif /* STEG_KERNEL_X86 */
+
+#if STEG_KERNEL_NEON
+
+#include <arm_neon.h>
+
+/* ---- NEON (AArch64 baseline): 16 sample bytes per vector ---- */
+
+static inline uint8x16_t neon_bits_to_bytes(uint8_t lo, uint8_t hi) {
+    static const uint8_t sel_bytes[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    uint8x16_t rep = vcombine_u8(vdup_n_u8(lo), vdup_n_u8(hi));
+    return vandq_u8(vtstq_u8(rep, vld1q_u8(sel_bytes)), vdupq_n_u8(1));
+}
+
+static inline uint32_t neon_lsb_mask(const uint8_t *p) {
+    static const int8_t shift_bytes[16] = {0, 1, 2, 3, 4, 5, 6, 7, 0, 1, 2, 3, 4, 5, 6, 7};
+    uint8x16_t bits = vshlq_u8(vandq_u8(vld1q_u8(p), vdupq_n_u8(1)), vld1q_s8(shift_bytes));
+    return (uint32_t)vaddv_u8(vget_low_u8(bits)) | ((uint32_t)vaddv_u8(vget_high_u8(bits)) << 8);
+}
+
+static inline void neon_blend(uint8_t *p, uint8x16_t keep, uint8x16_t bits) {
+    vst1q_u8(p, vorrq_u8(vandq_u8(vld1q_u8(p), keep), bits));
+}
+
+static void lsb_embed_dense_neon(uint8_t *p, const uint8_t *src, size_t nbytes) {
+    const uint8x16_t keep = vdupq_n_u8(0xFE);
+    size_t i = 0;
+    for (; i + 2 <= nbytes; i += 2, p += 16) {
+        neon_blend(p, keep, neon_bits_to_bytes(src[i], src[i + 1]));
+    }
+    lsb_embed_dense_scalar(p, src + i, nbytes - i);
+}
+
+static void lsb_extract_dense_neon(const uint8_t *p, uint8_t *dst, size_t nbytes) {
+    size_t i = 0;
+    for (; i + 2 <= nbytes; i += 2, p += 16) {
+        uint32_t m = neon_lsb_mask(p);
+        dst[i] = (uint8_t)m;
+        dst[i + 1] = (uint8_t)(m >> 8);
+    }
+    lsb_extract_dense_scalar(p, dst + i, nbytes - i);
+}
+
+static void lsb_embed_rgba_neon(uint8_t *p, const uint8_t *src, size_t ngroups) {
+    const uint8x16_t keep = vreinterpretq_u8_u32(vdupq_n_u32(0xFFFEFEFEu));
+    for (size_t g = 0; g < ngroups; g++, src += 3, p += 32) {
+        uint32_t bits = load24(src);
+        uint32_t lo = rgba_expand16(bits & 0xFFF);
+        uint32_t hi = rgba_expand16(bits >> 12);
+        neon_blend(p, keep, neon_bits_to_bytes((uint8_t)lo, (uint8_t)(lo >> 8)));
+        neon_blend(p + 16, keep, neon_bits_to_bytes((uint8_t)hi, (uint8_t)(hi >> 8)));
+    }
+}
+
+static void lsb_extract_rgba_neon(const uint8_t *p, uint8_t *dst, size_t ngroups) {
+    for (size_t g = 0; g < ngroups; g++, dst += 3, p += 32) {
+        store24(dst, rgba_compact16(neon_lsb_mask(p)) | (rgba_compact16(neon_lsb_mask(p + 16)) << 12));
+    }
+}
+
+static void lsb_embed_bgr_neon(uint8_t *p, const uint8_t *src, size_t ngroups) {
+    const uint8x16_t keep = vdupq_n_u8(0xFE);
+    size_t g = 0;
+    for (; g + 2 <= ngroups; g += 2, src += 6, p += 48) {
+        uint64_t bits = bgr_swap_bits((uint64_t)load24(src) | ((uint64_t)load24(src + 3) << 24));
+        for (int k = 0; k < 3; k++, bits >>= 16) {
+            neon_blend(p + 16 * k, keep, neon_bits_to_bytes((uint8_t)bits, (uint8_t)(bits >> 8)));
+        }
+    }
+    lsb_embed_bgr_scalar(p, src, ngroups - g);
+}
+
+static void lsb_extract_bgr_neon(const uint8_t *p, uint8_t *dst, size_t ngroups) {
+    size_t g = 0;
+    for (; g + 2 <= ngroups; g += 2, dst += 6, p += 48) {
+        uint64_t m = (uint64_t)neon_lsb_mask(p) | ((uint64_t)neon_lsb_mask(p + 16) << 16) |
+                     ((uint64_t)neon_lsb_mask(p + 32) << 32);
+        uint64_t bits = bgr_swap_bits(m);
+        store24(dst, (uint32_t)bits & 0xFFFFFF);
+        store24(dst + 3, (uint32_t)(bits >> 24) & 0xFFFFFF);
+    }
+    lsb_extract_bgr_scalar(p, dst, ngroups - g);
+}
+
+static void lsb_embed_bgra_neon(uint8_t *p, const uint8_t *src, size_t ngroups) {
+    const uint8x16_t keep = vreinterpretq_u8_u32(vdupq_n_u32(0xFFFEFEFEu));
+    for (size_t g = 0; g < ngroups; g++, src += 3, p += 32) {
+        uint32_t bits = load24(src);
+        uint32_t lo = bgra_swap_bits(rgba_expand16(bits & 0xFFF));
+        uint32_t hi = bgra_swap_bits(rgba_expand16(bits >> 12));
+        neon_blend(p, keep, neon_bits_to_bytes((uint8_t)lo, (uint8_t)(lo >> 8)));
+        neon_blend(p + 16, keep, neon_bits_to_bytes((uint8_t)hi, (uint8_t)(hi >> 8)));
+    }
+}
+
+static void lsb_extract_bgra_neon(const uint8_t *p, uint8_t *dst, size_t ngroups) {
+    for (size_t g = 0; g < ngroups; g++, dst += 3, p += 32) {
+        store24(dst, rgba_compact16(bgra_swap_bits(neon_lsb_mask(p))) |
+                     (rgba_compact16(bgra_swap_bits(neon_lsb_mask(p + 16))) << 12));
+    }
+}
+
+static const StegKernelOps kernel_neon = {
+    STEG_KERNEL_NEON, "neon",
+    lsb_embed_dense_neon, lsb_extract_dense_neon,
+    lsb_embed_wide_scalar, lsb_extract_wide_scalar,
+    lsb_embed_bgr_neon, lsb_extract_bgr_neon,
+    lsb_embed_rgba_neon, lsb_extract_rgba_neon,
+    lsb_embed_bgra_neon, lsb_extract_bgra_neon,
+    lsb_embed_rgba64_scalar, lsb_extract_rgba64_scalar
+};
+
+#endif /* STEG_KERNEL_NEON */
+
+const StegKernelOps *kernel_simd_ops(StegKernelVariant variant) {
+    switch (variant) {
+#if STEG_KERNEL_X86
+        case STEG_KERNEL_SSE2:
+            return cpu_has_sse2() ? &kernel_sse2 : NULL;
+        case STEG_KERNEL_AVX2:
+            return cpu_has_avx2() ? &kernel_avx2 : NULL;
+#endif
+#if STEG_KERNEL_NEON
+        case STEG_KERNEL_NEON:
+            return &kernel_neon;
+#endif
+        default:
+            return NULL;
+    }
+}
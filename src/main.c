@@ -1,26 +1,293 @@
 #include "steg.h"
+#include "batch.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 
 /* Display program usage information */
 static void show_usage(void) {
     fprintf(stderr, "PNG LSB Steganography Tool\n"
                     "Usage:\n"
-                    "  pxpl embed   <cover.png> <payload.bin> <steg.png>\n"
-                    "  pxpl extract <steg.png> <output.bin>\n"
+                    "  pxpl embed   [--png-profile fast|balanced|small] [--depth 1-4] [--seed N] [--key K] [--compress off|on|auto] [--stats text|json] <cover.png> <payload.bin> <steg.png>\n"
+                    "  pxpl extract [--seed N] [--key K] [--stats text|json] <steg.png> <output.bin>\n"
+                    "  pxpl embed-multi [embed options] <payload.bin> <cover1.png> <steg1.png> [<cover2.png> <steg2.png>]...\n"
+                    "  pxpl embed-frames [embed options] <payload.bin> <cover.tiff> <steg.tiff>\n"
+                    "  pxpl extract-multi [--seed N] [--key K] <output.bin> <steg1.png> [<steg2.png>]...\n"
+                    "  pxpl extract-frames [--seed N] [--key K] <steg.tiff> <output.bin>\n"
+                    "  pxpl batch   [--jobs N] <manifest.txt | ->\n"
+                    "  pxpl probe   <steg.png>...\n"
+                    "  pxpl capacity [--depth 1-4] <cover.png>...\n"
+                    "  Use - as payload to read stdin, or as output to write stdout\n"
+                    "  --png-profile trades encode time for steg size (default fast)\n"
+                    "  --depth uses 1 to 4 low bits per sample (default 1); extract reads it from the image\n"
+                    "  --seed N scatters the payload over the image; extract needs the same seed\n"
+                    "  --key K encrypts the payload with AES-256-GCM under passphrase K; extract needs the same key\n"
+                    "  --compress packs the payload (up to 256 MiB) with LZ4 first; auto only when that makes it fit or saves rows\n"
+                    "  embed-multi splits the payload over the covers by capacity; extract-multi takes the shards in any order\n"
+                    "  embed-frames does the same over the frames of a multi-frame cover into one multi-page TIFF\n"
+                    "  (WIC builds only); extract-frames rebuilds the payload from its frames\n"
+                    "  --stats prints phase timings, throughput and peak memory to stderr, json as one line\n"
+                    "Batch manifest lines:\n"
+                    "  embed <cover.png> <payload.bin> <steg.png>\n"
+                    "  extract <steg.png> <output.bin>\n"
+                    "  Prints <line> <status> per job, exits with the first failing status\n"
+                    "  --jobs N runs N jobs in parallel (0 = one per CPU, default 1)\n"
+                    "Probe reads only the header rows and prints per image:\n"
+                    "  <image> <status> [<version> <depth> <payload bytes> <capacity bytes> <scattered> <encrypted> <compressed> <shard>]\n"
+                    "  Exits with the first failing status (2 - no payload)\n"
+                    "Capacity reads only the image header and prints <image> <status> [<payload bytes>]\n"
                     "Return codes:\n"
                     "  0 - Success\n"
                     "  1 - Incorrect arguments\n"
                     "  2 - Unsupported or corrupt image\n"
                     "  3 - Cover image too small\n"
                     "  4 - I/O error\n"
-                    "  5 - PNG error\n");
+                    "  5 - PNG error\n"
+                    "  6 - Cancelled (batch interrupted)\n");
+}
+
+/* --stats output */
+typedef enum {
+    STATS_NONE = 0,
+    STATS_TEXT,
+    STATS_JSON
+} StatsFormat;
+
+/* Names of the StegStatsPhase values, as printed by --stats */
+static const char *const stats_phase_names[STEG_STATS_PHASES] = {
+    "decode", "key", "compress", "payload", "encode", "other"
+};
+
+/* Map a --stats format name to its StatsFormat */
+static bool parse_stats(const char *name, StatsFormat *format) {
+    if (strcmp(name, "text") == 0) {
+        *format = STATS_TEXT;
+    } else if (strcmp(name, "json") == 0) {
+        *format = STATS_JSON;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/* Megabytes per second of bytes moved in ns, 0 when untimed */
+static double stats_rate(uint64_t bytes, uint64_t ns) {
+    return ns ? (double)bytes * 1000.0 / (double)ns : 0.0;
+}
+
+/* Print the stats of an embed or extract to stderr, which never carries the payload */
+static void print_stats(const char *operation, const StegStats *stats, StatsFormat format) {
+    if (format == STATS_JSON) {
+        fprintf(stderr, "{\"operation\":\"%s\",\"total_ns\":%llu", operation,
+                (unsigned long long)stats->total_ns);
+        for (int i = 0; i < STEG_STATS_PHASES; i++) {
+            fprintf(stderr, ",\"%s_ns\":%llu", stats_phase_names[i], (unsigned long long)stats->phase_ns[i]);
+        }
+        fprintf(stderr, ",\"rows_decoded\":%u,\"rows_encoded\":%u,\"bytes_decoded\":%llu,\"bytes_encoded\":%llu,"
+                "\"payload_bytes\":%llu,\"peak_memory\":%llu}\n", stats->rows_decoded, stats->rows_encoded,
+                (unsigned long long)stats->bytes_decoded, (unsigned long long)stats->bytes_encoded,
+                (unsigned long long)stats->payload_bytes, (unsigned long long)stats->peak_memory);
+        return;
+    }
+    
+    fprintf(stderr, "Stats: %s %.3f ms, peak memory %.1f MiB\n", operation, stats->total_ns / 1e6,
+            stats->peak_memory / 1048576.0);
+    for (int i = 0; i < STEG_STATS_PHASES; i++) {
+        if (stats->phase_ns[i] == 0) {
+            continue;
+        }
+        fprintf(stderr, "  %-9s %10.3f ms %5.1f%%", stats_phase_names[i], stats->phase_ns[i] / 1e6,
+                stats->total_ns ? 100.0 * stats->phase_ns[i] / stats->total_ns : 0.0);
+        if (i == STEG_STATS_DECODE) {
+            fprintf(stderr, "  %u rows, %.1f MB/s", stats->rows_decoded,
+                    stats_rate(stats->bytes_decoded, stats->phase_ns[i]));
+        } else if (i == STEG_STATS_ENCODE) {
+            fprintf(stderr, "  %u rows, %.1f MB/s", stats->rows_encoded,
+                    stats_rate(stats->bytes_encoded, stats->phase_ns[i]));
+        } else if (i == STEG_STATS_PAYLOAD) {
+            fprintf(stderr, "  %llu bytes, %.1f MB/s", (unsigned long long)stats->payload_bytes,
+                    stats_rate(stats->payload_bytes, stats->phase_ns[i]));
+        }
+        fprintf(stderr, "\n");
+    }
+}
+
+/* Map a --png-profile name to its StegPngProfile */
+static bool parse_png_profile(const char *name, StegPngProfile *profile) {
+    if (strcmp(name, "fast") == 0) {
+        *profile = STEG_PNG_FAST;
+    } else if (strcmp(name, "balanced") == 0) {
+        *profile = STEG_PNG_BALANCED;
+    } else if (strcmp(name, "small") == 0) {
+        *profile = STEG_PNG_SMALL;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/* Map a --compress mode name to its StegCompress */
+static bool parse_compress(const char *name, StegCompress *compress) {
+    if (strcmp(name, "off") == 0) {
+        *compress = STEG_COMPRESS_OFF;
+    } else if (strcmp(name, "on") == 0) {
+        *compress = STEG_COMPRESS_ON;
+    } else if (strcmp(name, "auto") == 0) {
+        *compress = STEG_COMPRESS_AUTO;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/* Parse a --depth value */
+static bool parse_depth(const char *text, uint8_t *depth) {
+    char *end;
+    unsigned long value = strtoul(text, &end, 10);
+    
+    if (end == text || *end != '\0' || value < 1 || value > STEG_MAX_DEPTH) {
+        fprintf(stderr, "Error: --depth expects 1 to %d\n", STEG_MAX_DEPTH);
+        return false;
+    }
+    *depth = (uint8_t)value;
+    return true;
+}
+
+/* Parse a --seed value (decimal, or hex with 0x); any 64-bit number is a seed */
+static bool parse_seed(const char *text, StegOptions *options) {
+    char *end;
+    
+    errno = 0;
+    options->seed = strtoull(text, &end, 0);
+    if (end == text || *end != '\0' || errno == ERANGE || *text == '-') {
+        fprintf(stderr, "Error: --seed expects a number from 0 to 2^64 - 1\n");
+        return false;
+    }
+    options->scatter = true;
+    return true;
+}
+
+/* Parse the --option value pairs in front of the embed or extract operands (extract takes
+   only --seed, --key and --stats; stats NULL rejects --stats); returns the index of the
+   first operand, or 0 after reporting a bad option */
+static int parse_options(int argc, char **argv, StegOptions *options, bool embed, StatsFormat *stats) {
+    int i = 2;
+    
+    while (i + 1 < argc && strncmp(argv[i], "--", 2) == 0) {
+        if (strcmp(argv[i], "--seed") == 0) {
+            if (!parse_seed(argv[i + 1], options)) {
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--key") == 0) {
+            if (argv[i + 1][0] == '\0') {
+                fprintf(stderr, "Error: --key expects a passphrase\n");
+                return 0;
+            }
+            options->key = argv[i + 1];
+        } else if (strcmp(argv[i], "--stats") == 0 && stats) {
+            if (!parse_stats(argv[i + 1], stats)) {
+                fprintf(stderr, "Error: --stats expects text or json\n");
+                return 0;
+            }
+        } else if (!embed) {
+            fprintf(stderr, "Error: Unknown option %s\n", argv[i]);
+            return 0;
+        } else if (strcmp(argv[i], "--png-profile") == 0) {
+            if (!parse_png_profile(argv[i + 1], &options->png_profile)) {
+                fprintf(stderr, "Error: --png-profile expects fast, balanced or small\n");
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--depth") == 0) {
+            if (!parse_depth(argv[i + 1], &options->depth)) {
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--compress") == 0) {
+            if (!parse_compress(argv[i + 1], &options->compress)) {
+                fprintf(stderr, "Error: --compress expects off, on or auto\n");
+                return 0;
+            }
+        } else {
+            fprintf(stderr, "Error: Unknown option %s\n", argv[i]);
+            return 0;
+        }
+        i += 2;
+    }
+    return i;
+}
+
+/* Print the payload capacity of each cover at depth; returns the first failing status */
+static int capacity_images(int count, char **paths, uint8_t depth) {
+    size_t bytes;
+    int status = STEG_SUCCESS;
+    int result;
+    
+    for (int i = 0; i < count; i++) {
+        result = steg_capacity(paths[i], depth, &bytes) ? STEG_SUCCESS : steg_last_error();
+        if (result == STEG_SUCCESS) {
+            printf("%s\t%d\t%zu\n", paths[i], result, bytes);
+        } else {
+            printf("%s\t%d\n", paths[i], result);
+        }
+        if (status == STEG_SUCCESS) {
+            status = result;
+        }
+    }
+    fflush(stdout);
+    return status;
+}
+
+/* Split payload over (cover, steg) path pairs; returns the STEG_* status */
+static int embed_multi(const char *payload_path, int pairs, char **paths, const StegOptions *options) {
+    const char **covers = (const char **)malloc(sizeof(char *) * (size_t)pairs);
+    const char **stegs = (const char **)malloc(sizeof(char *) * (size_t)pairs);
+    int status = STEG_ERROR_IO;
+    
+    if (covers && stegs) {
+        for (int i = 0; i < pairs; i++) {
+            covers[i] = paths[2 * i];
+            stegs[i] = paths[2 * i + 1];
+        }
+        status = steg_embed_multi(payload_path, (size_t)pairs, covers, stegs, options) ?
+                 STEG_SUCCESS : steg_last_error();
+    }
+    free(covers);
+    free(stegs);
+    return status;
+}
+
+/* Probe each image and print its header fields; returns the first failing status */
+static int probe_images(int count, char **paths) {
+    StegProbeInfo info;
+    int status = STEG_SUCCESS;
+    int result;
+    
+    for (int i = 0; i < count; i++) {
+        result = steg_probe(paths[i], &info) ? STEG_SUCCESS : steg_last_error();
+        if (result == STEG_SUCCESS) {
+            printf("%s\t%d\t%u\t%u\t%u\t%zu\t%d\t%d\t%d\t%d\n", paths[i], result, info.version, info.depth,
+                   info.payload_size, info.capacity, info.scattered ? 1 : 0, info.encrypted ? 1 : 0,
+                   info.compressed ? 1 : 0, info.shard ? 1 : 0);
+        } else {
+            printf("%s\t%d\n", paths[i], result);
+        }
+        if (status == STEG_SUCCESS) {
+            status = result;
+        }
+    }
+    fflush(stdout);
+    return status;
 }
 
 int main(int argc, char **argv) {
+    StegOptions options = {0};
+    StegStats stats;
+    StatsFormat format = STATS_NONE;
     const char *cmd;
-    bool success = false;
+    char *end;
+    unsigned long jobs = 1;
+    int first;
+    int status;
     
     /* Check for correct argument count */
     if (argc < 2) {
@@ -31,19 +298,105 @@ int main(int argc, char **argv) {
     /* Optimized command dispatch using string length + first char */
     cmd = argv[1];
     
-    if (cmd[0] == 'e') {
-        if (cmd[1] == 'm' && argc == 5) { /* embed */
-            success = steg_embed(argv[2], argv[3], argv[4]);
-        } else if (cmd[1] == 'x' && argc == 4) { /* extract */
-            success = steg_extract(argv[2], argv[3]);
+    /* One COM session and WIC factory for the whole run */
+    if (!steg_runtime_init()) {
+        return STEG_ERROR_IO;
+    }
+    
+    if (strcmp(cmd, "embed-multi") == 0) { /* embed-multi [options] <payload> (<cover> <steg>)... */
+        first = parse_options(argc, argv, &options, true, NULL);
+        if (first == 0) {
+            status = STEG_ERROR_ARGS;
+        } else if (argc - first < 3 || (argc - first - 1) % 2 != 0) {
+            show_usage();
+            status = STEG_ERROR_ARGS;
+        } else {
+            status = embed_multi(argv[first], (argc - first - 1) / 2, argv + first + 1, &options);
+        }
+    } else if (strcmp(cmd, "embed-frames") == 0) { /* embed-frames [options] <payload> <cover> <steg> */
+        first = parse_options(argc, argv, &options, true, NULL);
+        if (first == 0) {
+            status = STEG_ERROR_ARGS;
+        } else if (argc - first != 3) {
+            show_usage();
+            status = STEG_ERROR_ARGS;
         } else {
+            status = steg_embed_frames(argv[first], argv[first + 1], argv[first + 2], &options) ?
+                     STEG_SUCCESS : steg_last_error();
+        }
+    } else if (strcmp(cmd, "extract-multi") == 0) { /* extract-multi [options] <output> <steg>... */
+        first = parse_options(argc, argv, &options, false, NULL);
+        if (first == 0) {
+            status = STEG_ERROR_ARGS;
+        } else if (argc - first < 2) {
             show_usage();
-            return STEG_ERROR_ARGS;
+            status = STEG_ERROR_ARGS;
+        } else {
+            status = steg_extract_multi((size_t)(argc - first - 1), (const char *const *)(argv + first + 1),
+                                        argv[first], &options) ? STEG_SUCCESS : steg_last_error();
+        }
+    } else if (strcmp(cmd, "extract-frames") == 0) { /* extract-frames [options] <steg> <output> */
+        first = parse_options(argc, argv, &options, false, NULL);
+        if (first == 0) {
+            status = STEG_ERROR_ARGS;
+        } else if (argc - first != 2) {
+            show_usage();
+            status = STEG_ERROR_ARGS;
+        } else {
+            status = steg_extract_frames(argv[first], argv[first + 1], &options) ? STEG_SUCCESS : steg_last_error();
+        }
+    } else if (cmd[0] == 'e' && cmd[1] == 'm' && argc >= 5) { /* embed [options] */
+        first = parse_options(argc, argv, &options, true, &format);
+        if (first == 0) {
+            status = STEG_ERROR_ARGS;
+        } else if (argc - first != 3) {
+            show_usage();
+            status = STEG_ERROR_ARGS;
+        } else {
+            options.stats = format != STATS_NONE ? &stats : NULL;
+            status = steg_embed_ex(argv[first], argv[first + 1], argv[first + 2], &options) ?
+                     STEG_SUCCESS : steg_last_error();
+            if (options.stats) {
+                print_stats("embed", &stats, format);
+            }
+        }
+    } else if (cmd[0] == 'e' && cmd[1] == 'x' && argc >= 4) { /* extract [options] */
+        first = parse_options(argc, argv, &options, false, &format);
+        if (first == 0) {
+            status = STEG_ERROR_ARGS;
+        } else if (argc - first != 2) {
+            show_usage();
+            status = STEG_ERROR_ARGS;
+        } else {
+            options.stats = format != STATS_NONE ? &stats : NULL;
+            status = steg_extract_ex(argv[first], argv[first + 1], &options) ?
+                     STEG_SUCCESS : steg_last_error();
+            if (options.stats) {
+                print_stats("extract", &stats, format);
+            }
+        }
+    } else if (cmd[0] == 'p' && argc >= 3) { /* probe <image>... */
+        status = probe_images(argc - 2, argv + 2);
+    } else if (cmd[0] == 'c' && argc >= 5 && strcmp(argv[2], "--depth") == 0) { /* capacity --depth N */
+        status = parse_depth(argv[3], &options.depth) ?
+                 capacity_images(argc - 4, argv + 4, options.depth) : STEG_ERROR_ARGS;
+    } else if (cmd[0] == 'c' && argc >= 3 && strcmp(argv[2], "--depth") != 0) { /* capacity <image>... */
+        status = capacity_images(argc - 2, argv + 2, 1);
+    } else if (cmd[0] == 'b' && argc == 3) { /* batch */
+        status = batch_run(argv[2], stdout, 1);
+    } else if (cmd[0] == 'b' && argc == 5 && strcmp(argv[2], "--jobs") == 0) { /* batch --jobs N */
+        jobs = strtoul(argv[3], &end, 10);
+        if (end == argv[3] || *end != '\0' || jobs > BATCH_MAX_JOBS) {
+            fprintf(stderr, "Error: --jobs expects a count from 0 to %u\n", BATCH_MAX_JOBS);
+            status = STEG_ERROR_ARGS;
+        } else {
+            status = batch_run(argv[4], stdout, (unsigned int)jobs);
         }
     } else {
         show_usage();
-        return STEG_ERROR_ARGS;
+        status = STEG_ERROR_ARGS;
     }
     
-    return success ? STEG_SUCCESS : STEG_ERROR_IO;
+    steg_runtime_shutdown();
+    return status;
 }
@@ -0,0 +1,182 @@
+#include "pool.h"
+#include "platform.h"
+#include <limits.h>
+
+/* Shared worker pool. One run at a time; a run is published under the lock by bumping
+   generation, and indices are claimed with an interlocked counter. A new run waits for
+   stragglers of the previous one (active) so no worker claims an index with stale state. */
+typedef struct {
+    PlatformMutex lock;
+    PlatformCond work;              /* New generation or stop */
+    PlatformCond idle;              /* Run finished / last active worker left */
+    PlatformThread threads[POOL_MAX_THREADS];
+    unsigned int nthreads;
+    bool stop;
+    bool busy;
+    unsigned long generation;
+    PoolTaskFn fn;
+    void *context;
+    size_t count;
+    PlatformCounter next;
+    size_t done;
+    unsigned int active;
+} Pool;
+
+static Pool g_pool;
+static PlatformOnce g_pool_once = PLATFORM_ONCE_INIT;
+
+/* Parallel runs allowed on this thread (inverted so the default is on) */
+static PLATFORM_THREAD_LOCAL bool tls_serial = false;
+
+/* Claim and run tasks until the counter passes count; returns how many ran here */
+static size_t pool_drain(PoolTaskFn fn, void *context, size_t count) {
+    size_t ran = 0;
+    long index;
+    
+    while ((index = platform_counter_increment(&g_pool.next) - 1) < (long)count) {
+        fn(context, (size_t)index);
+        ran++;
+    }
+    return ran;
+}
+
+static PlatformThreadResult PLATFORM_THREAD_CALL pool_worker(void *param) {
+    unsigned long seen = 0;
+    PoolTaskFn fn;
+    void *context;
+    size_t count, ran;
+    
+    (void)param;
+    
+    platform_mutex_lock(&g_pool.lock);
+    for (;;) {
+        while (g_pool.generation == seen && !g_pool.stop) {
+            platform_cond_wait(&g_pool.work, &g_pool.lock);
+        }
+        if (g_pool.stop) {
+            break;
+        }
+        
+        /* Join the published run */
+        seen = g_pool.generation;
+        fn = g_pool.fn;
+        context = g_pool.context;
+        count = g_pool.count;
+        g_pool.active++;
+        platform_mutex_unlock(&g_pool.lock);
+        
+        ran = pool_drain(fn, context, count);
+        
+        platform_mutex_lock(&g_pool.lock);
+        g_pool.done += ran;
+        g_pool.active--;
+        if (g_pool.active == 0) {
+            platform_cond_wake_all(&g_pool.idle);
+        }
+    }
+    platform_mutex_unlock(&g_pool.lock);
+    return 0;
+}
+
+static void pool_start(void) {
+    unsigned int wanted;
+    
+    platform_mutex_init(&g_pool.lock);
+    platform_cond_init(&g_pool.work);
+    platform_cond_init(&g_pool.idle);
+    g_pool.stop = false;
+    g_pool.busy = false;
+    g_pool.nthreads = 0;
+    
+    /* The caller is one of the threads of every run */
+    wanted = platform_cpu_count() - 1;
+    if (wanted > POOL_MAX_THREADS) {
+        wanted = POOL_MAX_THREADS;
+    }
+    while (g_pool.nthreads < wanted) {
+        if (!platform_thread_start(&g_pool.threads[g_pool.nthreads], pool_worker, NULL)) {
+            break;
+        }
+        g_pool.nthreads++;
+    }
+}
+
+void pool_run(PoolTaskFn fn, void *context, size_t count) {
+    size_t i, ran;
+    bool inline_run = tls_serial || count < 2 || count > (size_t)LONG_MAX;
+    
+    if (!inline_run) {
+        platform_once(&g_pool_once, pool_start);
+        platform_mutex_lock(&g_pool.lock);
+        inline_run = g_pool.nthreads == 0 || g_pool.busy;
+        if (!inline_run) {
+            g_pool.busy = true;
+        }
+        platform_mutex_unlock(&g_pool.lock);
+    }
+    if (inline_run) {
+        for (i = 0; i < count; i++) {
+            fn(context, i);
+        }
+        return;
+    }
+    
+    /* Publish the run once the previous one has no stragglers */
+    platform_mutex_lock(&g_pool.lock);
+    while (g_pool.active > 0) {
+        platform_cond_wait(&g_pool.idle, &g_pool.lock);
+    }
+    g_pool.fn = fn;
+    g_pool.context = context;
+    g_pool.count = count;
+    g_pool.next = 0;
+    g_pool.done = 0;
+    g_pool.generation++;
+    platform_cond_wake_all(&g_pool.work);
+    platform_mutex_unlock(&g_pool.lock);
+    
+    ran = pool_drain(fn, context, count);
+    
+    platform_mutex_lock(&g_pool.lock);
+    g_pool.done += ran;
+    while (g_pool.done < count || g_pool.active > 0) {
+        platform_cond_wait(&g_pool.idle, &g_pool.lock);
+    }
+    g_pool.busy = false;
+    platform_mutex_unlock(&g_pool.lock);
+}
+
+unsigned int pool_threads(void) {
+    if (tls_serial) {
+        return 1;
+    }
+    platform_once(&g_pool_once, pool_start);
+    return g_pool.nthreads + 1;
+}
+
+void pool_set_thread_parallel(bool enabled) {
+    tls_serial = !enabled;
+}
+
+void pool_shutdown(void) {
+    unsigned int i;
+    
+    /* Nothing to stop if the pool never started */
+    if (!platform_once_done(&g_pool_once)) {
+        return;
+    }
+    
+    platform_mutex_lock(&g_pool.lock);
+    g_pool.stop = true;
+    platform_cond_wake_all(&g_pool.work);
+    platform_mutex_unlock(&g_pool.lock);
+    
+    for (i = 0; i < g_pool.nthreads; i++) {
+        platform_thread_join(g_pool.threads[i]);
+    }
+    g_pool.nthreads = 0;
+    platform_cond_destroy(&g_pool.work);
+    platform_cond_destroy(&g_pool.idle);
+    platform_mutex_destroy(&g_pool.lock);
+    platform_once_reset(&g_pool_once);
+}
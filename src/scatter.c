@@ -0,0 +1,86 @@
+#include "scatter.h"
+
+/* Multiplier of the round function (2^64 / golden ratio) */
+#define SCATTER_MULTIPLIER 0x9E3779B97F4A7C15ull
+
+/* splitmix64 step, to derive the round keys from the seed */
+static uint64_t splitmix64(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+/* Round function: multiplicative hash of the keyed half, the top bits of the product so
+   every input bit takes part. One multiply keeps the serial round chain short. */
+static inline uint64_t scatter_round(uint64_t half, uint64_t key, unsigned bits) {
+    return bits ? ((half ^ key) * SCATTER_MULTIPLIER) >> (64 - bits) : 0;
+}
+
+void scatter_init(ScatterPerm *perm, uint64_t seed, uint64_t domain) {
+    unsigned bits = 0;
+    
+    while (bits < 64 && (domain - 1) >> bits) {
+        bits++;
+    }
+    perm->domain = domain;
+    perm->left_bits = (bits + 1) / 2;
+    perm->right_bits = bits / 2;
+    perm->right_mask = (1ull << perm->right_bits) - 1;
+    for (int i = 0; i < SCATTER_ROUNDS; i++) {
+        perm->keys[i] = splitmix64(&seed);
+    }
+}
+
+/* Rounds alternate between the halves, each XORing a hash of the other side into one */
+static inline uint64_t feistel_forward(const ScatterPerm *perm, uint64_t x) {
+    uint64_t l = x >> perm->right_bits;
+    uint64_t r = x & perm->right_mask;
+    
+    for (int i = 0; i < SCATTER_ROUNDS; i++) {
+        if (i & 1) {
+            r ^= scatter_round(l, perm->keys[i], perm->right_bits);
+        } else {
+            l ^= scatter_round(r, perm->keys[i], perm->left_bits);
+        }
+    }
+    return (l << perm->right_bits) | r;
+}
+
+/* The same rounds in reverse order; each one is its own inverse */
+static inline uint64_t feistel_inverse(const ScatterPerm *perm, uint64_t x) {
+    uint64_t l = x >> perm->right_bits;
+    uint64_t r = x & perm->right_mask;
+    
+    for (int i = SCATTER_ROUNDS - 1; i >= 0; i--) {
+        if (i & 1) {
+            r ^= scatter_round(l, perm->keys[i], perm->right_bits);
+        } else {
+            l ^= scatter_round(r, perm->keys[i], perm->left_bits);
+        }
+    }
+    return (l << perm->right_bits) | r;
+}
+
+/* Cycle walking: the block is under twice the domain, so fewer than two passes on average
+   land back inside it */
+uint64_t scatter_map(const ScatterPerm *perm, uint64_t index) {
+    if (perm->domain < 2) {
+        return index;
+    }
+    do {
+        index = feistel_forward(perm, index);
+    } while (index >= perm->domain);
+    return index;
+}
+
+uint64_t scatter_unmap(const ScatterPerm *perm, uint64_t index) {
+    if (perm->domain < 2) {
+        return index;
+    }
+    do {
+        index = feistel_inverse(perm, index);
+    } while (index >= perm->domain);
+    return index;
+}
@@ -1,203 +1,2336 @@
 #include "steg.h"
+#include "platform.h"
+#include "crc32c.h"
+#include "scatter.h"
+#include "cipher.h"
+#include "compress.h"
+#include "pool.h"
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/* Read size for payloads piped through stdin */
+#define PAYLOAD_READ_CHUNK (1u << 16)
+
+/* Payload bytes to embed: a read-only view of a mapped file, or a buffer holding a piped stdin */
+typedef struct {
+    const uint8_t *data;
+    uint32_t size;
+#ifdef _WIN32
+    HANDLE file;                /* Mapped file, NULL for stdin */
+    HANDLE mapping;
+#else
+    int fd;                     /* Opened file, valid when owns_fd */
+    bool owns_fd;
+    size_t map_size;            /* Bytes mapped at data, 0 when unmapped */
+#endif
+    uint8_t *buffer;            /* Piped stdin contents */
+    size_t buffer_size;
+} PayloadSource;
+
+/* Status of the last steg_embed/steg_extract on this thread */
+static PLATFORM_THREAD_LOCAL int last_error = STEG_SUCCESS;
+
+int steg_last_error(void) {
+    return last_error;
+}
+
+/* Stream bits carried by one image row with depth bits per sample */
+static size_t row_bits(const ImageInfo *img, unsigned depth) {
+    return (size_t)img->width * (img->channels - (img->has_alpha ? 1 : 0)) * depth;
+}
+
+/* Intersect a bit stream slice [start, start + bits) with the band currently held by img.
+   Band and slice starts are byte aligned in stream space. Returns false if they do not overlap. */
+static bool band_slice(const ImageInfo *img, unsigned depth, size_t start, size_t bits,
+                       size_t *lo, size_t *hi) {
+    size_t band_lo = row_bits(img, depth) * img->band_y;
+    size_t band_hi = band_lo + row_bits(img, depth) * img->band_rows;
+    
+    *lo = start > band_lo ? start : band_lo;
+    *hi = start + bits < band_hi ? start + bits : band_hi;
+    return *lo < *hi;
+}
+
+/* Embed the part of a slice that falls into the current band */
+static bool embed_band_slice(StegContext *ctx, const uint8_t *src, size_t src_start, size_t src_bits) {
+    size_t lo, hi;
+    
+    if (!band_slice(ctx->image, ctx->depth ? ctx->depth : 1, src_start, src_bits, &lo, &hi)) {
+        return true;
+    }
+    return steg_embed_bits(ctx, src + ((lo - src_start) >> 3), hi - lo, lo);
+}
+
+/* Extract the part of a slice that falls into the current band */
+static bool extract_band_slice(StegContext *ctx, uint8_t *dst, size_t dst_start, size_t dst_bits) {
+    size_t lo, hi;
+    
+    if (!band_slice(ctx->image, ctx->depth ? ctx->depth : 1, dst_start, dst_bits, &lo, &hi)) {
+        return true;
+    }
+    return steg_extract_bits(ctx, dst + ((lo - dst_start) >> 3), hi - lo, lo);
+}
+
+static void put_le32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = (uint8_t)(v >> (i * 8));
+    }
+}
+
+static uint32_t get_le32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Largest payload in bytes that fits with its CRC at depth bits per sample */
+static size_t payload_capacity(const ImageInfo *img, unsigned depth) {
+    size_t bits = img->capacity * depth;
+    
+    return bits > STEG_CRC_BITS ? (bits - STEG_CRC_BITS) / 8 : 0;
+}
+
+/* payload_capacity of frame of image_path, from its image header alone */
+static bool frame_capacity(const char *image_path, uint32_t frame, uint8_t depth, size_t *payload_bytes) {
+    ImageInfo image = {0};
+    
+    *payload_bytes = 0;
+    if (!image_open_info_frame(image_path, frame, &image)) {
+        last_error = STEG_ERROR_FORMAT;
+        fprintf(stderr, "Error: Could not open image\n");
+        return false;
+    }
+    
+    *payload_bytes = payload_capacity(&image, depth ? depth : 1);
+    
+    image_close(&image);
+    return true;
+}
+
+/* Image samples one scatter task walks */
+#define SCATTER_TASK_SAMPLES (1u << 16)
+
+/* Scattered body in the current band. Logical body sample j carries stream bits
+   [j * depth, (j + 1) * depth) of payload + CRC and sits in image sample
+   STEG_HEADER_BITS + scatter_map(j); the header keeps the first samples. */
+typedef struct {
+    ImageInfo *image;
+    const ScatterPerm *perm;
+    unsigned depth;
+    size_t used;                /* Logical samples holding payload + CRC */
+    const uint8_t *payload;     /* Embed: payload bytes */
+    size_t payload_size;
+    const uint8_t *trailer;     /* Embed: CRC bytes that follow them */
+    uint8_t *body;              /* Extract: payload + CRC + one spare byte, zeroed; NULL on embed */
+    size_t first;               /* Image samples [first, last) of the band */
+    size_t last;
+    bool forward;               /* Map the logical samples rather than walk the band's */
+} ScatterBand;
+
+/* Low byte of channel (stream order) of pixel x in band row y */
+static uint8_t *scatter_sample_at(const ImageInfo *img, size_t y, size_t x, unsigned channel) {
+    /* Bitstream order is R,G,B regardless of memory layout */
+    if (img->bgr_order && img->channels - (img->has_alpha ? 1 : 0) == 3) {
+        channel = 2 - channel;
+    }
+    return img->row_pointers[y] + x * img->bytes_per_pixel + channel * (img->bit_depth / 8);
+}
+
+/* Low byte of image sample s, which must lie in the current band */
+static uint8_t *scatter_sample(const ImageInfo *img, size_t s) {
+    unsigned usable = img->channels - (img->has_alpha ? 1 : 0);
+    size_t row_samples = (size_t)img->width * usable;
+    
+    return scatter_sample_at(img, s / row_samples - img->band_y, (s % row_samples) / usable,
+                             (unsigned)(s % usable));
+}
+
+static unsigned scatter_src_byte(const ScatterBand *band, size_t i) {
+    if (i < band->payload_size) {
+        return band->payload[i];
+    }
+    i -= band->payload_size;
+    return i < STEG_CRC_BITS / 8 ? band->trailer[i] : 0;
+}
+
+/* Move the depth bits of logical sample j between the stream and the sample at p. Extract
+   ORs into the body atomically: samples of one byte may be handled by different tasks. */
+static void scatter_transfer(const ScatterBand *band, size_t j, uint8_t *p) {
+    size_t bit = j * band->depth;
+    size_t i = bit >> 3;
+    unsigned shift = (unsigned)(bit & 7);
+    unsigned mask = (1u << band->depth) - 1;
+    unsigned v;
+    
+    if (band->body) {
+        v = *p & mask;
+        platform_atomic_or8(band->body + i, (unsigned char)(v << shift));
+        if (shift + band->depth > 8) {
+            platform_atomic_or8(band->body + i + 1, (unsigned char)(v >> (8 - shift)));
+        }
+    } else {
+        v = scatter_src_byte(band, i) >> shift;
+        if (shift + band->depth > 8) {
+            v |= scatter_src_byte(band, i + 1) << (8 - shift);
+        }
+        *p = (uint8_t)((*p & ~mask) | (v & mask));
+    }
+}
+
+static void scatter_task(void *context, size_t index) {
+    const ScatterBand *band = (const ScatterBand *)context;
+    const ImageInfo *img = band->image;
+    unsigned usable = img->channels - (img->has_alpha ? 1 : 0);
+    size_t row_samples = (size_t)img->width * usable;
+    size_t lo = index * SCATTER_TASK_SAMPLES;
+    size_t hi, j, s, y, x;
+    unsigned channel;
+    
+    if (band->forward) {
+        hi = band->used - lo < SCATTER_TASK_SAMPLES ? band->used : lo + SCATTER_TASK_SAMPLES;
+        for (j = lo; j < hi; j++) {
+            s = STEG_HEADER_BITS + (size_t)scatter_map(band->perm, j);
+            if (s >= band->first && s < band->last) {
+                scatter_transfer(band, j, scatter_sample(img, s));
+            }
+        }
+        return;
+    }
+    
+    /* The band is walked in order, so the sample position is stepped rather than divided */
+    lo += band->first;
+    hi = band->last - lo < SCATTER_TASK_SAMPLES ? band->last : lo + SCATTER_TASK_SAMPLES;
+    y = lo / row_samples - img->band_y;
+    x = (lo % row_samples) / usable;
+    channel = (unsigned)(lo % usable);
+    for (s = lo; s < hi; s++) {
+        j = (size_t)scatter_unmap(band->perm, s - STEG_HEADER_BITS);
+        if (j < band->used) {
+            scatter_transfer(band, j, scatter_sample_at(img, y, x, channel));
+        }
+        if (++channel == usable) {
+            channel = 0;
+            if (++x == img->width) {
+                x = 0;
+                y++;
+            }
+        }
+    }
+}
+
+/* Embed or extract the scattered body samples that fall into the current band */
+static void scatter_band(ScatterBand *band) {
+    size_t row_samples = row_bits(band->image, 1);
+    size_t count;
+    
+    band->first = row_samples * band->image->band_y;
+    band->last = band->first + row_samples * band->image->band_rows;
+    if (band->first < STEG_HEADER_BITS) {
+        band->first = STEG_HEADER_BITS;
+    }
+    if (band->first >= band->last) {
+        return;
+    }
+    
+    /* Whichever is fewer: a small payload is located by mapping its samples forward, a band
+       smaller than the payload is walked through the inverse */
+    band->forward = band->used < band->last - band->first;
+    count = band->forward ? band->used : band->last - band->first;
+    pool_run(scatter_task, band, (count + SCATTER_TASK_SAMPLES - 1) / SCATTER_TASK_SAMPLES);
+}
+
+/* Anything past the header's 32-bit length or the capacity is rejected by the caller;
+   returns false when the file is too large to be worth mapping */
+static bool payload_set_size(PayloadSource *src, uint64_t size, size_t max_size) {
+    if (size > max_size) {
+        src->size = max_size < UINT32_MAX ? (uint32_t)max_size + 1 : UINT32_MAX;
+        return false;
+    }
+    src->size = (uint32_t)size;
+    return true;
+}
+
+#ifdef _WIN32
+/* Map a file (or stdin redirected from one) as the payload; an empty file has no view */
+static bool payload_map(PayloadSource *src, HANDLE file, size_t max_size) {
+    LARGE_INTEGER size;
+    
+    if (!GetFileSizeEx(file, &size)) {
+        return false;
+    }
+    if (!payload_set_size(src, (uint64_t)size.QuadPart, max_size) || src->size == 0) {
+        return true;
+    }
+    
+    src->mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!src->mapping) {
+        return false;
+    }
+    src->data = (const uint8_t *)MapViewOfFile(src->mapping, FILE_MAP_READ, 0, 0, 0);
+    return src->data != NULL;
+}
+#else
+/* Map a regular file (or stdin redirected from one) as the payload; an empty file has no view */
+static bool payload_map(PayloadSource *src, int fd, size_t max_size) {
+    struct stat st;
+    void *view;
+    
+    if (fstat(fd, &st) != 0) {
+        return false;
+    }
+    if (!payload_set_size(src, (uint64_t)st.st_size, max_size) || src->size == 0) {
+        return true;
+    }
+    
+    view = mmap(NULL, src->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    posix_madvise(view, src->size, POSIX_MADV_SEQUENTIAL);
+    src->data = (const uint8_t *)view;
+    src->map_size = src->size;
+    return true;
+}
+#endif
+
+/* Read a piped stdin in chunks, keeping at most max_size + 1 bytes so an oversized
+   payload is caught without draining the pipe */
+static bool payload_read_pipe(PayloadSource *src, size_t max_size) {
+    size_t used = 0;
+    size_t got;
+    
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    for (;;) {
+        if (used == src->buffer_size) {
+            size_t grow = src->buffer_size ? src->buffer_size * 2 : PAYLOAD_READ_CHUNK;
+            uint8_t *buffer;
+            
+            if (grow > max_size + 1) {
+                grow = max_size + 1;
+            }
+            if (grow <= src->buffer_size) {
+                break;
+            }
+            buffer = (uint8_t *)malloc(grow);
+            if (!buffer) {
+                return false;
+            }
+            /* Security: the old buffer is wiped rather than left to realloc */
+            if (src->buffer) {
+                memcpy(buffer, src->buffer, used);
+                memset(src->buffer, 0, src->buffer_size);
+                free(src->buffer);
+            }
+            src->buffer = buffer;
+            src->buffer_size = grow;
+        }
+        
+        got = fread(src->buffer + used, 1, src->buffer_size - used, stdin);
+        used += got;
+        if (got == 0) {
+            if (ferror(stdin)) {
+                return false;
+            }
+            break;
+        }
+    }
+    
+    src->data = src->buffer;
+    src->size = (uint32_t)used;
+    return true;
+}
+
+/* Open the payload at path ("-" for stdin); max_size bounds what is worth reading */
+static bool payload_open(PayloadSource *src, const char *path, size_t max_size) {
+    memset(src, 0, sizeof(*src));
+    if (max_size > UINT32_MAX - 1) {
+        max_size = UINT32_MAX - 1;
+    }
+    
+#ifdef _WIN32
+    if (strcmp(path, "-") == 0) {
+        HANDLE in = GetStdHandle(STD_INPUT_HANDLE);
+        if (in && in != INVALID_HANDLE_VALUE && GetFileType(in) == FILE_TYPE_DISK) {
+            return payload_map(src, in, max_size);
+        }
+        return payload_read_pipe(src, max_size);
+    }
+    
+    src->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                            FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (src->file == INVALID_HANDLE_VALUE) {
+        src->file = NULL;
+        return false;
+    }
+    return payload_map(src, src->file, max_size);
+#else
+    struct stat st;
+    
+    if (strcmp(path, "-") == 0) {
+        if (fstat(STDIN_FILENO, &st) == 0 && S_ISREG(st.st_mode)) {
+            return payload_map(src, STDIN_FILENO, max_size);
+        }
+        return payload_read_pipe(src, max_size);
+    }
+    
+    src->fd = open(path, O_RDONLY);
+    if (src->fd < 0) {
+        return false;
+    }
+    src->owns_fd = true;
+    return payload_map(src, src->fd, max_size);
+#endif
+}
+
+static void payload_close(PayloadSource *src) {
+#ifdef _WIN32
+    if (src->mapping) {
+        if (src->data) {
+            UnmapViewOfFile(src->data);
+        }
+        CloseHandle(src->mapping);
+    }
+    if (src->file) {
+        CloseHandle(src->file);
+    }
+#else
+    if (src->map_size) {
+        munmap((void *)src->data, src->map_size);
+    }
+    if (src->owns_fd) {
+        close(src->fd);
+    }
+#endif
+    if (src->buffer) {
+        /* Security: zero the buffer before freeing */
+        memset(src->buffer, 0, src->buffer_size);
+        free(src->buffer);
+    }
+    memset(src, 0, sizeof(*src));
+}
+
+/* Payload header fields; extract rebuilds the same bytes as the cipher AAD */
+static void header_pack(uint8_t *header, uint8_t flags, uint32_t size) {
+    put_le32(header, STEG_HEADER_MAGIC);
+    header[4] = STEG_HEADER_VERSION;
+    header[5] = flags;
+    header[6] = 0;
+    header[7] = 0;
+    put_le32(header + 8, size);
+}
+
+/* Bytes of the payload as stored, for the capacity and header: sealed size with a key */
+static size_t stored_size(size_t payload_size, const StegOptions *options) {
+    return payload_size + (options && options->key ? CIPHER_OVERHEAD : 0);
+}
+
+/* Largest payload worth reading for covers holding capacity payload bytes: packed at best
+   when it may be compressed, but no more than compression takes unless it fits raw */
+static size_t payload_limit(size_t capacity, const StegOptions *options) {
+    size_t packed;
+    
+    if (!options || options->compress == STEG_COMPRESS_OFF) {
+        return capacity;
+    }
+    packed = capacity < UINT32_MAX / COMPRESS_MAX_RATIO ? capacity * COMPRESS_MAX_RATIO : UINT32_MAX;
+    if (packed > STEG_COMPRESS_MAX_BYTES) {
+        packed = capacity > STEG_COMPRESS_MAX_BYTES ? capacity : STEG_COMPRESS_MAX_BYTES;
+    }
+    return packed;
+}
+
+/* A payload too large to be packed in memory */
+static void report_compress_limit(void) {
+    last_error = STEG_ERROR_ARGS;
+    fprintf(stderr, "Error: Compression takes payloads up to %u MiB\n", STEG_COMPRESS_MAX_BYTES >> 20);
+}
+
+/* Image rows the header, a stored payload of size bytes and its CRC span at depth */
+static size_t stream_rows(const ImageInfo *img, unsigned depth, size_t size) {
+    size_t bits = (size_t)STEG_HEADER_BITS * depth + size * 8 + STEG_CRC_BITS;
+    
+    return (bits + row_bits(img, depth) - 1) / row_bits(img, depth);
+}
+
+/* Rows of one operation and where its stored payload sits in the stream, for progress */
+typedef struct {
+    const StegOptions *options;
+    const ImageInfo *image;
+    unsigned depth;
+    size_t body;                /* Stream offset of the payload */
+    size_t size;                /* Stored payload bytes */
+    bool scattered;             /* Bytes counted in proportion to the rows */
+    uint32_t rows_total;
+} ProgressState;
+
+/* At a row band boundary: check the cancel flag, then report the rows above rows_done as
+   through with phase. False once cancelled; the operation then fails with
+   STEG_ERROR_CANCELLED. */
+static bool report_progress(const ProgressState *state, StegPhase phase, uint32_t rows_done) {
+    const StegOptions *options = state->options;
+    StegProgress progress;
+    bool cancelled;
+    size_t end;
+    
+    if (!options) {
+        return true;
+    }
+    cancelled = options->cancel && *options->cancel;
+    if (!cancelled && options->progress) {
+        progress.phase = phase;
+        progress.rows_done = rows_done < state->rows_total ? rows_done : state->rows_total;
+        progress.rows_total = state->rows_total;
+        progress.bytes_total = state->size;
+        if (state->scattered) {
+            progress.bytes_done = (size_t)((uint64_t)state->size * progress.rows_done / state->rows_total);
+        } else {
+            end = row_bits(state->image, state->depth) * progress.rows_done;
+            progress.bytes_done = end > state->body ? (end - state->body) / 8 : 0;
+            progress.bytes_done = progress.bytes_done < state->size ? progress.bytes_done : state->size;
+        }
+        cancelled = !options->progress(options->progress_context, &progress);
+    }
+    if (!cancelled) {
+        return true;
+    }
+    last_error = STEG_ERROR_CANCELLED;
+    fprintf(stderr, "Error: Operation cancelled\n");
+    return false;
+}
+
+/* Start of the clock for stats; no clock calls without stats */
+static uint64_t stats_clock(const StegStats *stats) {
+    return stats ? platform_time_ns() : 0;
+}
+
+/* Charge the time since *mark to phase and restart the mark */
+static void stats_lap(StegStats *stats, StegStatsPhase phase, uint64_t *mark) {
+    uint64_t now;
+    
+    if (!stats) {
+        return;
+    }
+    now = platform_time_ns();
+    stats->phase_ns[phase] += now - *mark;
+    *mark = now;
+}
+
+/* Clear the stats of an operation starting now; returns its start */
+static uint64_t stats_begin(StegStats *stats) {
+    if (stats) {
+        memset(stats, 0, sizeof(*stats));
+    }
+    return stats_clock(stats);
+}
+
+/* Complete the stats of an operation that decoded input and encoded output (NULL = none):
+   the time no phase claimed goes to STEG_STATS_OTHER */
+static void stats_end(StegStats *stats, uint64_t start, const ImageInfo *input, const ImageInfo *output) {
+    uint64_t timed = 0;
+    
+    if (!stats) {
+        return;
+    }
+    stats->total_ns = platform_time_ns() - start;
+    for (int i = 0; i < STEG_STATS_PHASES; i++) {
+        timed += i != STEG_STATS_OTHER ? stats->phase_ns[i] : 0;
+    }
+    stats->phase_ns[STEG_STATS_OTHER] = stats->total_ns > timed ? stats->total_ns - timed : 0;
+    
+    /* Rows are decoded in order from the top, so the last band held ends the decoded rows */
+    stats->rows_decoded = input->band_y + input->band_rows;
+    stats->bytes_decoded = (uint64_t)stats->rows_decoded * input->rowbytes;
+    stats->rows_encoded = output ? output->rows_written : 0;
+    stats->bytes_encoded = output ? (uint64_t)output->rows_written * output->rowbytes : 0;
+    stats->peak_memory = platform_peak_memory();
+}
+
+/* Auto mode packs only payloads spanning at least this many rows, and keeps the result when
+   the raw payload does not fit or it saves this many rows and an eighth of them */
+#define COMPRESS_AUTO_MIN_ROWS 8
+
+/* Pack the payload into *packed when options ask for it and it shrinks (in auto mode, when
+   it pays off). Returns false when it is past STEG_COMPRESS_MAX_BYTES or the staging buffer
+   cannot be allocated. */
+static bool embed_compress(const ImageInfo *cover, unsigned depth, const uint8_t *payload,
+                           size_t payload_size, const StegOptions *options, uint8_t **packed,
+                           size_t *packed_size, size_t *packed_alloc) {
+    StegCompress mode = options ? options->compress : STEG_COMPRESS_OFF;
+    size_t raw_rows = stream_rows(cover, depth, stored_size(payload_size, options));
+    size_t rows;
+    bool fits = stored_size(payload_size, options) * 8 + STEG_CRC_BITS <= cover->capacity * depth;
+    
+    *packed = NULL;
+    if (mode == STEG_COMPRESS_OFF ||
+        (mode == STEG_COMPRESS_AUTO && fits && raw_rows < COMPRESS_AUTO_MIN_ROWS)) {
+        return true;
+    }
+    if (payload_size > STEG_COMPRESS_MAX_BYTES) {
+        if (mode == STEG_COMPRESS_AUTO && fits) {
+            return true;
+        }
+        report_compress_limit();
+        return false;
+    }
+    *packed_alloc = compress_bound(payload_size);
+    *packed = (uint8_t *)malloc(*packed_alloc);
+    if (!*packed) {
+        last_error = STEG_ERROR_IO;
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return false;
+    }
+    *packed_size = compress_pack(payload, payload_size, *packed);
+    
+    /* A payload that does not shrink is stored raw either way */
+    rows = stream_rows(cover, depth, stored_size(*packed_size, options));
+    if (*packed_size >= payload_size ||
+        (mode == STEG_COMPRESS_AUTO && fits &&
+         (raw_rows - rows < COMPRESS_AUTO_MIN_ROWS || raw_rows - rows < raw_rows / 8))) {
+        /* Security: zero the buffer before freeing */
+        memset(*packed, 0, *packed_alloc);
+        free(*packed);
+        *packed = NULL;
+    }
+    return true;
+}
+
+/* Embed a payload into an opened cover band by band and encode it into steg at steg_path
+   (NULL = in memory, picked up with image_encoded_data), or into the next frame of container
+   when one is given. With steg == cover the bands are written back to the cover itself
+   (caller-held pixels). options NULL = defaults.
+   With a key the payload is sealed as its bytes are needed, one band slice at a time, so
+   the ciphertext goes from cache straight into the bit kernels; the CRC covers it as stored.
+   A compressed payload is packed whole up front, before it is sealed. shard marks a payload
+   that starts with a shard record (steg_embed_multi). */
+static bool embed_image(ImageInfo *cover, ImageInfo *steg, const char *steg_path, ImageInfo *container,
+                        const uint8_t *payload, size_t payload_size, const StegOptions *options,
+                        bool shard) {
+    StegContext ctx = {0};
+    ScatterPerm perm;
+    ScatterBand band = {0};
+    CipherStream seal = {0};
+    ProgressState progress = {0};
+    bool scatter = options && options->scatter;
+    bool encrypt = options && options->key;
+    bool success = false;
+    size_t required_bits;
+    size_t body, lo, hi, size;
+    uint32_t y, rows;
+    uint32_t crc = 0;
+    uint8_t header[STEG_HEADER_BITS / 8];
+    uint8_t trailer[STEG_CRC_BITS / 8] = {0};
+    uint8_t *chunk = NULL;
+    size_t chunk_size = 0;
+    const uint8_t *stored;
+    const uint8_t *part;
+    uint8_t *packed = NULL;
+    size_t packed_size = 0, packed_alloc = 0;
+    unsigned depth = options && options->depth ? options->depth : 1;
+    StegStats *stats = options ? options->stats : NULL;
+    uint64_t mark = stats_clock(stats);
+    
+    if (depth > STEG_MAX_DEPTH) {
+        last_error = STEG_ERROR_ARGS;
+        fprintf(stderr, "Error: Depth must be 1 to %d\n", STEG_MAX_DEPTH);
+        return false;
+    }
+    if (encrypt && !cipher_available()) {
+        last_error = STEG_ERROR_ARGS;
+        fprintf(stderr, "Error: Built without encryption support\n");
+        return false;
+    }
+    
+    /* The packed payload takes the place of the original from here on */
+    if (!embed_compress(cover, depth, payload, payload_size, options, &packed, &packed_size,
+                        &packed_alloc)) {
+        return false;
+    }
+    if (packed) {
+        fprintf(stderr, "Compressed %zu bytes to %zu\n", payload_size, packed_size);
+    }
+    stored = packed ? packed : payload;
+    size = stored_size(packed ? packed_size : payload_size, options);
+    stats_lap(stats, STEG_STATS_COMPRESS, &mark);
+    if (stats) {
+        stats->payload_bytes = size;
+    }
+    
+    /* Check capacity early; every extra bit plane adds the capacity of the first */
+    required_bits = size * 8 + STEG_CRC_BITS;
+    if (size > UINT32_MAX || required_bits > cover->capacity * depth) {
+        last_error = STEG_ERROR_CAPACITY;
+        fprintf(stderr, "Error: Cover image too small for payload\n");
+        fprintf(stderr, "       Required: %zu bits, Available: %zu bits\n", 
+                required_bits, cover->capacity * depth);
+        goto cleanup;
+    }
+    
+    /* Create steg image; it takes over the cover plane so LSBs are set in place */
+    cover->png_profile = (uint8_t)(options ? options->png_profile : STEG_PNG_FAST);
+    if (steg != cover && !(container ? image_open_write_frame(container, steg, cover) :
+                                       image_open_write_from(steg_path, steg, cover))) {
+        last_error = STEG_ERROR_PNG;
+        fprintf(stderr, "Error: Could not create steg image\n");
+        goto cleanup;
+    }
+    stats_lap(stats, STEG_STATS_OTHER, &mark);
+    
+    /* Set up steganography context */
+    ctx.image = steg;
+    ctx.payload_size = (uint32_t)size;
+    
+    /* Header in the LSBs of the first samples; the payload and its CRC follow at depth bits
+       per sample, starting at stream offset body */
+    header_pack(header, (uint8_t)((depth - 1) | (scatter ? STEG_FLAG_SCATTER : 0) |
+                                  (encrypt ? STEG_FLAG_ENCRYPTED : 0) |
+                                  (packed ? STEG_FLAG_COMPRESSED : 0) | (shard ? STEG_FLAG_SHARD : 0)),
+                (uint32_t)size);
+    body = (size_t)STEG_HEADER_BITS * depth;
+    progress.options = options;
+    progress.image = cover;
+    progress.depth = depth;
+    progress.body = body;
+    progress.size = size;
+    progress.scattered = scatter;
+    progress.rows_total = cover->height;
+    
+    if (encrypt) {
+        if (!cipher_seal_begin(&seal, options->key, header, sizeof(header), stored,
+                               size - CIPHER_OVERHEAD)) {
+            last_error = STEG_ERROR_IO;
+            fprintf(stderr, "Error: Payload encryption failed\n");
+            goto cleanup;
+        }
+        stats_lap(stats, STEG_STATS_KEY, &mark);
+        
+        /* A scattered body is read in permuted order, so it is sealed whole up front;
+           otherwise one band of bytes at a time */
+        chunk_size = scatter ? size : row_bits(steg, depth) * cover->band_capacity / 8 + 1;
+        chunk = (uint8_t *)malloc(chunk_size);
+        if (!chunk) {
+            last_error = STEG_ERROR_IO;
+            fprintf(stderr, "Error: Memory allocation failed\n");
+            goto cleanup;
+        }
+        if (scatter) {
+            if (!cipher_seal_read(&seal, chunk, size)) {
+                last_error = STEG_ERROR_IO;
+                fprintf(stderr, "Error: Payload encryption failed\n");
+                goto cleanup;
+            }
+            stored = chunk;
+        }
+    }
+    
+    /* A scattered body can land in the first band, so its CRC is taken up front */
+    if (scatter) {
+        put_le32(trailer, crc32c_update(0, stored, size));
+        scatter_init(&perm, options->seed, cover->capacity);
+        band.image = steg;
+        band.perm = &perm;
+        band.depth = depth;
+        band.used = (required_bits + depth - 1) / depth;
+        band.payload = stored;
+        band.payload_size = size;
+        band.trailer = trailer;
+    }
+    stats_lap(stats, STEG_STATS_PAYLOAD, &mark);
+    
+    /* Stream the image band by band: decode, embed the slice that lands in it, encode */
+    for (y = 0; y < cover->height; y += rows) {
+        rows = cover->height - y < cover->band_capacity ? cover->height - y : cover->band_capacity;
+        
+        if (!image_read_rows(cover, y, rows)) {
+            last_error = STEG_ERROR_FORMAT;
+            fprintf(stderr, "Error: Failed to decode cover rows\n");
+            goto cleanup;
+        }
+        stats_lap(stats, STEG_STATS_DECODE, &mark);
+        if (!report_progress(&progress, STEG_PHASE_DECODE, y + rows)) {
+            goto cleanup;
+        }
+        steg->band_y = y;
+        steg->band_rows = rows;
+        
+        ctx.depth = 1;
+        if (!embed_band_slice(&ctx, header, 0, STEG_HEADER_BITS)) {
+            last_error = STEG_ERROR_FORMAT;
+            fprintf(stderr, "Error: Failed to embed payload header\n");
+            goto cleanup;
+        }
+        
+        /* The CRC takes each band's payload bytes right after they are packed, while they
+           are still in cache; the trailer is only reached once all of them are counted */
+        ctx.depth = (uint8_t)depth;
+        if (scatter) {
+            scatter_band(&band);
+        } else {
+            if (band_slice(steg, depth, body, size * 8, &lo, &hi)) {
+                part = stored + ((lo - body) >> 3);
+                if (encrypt) {
+                    if (!cipher_seal_read(&seal, chunk, (hi - lo) >> 3)) {
+                        last_error = STEG_ERROR_IO;
+                        fprintf(stderr, "Error: Payload encryption failed\n");
+                        goto cleanup;
+                    }
+                    part = chunk;
+                }
+                if (!steg_embed_bits(&ctx, part, hi - lo, lo)) {
+                    last_error = STEG_ERROR_FORMAT;
+                    fprintf(stderr, "Error: Failed to embed payload data\n");
+                    goto cleanup;
+                }
+                crc = crc32c_update(crc, part, (hi - lo) >> 3);
+            }
+            put_le32(trailer, crc);
+            if (!embed_band_slice(&ctx, trailer, body + size * 8, STEG_CRC_BITS)) {
+                last_error = STEG_ERROR_FORMAT;
+                fprintf(stderr, "Error: Failed to embed payload checksum\n");
+                goto cleanup;
+            }
+        }
+        stats_lap(stats, STEG_STATS_PAYLOAD, &mark);
+        if (!report_progress(&progress, STEG_PHASE_EMBED, y + rows)) {
+            goto cleanup;
+        }
+        
+        if (!image_write_rows(steg, rows)) {
+            last_error = STEG_ERROR_PNG;
+            fprintf(stderr, "Error: Failed to encode steg rows\n");
+            goto cleanup;
+        }
+        stats_lap(stats, STEG_STATS_ENCODE, &mark);
+        if (!report_progress(&progress, STEG_PHASE_ENCODE, y + rows)) {
+            goto cleanup;
+        }
+    }
+    
+    /* Finalize the PNG output */
+    if (steg != cover && !image_finalize_write(steg)) {
+        last_error = STEG_ERROR_PNG;
+        fprintf(stderr, "Error: Failed to finalize PNG output\n");
+        goto cleanup;
+    }
+    stats_lap(stats, STEG_STATS_ENCODE, &mark);
+    
+    fprintf(stderr, "Successfully embedded %zu bytes (%zu bits)\n", 
+            payload_size, payload_size * 8);
+    success = true;
+    
+cleanup:
+    if (chunk) {
+        /* Security: zero the buffer before freeing */
+        memset(chunk, 0, chunk_size);
+        free(chunk);
+    }
+    if (packed) {
+        memset(packed, 0, packed_alloc);
+        free(packed);
+    }
+    cipher_stream_end(&seal);
+    return success;
+}
+
+/* Steg images are written next to their target under this suffix and moved over it only once
+   the embed succeeds, so a failed run leaves an existing file as it was - the cover among them
+   when it is embedded in place, which is also never truncated while it is still being read */
+#define STEG_TEMP_SUFFIX ".tmp"
+
+/* Temporary output path of steg_path; free() it */
+static char *steg_temp_path(const char *steg_path) {
+    size_t length = strlen(steg_path);
+    char *temp_path = (char *)malloc(length + sizeof(STEG_TEMP_SUFFIX));
+    
+    if (!temp_path) {
+        last_error = STEG_ERROR_IO;
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return NULL;
+    }
+    memcpy(temp_path, steg_path, length);
+    memcpy(temp_path + length, STEG_TEMP_SUFFIX, sizeof(STEG_TEMP_SUFFIX));
+    return temp_path;
+}
+
+/* Refuse a temporary output that names one of the count covers still to be read, which the
+   encoder would truncate under the decoder (a cover called "<steg>.tmp") */
+static bool steg_check_output(const char *temp_path, const char *const *cover_paths, size_t count) {
+    FILE *existing = fopen(temp_path, "rb");
+    size_t i;
+    
+    /* Nothing to collide with unless a file of that name exists */
+    if (!existing) {
+        return true;
+    }
+    fclose(existing);
+    for (i = 0; i < count; i++) {
+        if (platform_same_file(temp_path, cover_paths[i])) {
+            last_error = STEG_ERROR_ARGS;
+            fprintf(stderr, "Error: Cover image %s would be overwritten by the steg image output\n", cover_paths[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Close a steg image opened for writing to temp_path; one left unfinished is removed so a
+   failed or cancelled embed leaves no partial file behind */
+static void steg_close_output(ImageInfo *steg, const char *temp_path, bool success) {
+    bool created = steg->codec != NULL;
+    
+    image_close(steg);
+    if (!success && created) {
+        remove(temp_path);
+    }
+}
+
+/* Move the finished steg image at temp_path over steg_path */
+static bool steg_commit_output(const char *temp_path, const char *steg_path) {
+    if (!platform_replace_file(temp_path, steg_path)) {
+        last_error = STEG_ERROR_IO;
+        fprintf(stderr, "Error: Could not write steg image %s\n", steg_path);
+        remove(temp_path);
+        return false;
+    }
+    return true;
+}
 
 /* Embeds payload into cover image and saves result as steg image */
 bool steg_embed(const char *cover_path, const char *payload_path, const char *steg_path) {
+    return steg_embed_ex(cover_path, payload_path, steg_path, NULL);
+}
+
+bool steg_embed_ex(const char *cover_path, const char *payload_path, const char *steg_path,
+                   const StegOptions *options) {
+    ImageInfo cover = {0};
+    ImageInfo steg = {0};
+    PayloadSource payload;
+    size_t capacity, limit;
+    char *temp_path;
+    bool success;
+    StegStats *stats = options ? options->stats : NULL;
+    uint64_t start = stats_begin(stats);
+    
+    last_error = STEG_SUCCESS;
+    
+    /* Open cover image for banded decoding */
+    if (!image_open_stream(cover_path, &cover, 0)) {
+        last_error = STEG_ERROR_FORMAT;
+        fprintf(stderr, "Error: Could not open cover image\n");
+        stats_end(stats, start, &cover, NULL);
+        return false;
+    }
+    
+    /* Map the payload (or read it from stdin) - bounded by what the cover can hold, packed
+       at best when it may be compressed */
+    capacity = payload_capacity(&cover, options && options->depth ? options->depth : 1);
+    capacity -= capacity > stored_size(0, options) ? stored_size(0, options) : capacity;
+    limit = payload_limit(capacity, options);
+    if (!payload_open(&payload, payload_path, limit)) {
+        last_error = STEG_ERROR_IO;
+        fprintf(stderr, "Error: Could not read payload file\n");
+        payload_close(&payload);
+        stats_end(stats, start, &cover, NULL);
+        image_close(&cover);
+        return false;
+    }
+    
+    /* Past the limit only the size is known, not the bytes */
+    if (payload.size > limit) {
+        if (limit > capacity && limit == STEG_COMPRESS_MAX_BYTES) {
+            report_compress_limit();
+        } else {
+            last_error = STEG_ERROR_CAPACITY;
+            fprintf(stderr, "Error: Cover image too small for payload\n");
+            fprintf(stderr, "       Available: %zu bytes\n", capacity);
+        }
+        payload_close(&payload);
+        stats_end(stats, start, &cover, NULL);
+        image_close(&cover);
+        return false;
+    }
+    
+    temp_path = steg_temp_path(steg_path);
+    success = temp_path && steg_check_output(temp_path, &cover_path, 1) &&
+              embed_image(&cover, &steg, temp_path, NULL, payload.data, payload.size, options, false);
+    
+    /* The cover is closed before the steg image may replace it */
+    stats_end(stats, start, &cover, &steg);
+    payload_close(&payload);
+    image_close(&cover);
+    if (temp_path) {
+        steg_close_output(&steg, temp_path, success);
+        success = success && steg_commit_output(temp_path, steg_path);
+        free(temp_path);
+    }
+    
+    return success;
+}
+
+bool steg_embed_mem(const uint8_t *cover_data, size_t cover_size, const uint8_t *payload,
+                    size_t payload_size, uint8_t **steg_data, size_t *steg_size) {
+    return steg_embed_mem_ex(cover_data, cover_size, payload, payload_size, steg_data, steg_size, NULL);
+}
+
+bool steg_embed_mem_ex(const uint8_t *cover_data, size_t cover_size, const uint8_t *payload,
+                       size_t payload_size, uint8_t **steg_data, size_t *steg_size,
+                       const StegOptions *options) {
     ImageInfo cover = {0};
     ImageInfo steg = {0};
-    FILE *payload_file = NULL;
-    uint8_t *payload_data = NULL;
-    uint32_t payload_size = 0;
-    uint32_t required_bits;
     bool success = false;
+    StegStats *stats = options ? options->stats : NULL;
+    uint64_t start = stats_begin(stats);
+    
+    last_error = STEG_SUCCESS;
+    if (!steg_data || !steg_size || (payload_size && !payload)) {
+        last_error = STEG_ERROR_ARGS;
+        return false;
+    }
+    *steg_data = NULL;
+    *steg_size = 0;
+    
+    if (!image_open_stream_mem(cover_data, cover_size, &cover, 0)) {
+        last_error = STEG_ERROR_FORMAT;
+        fprintf(stderr, "Error: Could not open cover image\n");
+        stats_end(stats, start, &cover, NULL);
+        return false;
+    }
+    
+    if (embed_image(&cover, &steg, NULL, NULL, payload, payload_size, options, false)) {
+        success = image_encoded_data(&steg, steg_data, steg_size);
+        if (!success) {
+            last_error = STEG_ERROR_PNG;
+        }
+    }
+    
+    stats_end(stats, start, &cover, &steg);
+    image_close(&cover);
+    image_close(&steg);
+    
+    return success;
+}
+
+bool steg_embed_pixels(uint8_t *pixels, uint32_t width, uint32_t height, size_t stride,
+                       StegPixelFormat format, const uint8_t *payload, size_t payload_size) {
+    return steg_embed_pixels_ex(pixels, width, height, stride, format, payload, payload_size, NULL);
+}
+
+bool steg_embed_pixels_ex(uint8_t *pixels, uint32_t width, uint32_t height, size_t stride,
+                          StegPixelFormat format, const uint8_t *payload, size_t payload_size,
+                          const StegOptions *options) {
+    ImageInfo image = {0};
+    bool success;
+    StegStats *stats = options ? options->stats : NULL;
+    uint64_t start = stats_begin(stats);
+    
+    last_error = STEG_SUCCESS;
+    if (payload_size && !payload) {
+        last_error = STEG_ERROR_ARGS;
+        return false;
+    }
+    if (!image_open_pixels(&image, pixels, width, height, stride, format)) {
+        last_error = STEG_ERROR_ARGS;
+        fprintf(stderr, "Error: Invalid pixel buffer\n");
+        stats_end(stats, start, &image, NULL);
+        return false;
+    }
+    
+    success = embed_image(&image, &image, NULL, NULL, payload, payload_size, options, false);
+    
+    stats_end(stats, start, &image, NULL);
+    image_close(&image);
+    return success;
+}
+
+/* Shared state of steg_embed_multi; shard i holds payload bytes [offsets[i], offsets[i + 1]) */
+typedef struct {
+    const uint8_t *payload;
+    uint32_t payload_size;
+    uint32_t set_id;
+    size_t count;
+    const char *const *cover_paths;
+    const uint32_t *frames;     /* Cover frame per shard, NULL = frame 0 of each */
+    char **temp_paths;          /* Output of shard i until the whole set is done */
+    ImageInfo *container;       /* Multi-frame output taking shard i as frame i, NULL = temp_paths */
+    const StegOptions *options;
+    size_t *offsets;
+    int *status;                /* STEG_* result per shard */
+} MultiEmbed;
+
+static void put_le16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+/* Embed shard index into its cover: the shard record, then its slice of the payload */
+static void embed_shard_task(void *context, size_t index) {
+    const MultiEmbed *multi = (const MultiEmbed *)context;
+    ImageInfo cover = {0};
+    ImageInfo steg = {0};
+    size_t size = multi->offsets[index + 1] - multi->offsets[index];
+    uint32_t frame = multi->frames ? multi->frames[index] : 0;
+    uint8_t *shard;
+    bool success = false;
+    
+    last_error = STEG_SUCCESS;
+    shard = (uint8_t *)malloc(STEG_SHARD_BYTES + size);
+    if (!shard) {
+        last_error = STEG_ERROR_IO;
+        fprintf(stderr, "Error: Memory allocation failed\n");
+    } else if (!image_open_stream_frame(multi->cover_paths[index], frame, &cover, 0)) {
+        last_error = STEG_ERROR_FORMAT;
+        if (multi->frames) {
+            fprintf(stderr, "Error: Could not open frame %u of cover image %s\n", frame, multi->cover_paths[index]);
+        } else {
+            fprintf(stderr, "Error: Could not open cover image %s\n", multi->cover_paths[index]);
+        }
+    } else {
+        put_le32(shard, multi->set_id);
+        put_le32(shard + 4, multi->payload_size);
+        put_le32(shard + 8, (uint32_t)multi->offsets[index]);
+        put_le16(shard + 12, (uint16_t)index);
+        put_le16(shard + 14, (uint16_t)multi->count);
+        if (size) {
+            memcpy(shard + STEG_SHARD_BYTES, multi->payload + multi->offsets[index], size);
+        }
+        success = embed_image(&cover, &steg, multi->container ? NULL : multi->temp_paths[index],
+                              multi->container, shard, STEG_SHARD_BYTES + size, multi->options, true);
+    }
+    
+    if (shard) {
+        /* Security: zero the buffer before freeing */
+        memset(shard, 0, STEG_SHARD_BYTES + size);
+        free(shard);
+    }
+    image_close(&cover);
+    if (multi->container) {
+        image_close(&steg);
+    } else {
+        steg_close_output(&steg, multi->temp_paths[index], success);
+    }
+    multi->status[index] = success ? STEG_SUCCESS : last_error != STEG_SUCCESS ? last_error : STEG_ERROR_IO;
+}
+
+/* Embed a set with shard i in frame frames[i] (NULL = frame 0) of cover_paths[i], written to
+   steg_paths[i] or as frame i of container. Separate steg images are moved into place only
+   once every shard is done, as any of them may replace a cover another shard still reads. */
+static bool embed_set(const char *payload_path, size_t count, const char *const *cover_paths,
+                      const uint32_t *frames, const char *const *steg_paths, ImageInfo *container,
+                      const StegOptions *options) {
+    MultiEmbed multi;
+    StegOptions shard_options = {0};
+    PayloadSource payload = {0};
+    size_t *room = NULL;
+    size_t total = 0, left, remaining, bytes, max_size, i;
+    size_t overhead = stored_size(STEG_SHARD_BYTES, options);
+    unsigned depth = options && options->depth ? options->depth : 1;
+    bool success = false;
+    
+    last_error = STEG_SUCCESS;
+    memset(&multi, 0, sizeof(multi));
+    if (count == 0 || count > STEG_MAX_SHARDS || !cover_paths || (!steg_paths && !container)) {
+        last_error = STEG_ERROR_ARGS;
+        fprintf(stderr, "Error: A set takes 1 to %d covers\n", STEG_MAX_SHARDS);
+        return false;
+    }
+    if (depth > STEG_MAX_DEPTH) {
+        last_error = STEG_ERROR_ARGS;
+        fprintf(stderr, "Error: Depth must be 1 to %d\n", STEG_MAX_DEPTH);
+        return false;
+    }
+    room = (size_t *)malloc(sizeof(size_t) * count);
+    multi.offsets = (size_t *)malloc(sizeof(size_t) * (count + 1));
+    multi.status = (int *)malloc(sizeof(int) * count);
+    multi.temp_paths = container ? NULL : (char **)calloc(count, sizeof(char *));
+    if (!room || !multi.offsets || !multi.status || (!container && !multi.temp_paths)) {
+        last_error = STEG_ERROR_IO;
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        goto cleanup;
+    }
+    for (i = 0; !container && i < count; i++) {
+        multi.temp_paths[i] = steg_temp_path(steg_paths[i]);
+        if (!multi.temp_paths[i] || !steg_check_output(multi.temp_paths[i], cover_paths, count)) {
+            goto cleanup;
+        }
+    }
+    
+    /* Shard bytes each cover holds, from its image header alone */
+    for (i = 0; i < count; i++) {
+        if (!frame_capacity(cover_paths[i], frames ? frames[i] : 0, (uint8_t)depth, &bytes)) {
+            goto cleanup;
+        }
+        if (bytes <= overhead) {
+            last_error = STEG_ERROR_CAPACITY;
+            if (frames) {
+                fprintf(stderr, "Error: Frame %u of cover image %s too small for a shard\n",
+                        frames[i], cover_paths[i]);
+            } else {
+                fprintf(stderr, "Error: Cover image %s too small for a shard\n", cover_paths[i]);
+            }
+            goto cleanup;
+        }
+        room[i] = bytes - overhead < UINT32_MAX ? bytes - overhead : UINT32_MAX;
+        total += room[i];
+    }
+    
+    /* Map the payload (or read it from stdin) - bounded by what the set can hold, packed at
+       best when the shards may be compressed */
+    max_size = payload_limit(total < UINT32_MAX ? total : UINT32_MAX, options);
+    if (!payload_open(&payload, payload_path, max_size)) {
+        last_error = STEG_ERROR_IO;
+        fprintf(stderr, "Error: Could not read payload file\n");
+        goto cleanup;
+    }
+    if (payload.size > max_size) {
+        /* The shards are packed at once, so the cap holds for the whole payload */
+        if (max_size > total && max_size == STEG_COMPRESS_MAX_BYTES) {
+            report_compress_limit();
+            goto cleanup;
+        }
+        last_error = STEG_ERROR_CAPACITY;
+        fprintf(stderr, "Error: Cover images too small for payload\n");
+        fprintf(stderr, "       Available: %zu bytes in %zu %s\n", total, count, frames ? "frames" : "covers");
+        goto cleanup;
+    }
+    
+    /* Split in proportion to the room of each cover. Each share rounds down and never
+       exceeds its cover's room while the payload fits, so the last cover takes the rest. */
+    multi.offsets[0] = 0;
+    for (i = 0, remaining = payload.size, left = total; i < count; i++) {
+        bytes = i + 1 == count ? remaining : (size_t)((uint64_t)remaining * room[i] / left);
+        multi.offsets[i + 1] = multi.offsets[i] + bytes;
+        remaining -= bytes;
+        left -= room[i];
+    }
+    
+    multi.payload = payload.data;
+    multi.payload_size = payload.size;
+    multi.set_id = crc32c_update(0, payload.data, payload.size);
+    multi.count = count;
+    multi.cover_paths = cover_paths;
+    multi.frames = frames;
+    multi.container = container;
+    /* Shards run on the pool workers at once, so they call no progress callback and take
+       no stats */
+    if (options) {
+        shard_options = *options;
+    }
+    shard_options.progress = NULL;
+    shard_options.stats = NULL;
+    multi.options = &shard_options;
+    if (container) {
+        /* Frames of one container are encoded one after another, in order; the first
+           failure ends the set, which is reported below */
+        for (i = 0; i < count; i++) {
+            multi.status[i] = STEG_SUCCESS;
+        }
+        for (i = 0; i < count; i++) {
+            embed_shard_task(&multi, i);
+            if (multi.status[i] != STEG_SUCCESS) {
+                break;
+            }
+        }
+    } else {
+        pool_run(embed_shard_task, &multi, count);
+    }
+    
+    /* Report the first failing shard; a partial set is of no use, so none of it is kept */
+    success = true;
+    for (i = 0; i < count; i++) {
+        if (multi.status[i] != STEG_SUCCESS && success) {
+            last_error = multi.status[i];
+            success = false;
+        }
+    }
+    for (i = 0; success && !container && i < count; i++) {
+        success = steg_commit_output(multi.temp_paths[i], steg_paths[i]);
+    }
+    if (!success) {
+        /* Shards not yet moved into place are dropped; a failed move removed its own */
+        for (; !container && i < count; i++) {
+            if (multi.status[i] == STEG_SUCCESS) {
+                remove(multi.temp_paths[i]);
+            }
+        }
+        fprintf(stderr, "Error: Could not embed the set\n");
+    } else {
+        fprintf(stderr, "Successfully embedded %u bytes in %zu shards\n", payload.size, count);
+    }
+    
+cleanup:
+    payload_close(&payload);
+    for (i = 0; multi.temp_paths && i < count; i++) {
+        free(multi.temp_paths[i]);
+    }
+    free(multi.temp_paths);
+    free(room);
+    free(multi.offsets);
+    free(multi.status);
+    return success;
+}
+
+bool steg_embed_multi(const char *payload_path, size_t count, const char *const *cover_paths,
+                      const char *const *steg_paths, const StegOptions *options) {
+    return embed_set(payload_path, count, cover_paths, NULL, steg_paths, NULL, options);
+}
+
+bool steg_embed_frames(const char *payload_path, const char *cover_path, const char *steg_path,
+                       const StegOptions *options) {
+    ImageInfo cover = {0};
+    ImageInfo container = {0};
+    const char **covers = NULL;
+    uint32_t *frames = NULL;
+    char *temp_path;
+    size_t count, i;
+    bool success = false;
+    
+    last_error = STEG_SUCCESS;
+    if (!cover_path || !steg_path) {
+        last_error = STEG_ERROR_ARGS;
+        return false;
+    }
+    temp_path = steg_temp_path(steg_path);
+    if (!temp_path || !steg_check_output(temp_path, &cover_path, 1)) {
+        free(temp_path);
+        return false;
+    }
+    
+    /* The container first, so a backend without multi-frame output says so up front */
+    if (!image_open_container(temp_path, &container)) {
+        last_error = STEG_ERROR_PNG;
+        fprintf(stderr, "Error: Could not create steg image %s\n", steg_path);
+        free(temp_path);
+        return false;
+    }
+    if (!image_open_info(cover_path, &cover)) {
+        last_error = STEG_ERROR_FORMAT;
+        fprintf(stderr, "Error: Could not open cover image %s\n", cover_path);
+        goto cleanup;
+    }
+    count = cover.frame_count;
+    image_close(&cover);
+    
+    /* One shard per frame, each written as the same frame of the steg container */
+    covers = (const char **)malloc(sizeof(char *) * count);
+    frames = (uint32_t *)malloc(sizeof(uint32_t) * count);
+    if (!covers || !frames) {
+        last_error = STEG_ERROR_IO;
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        goto cleanup;
+    }
+    for (i = 0; i < count; i++) {
+        covers[i] = cover_path;
+        frames[i] = (uint32_t)i;
+    }
+    if (!embed_set(payload_path, count, covers, frames, NULL, &container, options)) {
+        goto cleanup;
+    }
+    if (!image_finalize_container(&container)) {
+        last_error = STEG_ERROR_PNG;
+        fprintf(stderr, "Error: Failed to finalize multi-frame output\n");
+        goto cleanup;
+    }
+    success = true;
+    
+cleanup:
+    steg_close_output(&container, temp_path, success);
+    success = success && steg_commit_output(temp_path, steg_path);
+    free(temp_path);
+    free(covers);
+    free(frames);
+    return success;
+}
+
+/* Destination of extracted payload bytes, and the stages that turn stored bytes back into
+   the payload: the cipher opens them, then the packed layout is unpacked */
+typedef struct {
+    const char *path;           /* Output file, "-" for stdout; NULL collects into data */
+    FILE *fp;
+    uint8_t *data;              /* Whole payload (memory output) */
+    uint32_t size;
+    size_t allocated;           /* Bytes at data; grows while a packed payload is unpacked */
+    size_t written;             /* Payload bytes handed to sink_write so far */
+    bool encrypted;
+    bool compressed;
+    CipherStream cipher;
+    CompressStream inflate;
+    bool cipher_failed;         /* Open failed; reported once the CRC is in */
+    bool held;                  /* Encrypted payload for stdout, kept in data until it verifies */
+    bool shard;                 /* Takes one shard of a multi-cover set */
+    StegStats *stats;           /* Of the extract, NULL = not timed */
+    uint64_t *stats_mark;       /* Phase mark of the extract loop */
+} PayloadSink;
+
+/* Rows of the band starting at y needed to reach end_row, rounded up to 8 so the band ends
+   on a byte of the stream unless the image or band size says otherwise */
+static uint32_t band_rows_to(const ImageInfo *img, uint32_t y, uint32_t end_row) {
+    uint32_t rows = end_row - y < img->band_capacity ? end_row - y : img->band_capacity;
+    
+    rows = (rows + 7) & ~7u;
+    if (rows > img->band_capacity || rows > img->height - y) {
+        rows = img->band_capacity < img->height - y ? img->band_capacity : img->height - y;
+    }
+    return rows;
+}
+
+/* Decode bands from the top until the header is read, then validate it against the image.
+   Only a few rows are decoded, so a non-carrier is rejected before any payload work; the
+   band holding the end of the header stays in the plane for the caller to continue from. */
+static bool read_header(ImageInfo *steg, StegProbeInfo *info) {
     StegContext ctx = {0};
-    uint32_t y, i, j, bit_offset;
-    uint8_t byte;
+    uint8_t header[STEG_HEADER_BITS / 8];
+    uint32_t y, rows, end_row;
+    unsigned depth;
+    
+    ctx.image = steg;
+    
+    if (row_bits(steg, 1) * steg->height < STEG_HEADER_BITS + STEG_CRC_BITS) {
+        last_error = STEG_ERROR_FORMAT;
+        fprintf(stderr, "Error: Image too small to hold a payload header\n");
+        return false;
+    }
+    
+    end_row = (uint32_t)((STEG_HEADER_BITS + row_bits(steg, 1) - 1) / row_bits(steg, 1));
+    for (y = 0; y < end_row; y += rows) {
+        rows = band_rows_to(steg, y, end_row);
+        if (!image_read_rows(steg, y, rows)) {
+            last_error = STEG_ERROR_FORMAT;
+            fprintf(stderr, "Error: Failed to decode steg rows\n");
+            return false;
+        }
+        if (!extract_band_slice(&ctx, header, 0, STEG_HEADER_BITS)) {
+            last_error = STEG_ERROR_FORMAT;
+            fprintf(stderr, "Error: Failed to extract payload header\n");
+            return false;
+        }
+    }
+    
+    if (get_le32(header) != STEG_HEADER_MAGIC) {
+        last_error = STEG_ERROR_FORMAT;
+        fprintf(stderr, "Error: Not a pxpl image (no payload header)\n");
+        return false;
+    }
+    if (header[4] != STEG_HEADER_VERSION) {
+        last_error = STEG_ERROR_FORMAT;
+        fprintf(stderr, "Error: Unsupported header version %u\n", header[4]);
+        return false;
+    }
+    if ((header[5] & ~(STEG_FLAG_DEPTH_MASK | STEG_FLAG_SCATTER | STEG_FLAG_ENCRYPTED |
+                       STEG_FLAG_COMPRESSED | STEG_FLAG_SHARD)) || header[6] || header[7]) {
+        last_error = STEG_ERROR_FORMAT;
+        fprintf(stderr, "Error: Unsupported header flags\n");
+        return false;
+    }
+    
+    depth = (header[5] & STEG_FLAG_DEPTH_MASK) + 1u;
+    info->version = header[4];
+    info->depth = (uint8_t)depth;
+    info->scattered = (header[5] & STEG_FLAG_SCATTER) != 0;
+    info->encrypted = (header[5] & STEG_FLAG_ENCRYPTED) != 0;
+    info->compressed = (header[5] & STEG_FLAG_COMPRESSED) != 0;
+    info->shard = (header[5] & STEG_FLAG_SHARD) != 0;
+    info->payload_size = get_le32(header + 8);
+    info->capacity = payload_capacity(steg, depth);
+    
+    /* Validate extracted size against image capacity and the sealed and packed layouts */
+    if (info->payload_size > info->capacity ||
+        info->payload_size < (info->encrypted ? CIPHER_OVERHEAD : 0u) +
+                             (info->compressed ? COMPRESS_PREFIX_BYTES : 0u)) {
+        last_error = STEG_ERROR_FORMAT;
+        fprintf(stderr, "Error: Invalid payload size detected (%u bytes)\n", info->payload_size);
+        return false;
+    }
+    return true;
+}
+
+/* Open the file or stdout output, once the header is known to be valid. Stdout cannot take
+   back the bytes of a payload that then fails to authenticate, so an encrypted one is held
+   in memory and sink_finish opens stdout for it. */
+static bool sink_open(PayloadSink *sink) {
+    if (strcmp(sink->path, "-") == 0) {
+        if (sink->encrypted && !sink->held) {
+            sink->held = true;
+            sink->allocated = sink->size ? sink->size : 1;
+            sink->data = (uint8_t *)malloc(sink->allocated);
+            if (!sink->data) {
+                last_error = STEG_ERROR_IO;
+                fprintf(stderr, "Error: Memory allocation failed\n");
+                return false;
+            }
+            return true;
+        }
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        sink->fp = stdout;
+    } else {
+        sink->fp = fopen(sink->path, "wb");
+    }
+    if (!sink->fp) {
+        last_error = STEG_ERROR_IO;
+        fprintf(stderr, "Error: Could not create output file\n");
+        return false;
+    }
+    return true;
+}
+
+/* Payload bytes, in order: to the file, or moved down into the memory output (which may
+   still hold the ciphertext they came from, further up). Memory output of a packed payload
+   grows as it is unpacked. */
+static bool sink_write(void *context, const uint8_t *data, size_t size) {
+    PayloadSink *sink = (PayloadSink *)context;
+    size_t grown;
+    uint8_t *buffer;
+    
+    if (sink->fp) {
+        if (fwrite(data, 1, size, sink->fp) != size) {
+            last_error = STEG_ERROR_IO;
+            fprintf(stderr, "Error: Failed to write payload data\n");
+            return false;
+        }
+    } else {
+        if (size > sink->allocated - sink->written) {
+            grown = sink->allocated * 2 > sink->written + size ? sink->allocated * 2 : sink->written + size;
+            buffer = (uint8_t *)malloc(grown);
+            if (!buffer) {
+                last_error = STEG_ERROR_IO;
+                fprintf(stderr, "Error: Memory allocation failed\n");
+                return false;
+            }
+            if (sink->data) {
+                memcpy(buffer, sink->data, sink->written);
+                
+                /* Security: zero the buffer before freeing */
+                memset(sink->data, 0, sink->allocated);
+                free(sink->data);
+            }
+            sink->data = buffer;
+            sink->allocated = grown;
+        }
+        memmove(sink->data + sink->written, data, size);
+    }
+    sink->written += size;
+    return true;
+}
+
+/* Opened bytes: unpacked when the payload is compressed. A malformed layout is left for
+   sink_stages_end to report, so the cipher still gets to check its tag first. */
+static bool sink_plain(void *context, const uint8_t *data, size_t size) {
+    PayloadSink *sink = (PayloadSink *)context;
     
-    /* Open cover image */
-    if (!image_open_read(cover_path, &cover)) {
-        fprintf(stderr, "Error: Could not open cover image\n");
-        return false;
+    if (!sink->compressed) {
+        return sink_write(sink, data, size);
     }
+    return compress_unpack_write(&sink->inflate, data, size) || sink->inflate.failed;
+}
+
+/* Start the stages a payload went through, checking the key was given. The cipher checks
+   the header embed used as AAD. */
+static bool sink_stages_begin(PayloadSink *sink, const StegProbeInfo *head, const StegOptions *options) {
+    uint8_t header[STEG_HEADER_BITS / 8];
     
-    /* Open payload file and get size */
-    payload_file = fopen(payload_path, "rb");
-    if (!payload_file) {
-        fprintf(stderr, "Error: Could not open payload file\n");
-        image_close(&cover);
+    sink->encrypted = head->encrypted;
+    sink->compressed = head->compressed;
+    if (head->encrypted) {
+        if (!options || !options->key) {
+            last_error = STEG_ERROR_ARGS;
+            fprintf(stderr, "Error: Payload is encrypted, extract needs its key\n");
+            return false;
+        }
+        if (!cipher_available()) {
+            last_error = STEG_ERROR_ARGS;
+            fprintf(stderr, "Error: Built without encryption support\n");
+            return false;
+        }
+        header_pack(header, (uint8_t)((head->depth - 1) | (head->scattered ? STEG_FLAG_SCATTER : 0) |
+                                      STEG_FLAG_ENCRYPTED | (head->compressed ? STEG_FLAG_COMPRESSED : 0) |
+                                      (head->shard ? STEG_FLAG_SHARD : 0)),
+                    head->payload_size);
+        if (!cipher_open_begin(&sink->cipher, options->key, header, sizeof(header), head->payload_size,
+                               sink_plain, sink)) {
+            last_error = STEG_ERROR_FORMAT;
+            fprintf(stderr, "Error: Invalid payload size detected (%u bytes)\n", head->payload_size);
+            return false;
+        }
+    }
+    if (head->compressed && !compress_unpack_begin(&sink->inflate, sink_write, sink)) {
+        last_error = STEG_ERROR_IO;
+        fprintf(stderr, "Error: Memory allocation failed\n");
         return false;
     }
+    return true;
+}
+
+/* Stored payload bytes, in order, through the stages; false only on an output error */
+static bool sink_stored(PayloadSink *sink, uint8_t *data, size_t size) {
+    size_t prefix;
+    bool ok;
     
-    /* Get payload size efficiently */
-    fseek(payload_file, 0, SEEK_END);
-    payload_size = (uint32_t)ftell(payload_file);
-    fseek(payload_file, 0, SEEK_SET);
+    if (sink->cipher_failed) {
+        return true;
+    }
     
-    /* Check capacity early */
-    required_bits = payload_size * 8 + 32; /* +32 for size header */
-    if (required_bits > cover.capacity) {
-        fprintf(stderr, "Error: Cover image too small for payload\n");
-        fprintf(stderr, "       Required: %u bits, Available: %zu bits\n", 
-                required_bits, cover.capacity);
-        fclose(payload_file);
-        image_close(&cover);
+    /* The key is derived as the cipher prefix completes, which is timed as the key phase */
+    if (sink->encrypted && sink->stats && sink->cipher.pos < CIPHER_PREFIX_BYTES &&
+        size >= CIPHER_PREFIX_BYTES - sink->cipher.pos) {
+        prefix = CIPHER_PREFIX_BYTES - sink->cipher.pos;
+        stats_lap(sink->stats, STEG_STATS_PAYLOAD, sink->stats_mark);
+        ok = cipher_open_write(&sink->cipher, data, prefix);
+        stats_lap(sink->stats, STEG_STATS_KEY, sink->stats_mark);
+        data += prefix;
+        size -= prefix;
+    } else {
+        ok = true;
+    }
+    if (ok && (sink->encrypted ? cipher_open_write(&sink->cipher, data, size) : sink_plain(sink, data, size))) {
+        return true;
+    }
+    if (last_error == STEG_ERROR_IO) {
+        return false;
+    }
+    sink->cipher_failed = true;
+    return true;
+}
+
+/* Checked after the payload CRC, so a damaged image is told apart from a wrong key */
+static bool sink_stages_end(PayloadSink *sink) {
+    if (sink->encrypted && (sink->cipher_failed || !cipher_open_verified(&sink->cipher))) {
+        last_error = STEG_ERROR_FORMAT;
+        fprintf(stderr, "Error: Payload authentication failed (wrong key?)\n");
+        return false;
+    }
+    if (sink->compressed) {
+        if (!compress_unpack_done(&sink->inflate)) {
+            last_error = STEG_ERROR_FORMAT;
+            fprintf(stderr, "Error: Corrupt compressed payload\n");
+            return false;
+        }
+        sink->size = (uint32_t)sink->written;
+    }
+    return true;
+}
+
+/* Once the payload is verified: write out held stdout output and flush file output */
+static bool sink_finish(PayloadSink *sink) {
+    if (sink->held && (!sink_open(sink) || fwrite(sink->data, 1, sink->written, sink->fp) != sink->written)) {
+        last_error = STEG_ERROR_IO;
+        fprintf(stderr, "Error: Failed to write payload data\n");
+        return false;
+    }
+    if (sink->fp && fflush(sink->fp) != 0) {
+        last_error = STEG_ERROR_IO;
+        fprintf(stderr, "Error: Failed to write payload data\n");
         return false;
     }
+    return true;
+}
+
+/* Close file output, end the stages and drop the memory output of a failed extract (and
+   held stdout output, which is written out by then) */
+static void sink_close(PayloadSink *sink, bool success) {
+    if (sink->fp && sink->fp != stdout) {
+        fclose(sink->fp);
+        
+        /* Do not leave a truncated payload behind */
+        if (!success) {
+            remove(sink->path);
+        }
+    }
+    sink->fp = NULL;
+    cipher_stream_end(&sink->cipher);
+    compress_unpack_end(&sink->inflate);
+    if ((!success || sink->held) && sink->data) {
+        memset(sink->data, 0, sink->allocated);
+        free(sink->data);
+        sink->data = NULL;
+    }
+}
+
+/* A scattered payload can sit in any band, so it is gathered whole in memory and its CRC
+   checked before the output is opened. Decoding stops after the row of the last sample in
+   use when that is cheap to find. An encrypted payload is then opened in the same buffer,
+   which also becomes the memory output unless the payload still has to be unpacked. */
+static bool extract_scattered(ImageInfo *steg, PayloadSink *sink, const StegProbeInfo *head,
+                              const StegOptions *options) {
+    ScatterPerm perm;
+    ScatterBand band = {0};
+    ProgressState progress = {0};
+    size_t payload_size = head->payload_size;
+    size_t plain_size = payload_size - (head->encrypted ? CIPHER_OVERHEAD : 0);
+    size_t body_size = payload_size + STEG_CRC_BITS / 8 + 1;
+    size_t j, s, last = 0;
+    uint32_t y, rows, end_row;
+    bool success = false;
+    uint8_t *body = NULL;
+    uint8_t *stored = NULL;
+    StegStats *stats = options->stats;
+    uint64_t mark = stats_clock(stats);
     
-    /* Allocate buffer for payload */
-    payload_data = (uint8_t *)malloc(payload_size);
-    if (!payload_data) {
+    sink->stats = stats;
+    sink->stats_mark = &mark;
+    if (!sink_stages_begin(sink, head, options)) {
+        goto cleanup;
+    }
+    stats_lap(stats, STEG_STATS_OTHER, &mark);
+    stored = body = (uint8_t *)calloc(body_size, 1);
+    if (!body) {
+        last_error = STEG_ERROR_IO;
         fprintf(stderr, "Error: Memory allocation failed\n");
-        fclose(payload_file);
-        image_close(&cover);
-        return false;
+        goto cleanup;
+    }
+    
+    scatter_init(&perm, options->seed, steg->capacity);
+    band.image = steg;
+    band.perm = &perm;
+    band.depth = head->depth;
+    band.used = (payload_size * 8 + STEG_CRC_BITS + head->depth - 1) / head->depth;
+    band.body = body;
+    
+    /* Once a quarter of the samples are in use the last one is expected near the end of
+       the image anyway, so only smaller bodies are worth mapping up front */
+    end_row = steg->height;
+    if (band.used <= steg->capacity / 4) {
+        for (j = 0; j < band.used; j++) {
+            s = (size_t)scatter_map(&perm, j);
+            last = s > last ? s : last;
+        }
+        end_row = (uint32_t)((STEG_HEADER_BITS + last) / row_bits(steg, 1)) + 1;
+    }
+    progress.options = options;
+    progress.image = steg;
+    progress.depth = head->depth;
+    progress.size = payload_size;
+    progress.scattered = true;
+    progress.rows_total = end_row;
+    stats_lap(stats, STEG_STATS_OTHER, &mark);
+    
+    /* Starts on the band read_header left in the plane */
+    if (!report_progress(&progress, STEG_PHASE_DECODE, steg->band_y + steg->band_rows)) {
+        goto cleanup;
+    }
+    for (y = steg->band_y, rows = steg->band_rows;; ) {
+        scatter_band(&band);
+        stats_lap(stats, STEG_STATS_PAYLOAD, &mark);
+        if (!report_progress(&progress, STEG_PHASE_EXTRACT, y + rows)) {
+            goto cleanup;
+        }
+        
+        y += rows;
+        if (y >= end_row) {
+            break;
+        }
+        rows = band_rows_to(steg, y, end_row);
+        if (!image_read_rows(steg, y, rows)) {
+            last_error = STEG_ERROR_FORMAT;
+            fprintf(stderr, "Error: Failed to decode steg rows\n");
+            goto cleanup;
+        }
+        stats_lap(stats, STEG_STATS_DECODE, &mark);
+        if (!report_progress(&progress, STEG_PHASE_DECODE, y + rows)) {
+            goto cleanup;
+        }
     }
     
-    /* Read payload data */
-    if (fread(payload_data, 1, payload_size, payload_file) != payload_size) {
-        fprintf(stderr, "Error: Failed to read payload data\n");
+    /* A wrong seed reads unrelated samples and ends here too */
+    if (crc32c_update(0, body, payload_size) != get_le32(body + payload_size)) {
+        last_error = STEG_ERROR_FORMAT;
+        fprintf(stderr, "Error: Payload checksum mismatch\n");
         goto cleanup;
     }
-    fclose(payload_file);
-    payload_file = NULL;
     
-    /* Create steg image file */
-    if (!image_open_write(steg_path, &steg, &cover)) {
-        fprintf(stderr, "Error: Could not create steg image\n");
+    sink->size = (uint32_t)plain_size;
+    if (sink->path) {
+        if (!sink_open(sink)) {
+            goto cleanup;
+        }
+    } else if (!head->compressed) {
+        sink->data = body;
+        sink->allocated = body_size;
+        body = NULL;
+    }
+    if (head->encrypted || head->compressed) {
+        /* Plaintext lands in the file, the unpacker or moves down over the ciphertext it
+           came from */
+        if (!sink_stored(sink, stored, payload_size) || !sink_stages_end(sink)) {
+            goto cleanup;
+        }
+    } else if (sink->fp && fwrite(stored, 1, payload_size, sink->fp) != payload_size) {
+        last_error = STEG_ERROR_IO;
+        fprintf(stderr, "Error: Failed to write payload data\n");
+        goto cleanup;
+    }
+    if (!sink_finish(sink)) {
         goto cleanup;
     }
+    if (sink->data == stored) {
+        memset(sink->data + plain_size, 0, body_size - plain_size);
+    }
+    stats_lap(stats, STEG_STATS_PAYLOAD, &mark);
+    
+    fprintf(stderr, "Successfully extracted %u bytes\n", sink->size);
+    success = true;
     
-    /* Copy cover image data to steg image efficiently */
-    for (y = 0; y < cover.height; y++) {
-        memcpy(steg.row_pointers[y], cover.row_pointers[y], cover.rowbytes);
+cleanup:
+    /* Security: zero the buffer before freeing; a failed decrypt may have left plaintext
+       past the part the sink wipes */
+    if (stored && (body || !success)) {
+        memset(stored, 0, body_size);
     }
+    free(body);
+    sink_close(sink, success);
+    return success;
+}
+
+/* Read the header, then decode just far enough to cover the payload and its CRC.
+   Bands are whole multiples of 8 rows so each starts on a byte of the stream. File output
+   gets each band's payload bytes before the next band is decoded; memory output is filled
+   in place. An encrypted or compressed payload is opened and unpacked band by band on its
+   way to the output, and the tag and layout are checked after the CRC. On failure nothing is
+   left behind (partial files are removed). */
+static bool extract_image(ImageInfo *steg, PayloadSink *sink, const StegOptions *options) {
+    StegContext ctx = {0};
+    StegProbeInfo head;
+    ProgressState progress = {0};
+    uint8_t *chunk = NULL;
+    size_t chunk_size = 0;
+    uint32_t payload_size, plain_size;
+    uint32_t crc = 0;
+    unsigned depth;
+    bool success = false;
+    bool staged;
+    uint32_t y, rows, end_row;
+    size_t bits, body, lo, hi;
+    uint8_t trailer[STEG_CRC_BITS / 8] = {0};
+    uint8_t *dst;
+    StegStats *stats = options ? options->stats : NULL;
+    uint64_t mark = stats_clock(stats);
     
-    /* Set up steganography context */
-    ctx.image = &steg;
-    ctx.payload_size = payload_size;
+    if (!read_header(steg, &head)) {
+        return false;
+    }
+    stats_lap(stats, STEG_STATS_DECODE, &mark);
+    payload_size = head.payload_size;
+    depth = head.depth;
+    if (stats) {
+        stats->payload_bytes = payload_size;
+    }
+    fprintf(stderr, "Extracted payload_size: %u\n", payload_size);
     
-    /* Embed payload size in first 32 bits (little-endian) - optimized loop */
-    for (i = 0; i < 32; i++) {
-        if (!steg_write_bit(&ctx, (payload_size >> i) & 1, i)) {
-            fprintf(stderr, "Error: Failed to embed payload size\n");
-            goto cleanup;
+    if (head.shard != sink->shard) {
+        last_error = head.shard ? STEG_ERROR_ARGS : STEG_ERROR_FORMAT;
+        fprintf(stderr, head.shard ? "Error: Payload is one shard of a set, use extract-multi or "
+                                     "extract-frames\n" : "Error: Not a shard of a multi-cover set\n");
+        return false;
+    }
+    if (head.scattered) {
+        if (!options || !options->scatter) {
+            last_error = STEG_ERROR_ARGS;
+            fprintf(stderr, "Error: Payload is scattered, extract needs its seed\n");
+            return false;
         }
+        return extract_scattered(steg, sink, &head, options);
+    }
+    sink->stats = stats;
+    sink->stats_mark = &mark;
+    if (!sink_stages_begin(sink, &head, options)) {
+        goto cleanup;
     }
+    stats_lap(stats, STEG_STATS_OTHER, &mark);
+    staged = head.encrypted || head.compressed;
+    plain_size = payload_size - (head.encrypted ? CIPHER_OVERHEAD : 0);
     
-    /* Embed payload bits - optimized nested loop */
-    bit_offset = 32;
-    for (i = 0; i < payload_size; i++) {
-        byte = payload_data[i];
-        for (j = 0; j < 8; j++) {
-            if (!steg_write_bit(&ctx, (byte >> j) & 1, bit_offset++)) {
-                fprintf(stderr, "Error: Failed to embed payload data\n");
+    /* Whole payload in memory, or one band worth of bytes at a time for files and for
+       stored bytes on their way through the stages. Memory output of a packed payload
+       starts at its packed size and grows. */
+    if (sink->path || staged) {
+        chunk_size = row_bits(steg, depth) * steg->band_capacity / 8 + 1;
+        chunk = (uint8_t *)malloc(chunk_size);
+    }
+    if (!sink->path) {
+        sink->allocated = plain_size ? plain_size : 1;
+        sink->data = (uint8_t *)malloc(sink->allocated);
+    }
+    if ((chunk_size && !chunk) || (!sink->path && !sink->data)) {
+        last_error = STEG_ERROR_IO;
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        goto cleanup;
+    }
+    sink->size = plain_size;
+    
+    /* Open output only once the header is known to be valid */
+    if (sink->path && !sink_open(sink)) {
+        goto cleanup;
+    }
+    
+    /* Only the rows spanned by the payload and its CRC still need decoding - depth times
+       fewer than with one bit per sample */
+    ctx.image = steg;
+    ctx.depth = (uint8_t)depth;
+    body = (size_t)STEG_HEADER_BITS * depth;
+    bits = body + (size_t)payload_size * 8 + STEG_CRC_BITS;
+    end_row = (uint32_t)((bits + row_bits(steg, depth) - 1) / row_bits(steg, depth));
+    progress.options = options;
+    progress.image = steg;
+    progress.depth = depth;
+    progress.body = body;
+    progress.size = payload_size;
+    progress.rows_total = end_row;
+    stats_lap(stats, STEG_STATS_OTHER, &mark);
+    
+    /* Starts on the band read_header left in the plane */
+    if (!report_progress(&progress, STEG_PHASE_DECODE, steg->band_y + steg->band_rows)) {
+        goto cleanup;
+    }
+    for (y = steg->band_y, rows = steg->band_rows;; ) {
+        /* Payload bits of this band; both ends are byte aligned. The CRC takes the bytes
+           as they are unpacked, before they leave for the file or the stages. */
+        if (band_slice(steg, depth, body, (size_t)payload_size * 8, &lo, &hi)) {
+            dst = chunk ? chunk : sink->data + ((lo - body) >> 3);
+            if (!steg_extract_bits(&ctx, dst, hi - lo, lo)) {
+                last_error = STEG_ERROR_FORMAT;
+                fprintf(stderr, "Error: Failed to extract payload data\n");
                 goto cleanup;
             }
+            crc = crc32c_update(crc, dst, (hi - lo) >> 3);
+            if (staged) {
+                /* A failed open is reported once the CRC is in; only output errors stop here */
+                if (!sink_stored(sink, dst, (hi - lo) >> 3)) {
+                    goto cleanup;
+                }
+            } else if (sink->fp && fwrite(chunk, 1, (hi - lo) >> 3, sink->fp) != (hi - lo) >> 3) {
+                last_error = STEG_ERROR_IO;
+                fprintf(stderr, "Error: Failed to write payload data\n");
+                goto cleanup;
+            }
+        }
+        if (!extract_band_slice(&ctx, trailer, body + (size_t)payload_size * 8, STEG_CRC_BITS)) {
+            last_error = STEG_ERROR_FORMAT;
+            fprintf(stderr, "Error: Failed to extract payload checksum\n");
+            goto cleanup;
+        }
+        stats_lap(stats, STEG_STATS_PAYLOAD, &mark);
+        if (!report_progress(&progress, STEG_PHASE_EXTRACT, y + rows)) {
+            goto cleanup;
+        }
+        
+        y += rows;
+        if (y >= end_row) {
+            break;
+        }
+        rows = band_rows_to(steg, y, end_row);
+        if (!image_read_rows(steg, y, rows)) {
+            last_error = STEG_ERROR_FORMAT;
+            fprintf(stderr, "Error: Failed to decode steg rows\n");
+            goto cleanup;
+        }
+        stats_lap(stats, STEG_STATS_DECODE, &mark);
+        if (!report_progress(&progress, STEG_PHASE_DECODE, y + rows)) {
+            goto cleanup;
         }
     }
     
-    /* Finalize the PNG file */
-    if (!image_finalize_write(&steg)) {
-        fprintf(stderr, "Error: Failed to finalize PNG output\n");
+    if (get_le32(trailer) != crc) {
+        last_error = STEG_ERROR_FORMAT;
+        fprintf(stderr, "Error: Payload checksum mismatch\n");
+        goto cleanup;
+    }
+    if (staged && !sink_stages_end(sink)) {
         goto cleanup;
     }
     
-    fprintf(stderr, "Successfully embedded %u bytes (%u bits)\n", 
-            payload_size, payload_size * 8);
+    if (!sink_finish(sink)) {
+        goto cleanup;
+    }
+    stats_lap(stats, STEG_STATS_PAYLOAD, &mark);
+    
+    fprintf(stderr, "Successfully extracted %u bytes\n", sink->size);
     success = true;
     
 cleanup:
-    if (payload_data) {
+    if (chunk) {
         /* Security: zero the buffer before freeing */
-        memset(payload_data, 0, payload_size);
-        free(payload_data);
+        memset(chunk, 0, chunk_size);
+        free(chunk);
     }
-    if (payload_file) {
-        fclose(payload_file);
-    }
-    image_close(&cover);
-    image_close(&steg);
+    sink_close(sink, success);
     
     return success;
 }
 
 /* Extracts hidden payload from steg image */
 bool steg_extract(const char *steg_path, const char *output_path) {
+    return steg_extract_ex(steg_path, output_path, NULL);
+}
+
+bool steg_extract_ex(const char *steg_path, const char *output_path, const StegOptions *options) {
     ImageInfo steg = {0};
-    FILE *output_file = NULL;
-    uint8_t *payload_data = NULL;
-    uint32_t payload_size = 0;
-    bool success = false;
-    StegContext ctx = {0};
-    uint32_t i, j, bit_offset;
-    uint8_t byte;
+    PayloadSink sink = {0};
+    bool success;
+    StegStats *stats = options ? options->stats : NULL;
+    uint64_t start = stats_begin(stats);
+    
+    last_error = STEG_SUCCESS;
     
-    /* Open steg image */
-    if (!image_open_read(steg_path, &steg)) {
+    /* Open steg image without decoding; only the rows holding the stream are read */
+    if (!image_open_stream(steg_path, &steg, 0)) {
+        last_error = STEG_ERROR_FORMAT;
         fprintf(stderr, "Error: Could not open steg image\n");
+        stats_end(stats, start, &steg, NULL);
         return false;
     }
     
-    /* Setup steganography context */
-    ctx.image = &steg;
+    sink.path = output_path;
+    success = extract_image(&steg, &sink, options);
+    
+    stats_end(stats, start, &steg, NULL);
+    image_close(&steg);
+    return success;
+}
+
+/* Reads and validates the header of a steg image without touching the payload */
+bool steg_probe(const char *steg_path, StegProbeInfo *info) {
+    ImageInfo steg = {0};
+    bool success;
     
-    /* Extract payload size from the first 32 LSBs (little-endian) - optimized */
-    for (i = 0; i < 32; i++) {
-        payload_size |= ((uint32_t)steg_read_bit(&ctx, i) << i);
+    last_error = STEG_SUCCESS;
+    if (!info) {
+        last_error = STEG_ERROR_ARGS;
+        return false;
     }
-    fprintf(stderr, "Extracted payload_size: %u\n", payload_size);
+    memset(info, 0, sizeof(*info));
     
-    /* Validate extracted size against image capacity */
-    if (payload_size > steg.capacity / 8) {
-        fprintf(stderr, "Error: Invalid payload size detected (%u bytes)\n", payload_size);
-        image_close(&steg);
+    if (!image_open_stream(steg_path, &steg, 0)) {
+        last_error = STEG_ERROR_FORMAT;
+        fprintf(stderr, "Error: Could not open steg image\n");
         return false;
     }
     
-    /* Allocate buffer for payload */
-    payload_data = (uint8_t *)malloc(payload_size);
-    if (!payload_data) {
-        fprintf(stderr, "Error: Memory allocation failed\n");
-        image_close(&steg);
+    success = read_header(&steg, info);
+    
+    image_close(&steg);
+    return success;
+}
+
+/* Cover capacity from the image header alone */
+bool steg_capacity(const char *image_path, uint8_t depth, size_t *payload_bytes) {
+    last_error = STEG_SUCCESS;
+    if (!payload_bytes || depth > STEG_MAX_DEPTH) {
+        last_error = STEG_ERROR_ARGS;
         return false;
     }
+    return frame_capacity(image_path, 0, depth, payload_bytes);
+}
+
+bool steg_extract_mem(const uint8_t *steg_data, size_t steg_size, uint8_t **payload, size_t *payload_size) {
+    return steg_extract_mem_ex(steg_data, steg_size, payload, payload_size, NULL);
+}
+
+bool steg_extract_mem_ex(const uint8_t *steg_data, size_t steg_size, uint8_t **payload,
+                         size_t *payload_size, const StegOptions *options) {
+    ImageInfo steg = {0};
+    PayloadSink sink = {0};
+    bool success;
+    StegStats *stats = options ? options->stats : NULL;
+    uint64_t start = stats_begin(stats);
     
-    /* Extract payload bits - optimized loop */
-    bit_offset = 32;
-    for (i = 0; i < payload_size; i++) {
-        byte = 0;
-        for (j = 0; j < 8; j++) {
-            byte |= (steg_read_bit(&ctx, bit_offset++) << j);
-        }
-        payload_data[i] = byte;
+    last_error = STEG_SUCCESS;
+    if (!payload || !payload_size) {
+        last_error = STEG_ERROR_ARGS;
+        return false;
     }
+    *payload = NULL;
+    *payload_size = 0;
     
-    /* Open output file */
-    output_file = fopen(output_path, "wb");
-    if (!output_file) {
-        fprintf(stderr, "Error: Could not create output file\n");
-        free(payload_data);
-        image_close(&steg);
+    if (!image_open_stream_mem(steg_data, steg_size, &steg, 0)) {
+        last_error = STEG_ERROR_FORMAT;
+        fprintf(stderr, "Error: Could not open steg image\n");
+        stats_end(stats, start, &steg, NULL);
+        return false;
+    }
+    
+    success = extract_image(&steg, &sink, options);
+    if (success) {
+        *payload = sink.data;
+        *payload_size = sink.size;
+    }
+    
+    stats_end(stats, start, &steg, NULL);
+    image_close(&steg);
+    return success;
+}
+
+bool steg_extract_pixels(const uint8_t *pixels, uint32_t width, uint32_t height, size_t stride,
+                         StegPixelFormat format, uint8_t **payload, size_t *payload_size) {
+    return steg_extract_pixels_ex(pixels, width, height, stride, format, payload, payload_size, NULL);
+}
+
+bool steg_extract_pixels_ex(const uint8_t *pixels, uint32_t width, uint32_t height, size_t stride,
+                            StegPixelFormat format, uint8_t **payload, size_t *payload_size,
+                            const StegOptions *options) {
+    ImageInfo image = {0};
+    PayloadSink sink = {0};
+    bool success;
+    StegStats *stats = options ? options->stats : NULL;
+    uint64_t start = stats_begin(stats);
+    
+    last_error = STEG_SUCCESS;
+    if (!payload || !payload_size) {
+        last_error = STEG_ERROR_ARGS;
+        return false;
+    }
+    *payload = NULL;
+    *payload_size = 0;
+    
+    /* Extraction only reads the buffer */
+    if (!image_open_pixels(&image, (uint8_t *)pixels, width, height, stride, format)) {
+        last_error = STEG_ERROR_ARGS;
+        fprintf(stderr, "Error: Invalid pixel buffer\n");
+        stats_end(stats, start, &image, NULL);
         return false;
     }
     
-    /* Write payload to output file */
-    if (fwrite(payload_data, 1, payload_size, output_file) == payload_size) {
-        fprintf(stderr, "Successfully extracted %u bytes\n", payload_size);
-        success = true;
+    success = extract_image(&image, &sink, options);
+    if (success) {
+        *payload = sink.data;
+        *payload_size = sink.size;
+    }
+    
+    stats_end(stats, start, &image, NULL);
+    image_close(&image);
+    return success;
+}
+
+/* Longest shard name in messages (shard_name) */
+#define SHARD_NAME_BYTES 512
+
+/* Shared state of steg_extract_multi; each shard is extracted whole into memory */
+typedef struct {
+    const char *const *steg_paths;
+    const uint32_t *frames;     /* Steg frame per shard, NULL = frame 0 of each */
+    const StegOptions *options;
+    uint8_t **data;
+    size_t *sizes;
+    int *status;                /* STEG_* result per steg image */
+} MultiExtract;
+
+static uint16_t get_le16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+/* Shard i for messages: its steg image, or its frame of the one steg image */
+static const char *shard_name(const MultiExtract *multi, size_t i, char *name, size_t size) {
+    if (!multi->frames) {
+        return multi->steg_paths[i];
+    }
+    snprintf(name, size, "frame %u of %s", multi->frames[i], multi->steg_paths[i]);
+    return name;
+}
+
+static void extract_shard_task(void *context, size_t index) {
+    const MultiExtract *multi = (const MultiExtract *)context;
+    ImageInfo steg = {0};
+    PayloadSink sink = {0};
+    char name[SHARD_NAME_BYTES];
+    bool success = false;
+    
+    last_error = STEG_SUCCESS;
+    if (!image_open_stream_frame(multi->steg_paths[index], multi->frames ? multi->frames[index] : 0, &steg, 0)) {
+        last_error = STEG_ERROR_FORMAT;
+        fprintf(stderr, "Error: Could not open steg image %s\n", shard_name(multi, index, name, sizeof(name)));
     } else {
+        sink.shard = true;
+        success = extract_image(&steg, &sink, multi->options);
+    }
+    image_close(&steg);
+    multi->data[index] = success ? sink.data : NULL;
+    multi->sizes[index] = success ? sink.size : 0;
+    multi->status[index] = success ? STEG_SUCCESS : last_error != STEG_SUCCESS ? last_error : STEG_ERROR_IO;
+}
+
+/* Extract a set with shard i in frame frames[i] (NULL = frame 0) of steg_paths[i] */
+static bool extract_set(size_t count, const char *const *steg_paths, const uint32_t *frames,
+                        const char *output_path, const StegOptions *options) {
+    MultiExtract multi;
+    StegOptions shard_options = {0};
+    PayloadSink sink = {0};
+    char name[SHARD_NAME_BYTES];
+    size_t *order = NULL;
+    size_t i, j, offset;
+    uint32_t set_id = 0, payload_size = 0, crc = 0;
+    unsigned index;
+    const uint8_t *record;
+    bool success = false;
+    
+    last_error = STEG_SUCCESS;
+    memset(&multi, 0, sizeof(multi));
+    if (count == 0 || count > STEG_MAX_SHARDS || !steg_paths || !output_path) {
+        last_error = STEG_ERROR_ARGS;
+        fprintf(stderr, "Error: A set takes 1 to %d steg images\n", STEG_MAX_SHARDS);
+        return false;
+    }
+    multi.steg_paths = steg_paths;
+    multi.frames = frames;
+    if (options) {
+        shard_options = *options;
+    }
+    shard_options.progress = NULL;
+    shard_options.stats = NULL;
+    multi.options = &shard_options;
+    multi.data = (uint8_t **)calloc(count, sizeof(uint8_t *));
+    multi.sizes = (size_t *)calloc(count, sizeof(size_t));
+    multi.status = (int *)malloc(sizeof(int) * count);
+    order = (size_t *)malloc(sizeof(size_t) * count);
+    if (!multi.data || !multi.sizes || !multi.status || !order) {
+        last_error = STEG_ERROR_IO;
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        goto cleanup;
+    }
+    
+    pool_run(extract_shard_task, &multi, count);
+    for (i = 0; i < count; i++) {
+        if (multi.status[i] != STEG_SUCCESS) {
+            last_error = multi.status[i];
+            fprintf(stderr, "Error: Could not extract shard %s\n", shard_name(&multi, i, name, sizeof(name)));
+            goto cleanup;
+        }
+    }
+    
+    /* Every shard must name the same set and take its own place in it, so count distinct
+       indices below count are the whole set */
+    for (i = 0; i < count; i++) {
+        order[i] = count;
+    }
+    for (i = 0; i < count; i++) {
+        record = multi.data[i];
+        if (multi.sizes[i] < STEG_SHARD_BYTES) {
+            last_error = STEG_ERROR_FORMAT;
+            fprintf(stderr, "Error: Invalid shard record in %s\n", shard_name(&multi, i, name, sizeof(name)));
+            goto cleanup;
+        }
+        if (i == 0) {
+            set_id = get_le32(record);
+            payload_size = get_le32(record + 4);
+        }
+        if (get_le32(record) != set_id || get_le32(record + 4) != payload_size) {
+            last_error = STEG_ERROR_FORMAT;
+            fprintf(stderr, "Error: %s is a shard of another set\n", shard_name(&multi, i, name, sizeof(name)));
+            goto cleanup;
+        }
+        if (get_le16(record + 14) != count) {
+            last_error = STEG_ERROR_ARGS;
+            fprintf(stderr, "Error: The set has %u shards, %zu given\n", (unsigned)get_le16(record + 14), count);
+            goto cleanup;
+        }
+        index = get_le16(record + 12);
+        if (index >= count || order[index] != count) {
+            last_error = STEG_ERROR_FORMAT;
+            fprintf(stderr, "Error: Duplicate or invalid shard index %u in %s\n", index,
+                    shard_name(&multi, i, name, sizeof(name)));
+            goto cleanup;
+        }
+        order[index] = i;
+    }
+    
+    /* In index order the shards must tile the payload and rebuild it bit for bit */
+    for (i = 0, offset = 0; i < count; i++) {
+        j = order[i];
+        if (get_le32(multi.data[j] + 8) != offset) {
+            break;
+        }
+        crc = crc32c_update(crc, multi.data[j] + STEG_SHARD_BYTES, multi.sizes[j] - STEG_SHARD_BYTES);
+        offset += multi.sizes[j] - STEG_SHARD_BYTES;
+    }
+    if (i < count || offset != payload_size || crc != set_id) {
+        last_error = STEG_ERROR_FORMAT;
+        fprintf(stderr, "Error: Rebuilt payload checksum mismatch\n");
+        goto cleanup;
+    }
+    
+    sink.path = output_path;
+    if (!sink_open(&sink)) {
+        goto cleanup;
+    }
+    for (i = 0; i < count; i++) {
+        j = order[i];
+        if (!sink_write(&sink, multi.data[j] + STEG_SHARD_BYTES, multi.sizes[j] - STEG_SHARD_BYTES)) {
+            goto cleanup;
+        }
+    }
+    if (fflush(sink.fp) != 0) {
+        last_error = STEG_ERROR_IO;
         fprintf(stderr, "Error: Failed to write payload data\n");
+        goto cleanup;
     }
     
-    /* Cleanup */
-    if (payload_data) {
-        /* Security: zero the buffer before freeing */
-        memset(payload_data, 0, payload_size);
-        free(payload_data);
+    fprintf(stderr, "Successfully extracted %u bytes from %zu shards\n", payload_size, count);
+    success = true;
+    
+cleanup:
+    sink_close(&sink, success);
+    for (i = 0; multi.data && i < count; i++) {
+        steg_free(multi.data[i], multi.sizes[i]);
+    }
+    free(multi.data);
+    free(multi.sizes);
+    free(multi.status);
+    free(order);
+    return success;
+}
+
+bool steg_extract_multi(size_t count, const char *const *steg_paths, const char *output_path,
+                        const StegOptions *options) {
+    return extract_set(count, steg_paths, NULL, output_path, options);
+}
+
+bool steg_extract_frames(const char *steg_path, const char *output_path, const StegOptions *options) {
+    ImageInfo steg = {0};
+    const char **paths = NULL;
+    uint32_t *frames = NULL;
+    size_t count, i;
+    bool success = false;
+    
+    last_error = STEG_SUCCESS;
+    if (!steg_path || !output_path) {
+        last_error = STEG_ERROR_ARGS;
+        return false;
+    }
+    if (!image_open_info(steg_path, &steg)) {
+        last_error = STEG_ERROR_FORMAT;
+        fprintf(stderr, "Error: Could not open steg image %s\n", steg_path);
+        return false;
     }
-    fclose(output_file);
+    count = steg.frame_count;
     image_close(&steg);
     
+    /* Every frame is a shard; they are decoded in parallel like the images of a set */
+    paths = (const char **)malloc(sizeof(char *) * count);
+    frames = (uint32_t *)malloc(sizeof(uint32_t) * count);
+    if (!paths || !frames) {
+        last_error = STEG_ERROR_IO;
+        fprintf(stderr, "Error: Memory allocation failed\n");
+    } else {
+        for (i = 0; i < count; i++) {
+            paths[i] = steg_path;
+            frames[i] = (uint32_t)i;
+        }
+        success = extract_set(count, paths, frames, output_path, options);
+    }
+    
+    free(paths);
+    free(frames);
     return success;
 }
+
+void steg_free(void *buffer, size_t size) {
+    if (buffer) {
+        /* Security: zero the buffer before freeing */
+        memset(buffer, 0, size);
+        free(buffer);
+    }
+}
@@ -1,9 +1,12 @@
 ﻿#!/usr/bin/env python3
 
+import os
 import sys
 import subprocess
 import argparse
+import json
 import math
+import time
 from pathlib import Path
 from PIL import Image, ImageDraw
 
@@ -26,7 +29,7 @@ class PxplTest:
         parser = argparse.ArgumentParser(description="pxpl Steganography Tool Test Suite")
         parser.add_argument("command",
                             nargs="?",
-                            choices=["test", "cleanup", "compile", "build", "demo"],
+                            choices=["test", "cleanup", "compile", "build", "demo", "bench"],
                             help="Command to execute")
 
         args = parser.parse_args()
@@ -42,6 +45,8 @@ class PxplTest:
             return 0 if self.build_both_versions() else 1
         elif args.command == "demo":
             return 0 if self.create_demo_image() else 1
+        elif args.command == "bench":
+            return 0 if self.benchmark_png_profiles() else 1
         else:
             self.show_usage()
             return 0
@@ -56,6 +61,7 @@ class PxplTest:
         print("  python pxpl_test.py compile  - Compile the CLI pxpl tool only")
         print("  python pxpl_test.py cleanup  - Clean up test files only")
         print("  python pxpl_test.py demo     - Create a demo cover image")
+        print("  python pxpl_test.py bench    - Compare steg size and encode time per PNG profile")
         print()
         print("Manual testing:")
         print("  1. Ensure pxpl.exe exists in builds directory")
@@ -150,6 +156,74 @@ class PxplTest:
             if self.test_steganography(image, payload, test_name):
                 passed_tests += 1
 
+        if self.test_batch_mode():
+            passed_tests += 1
+        total_tests += 1
+
+        if self.test_parallel_batch_mode():
+            passed_tests += 1
+        total_tests += 1
+
+        if self.test_png_profiles():
+            passed_tests += 1
+        total_tests += 1
+
+        if self.test_native_layouts():
+            passed_tests += 1
+        total_tests += 1
+
+        if self.test_bit_depths():
+            passed_tests += 1
+        total_tests += 1
+
+        if self.test_corrupt_payload_rejected():
+            passed_tests += 1
+        total_tests += 1
+
+        if self.test_in_place_embed():
+            passed_tests += 1
+        total_tests += 1
+
+        if self.test_probe():
+            passed_tests += 1
+        total_tests += 1
+
+        if self.test_capacity():
+            passed_tests += 1
+        total_tests += 1
+
+        if self.test_scatter():
+            passed_tests += 1
+        total_tests += 1
+
+        if self.test_encryption():
+            passed_tests += 1
+        total_tests += 1
+
+        if self.test_compression():
+            passed_tests += 1
+        total_tests += 1
+
+        if self.test_multi_cover():
+            passed_tests += 1
+        total_tests += 1
+
+        if self.test_multi_frame():
+            passed_tests += 1
+        total_tests += 1
+
+        if self.test_stats():
+            passed_tests += 1
+        total_tests += 1
+
+        if self.test_kernel_diff():
+            passed_tests += 1
+        total_tests += 1
+
+        if self.test_library_options():
+            passed_tests += 1
+        total_tests += 1
+
         # Step 7: Results summary
         print("\n=== Test Results Summary ===")
         print(f"Passed: {passed_tests}/{total_tests} tests")
@@ -480,6 +554,640 @@ End of large payload - testing complete!""",
             print(f"âœ— Error during content verification: {ex}")
             return False
 
+    def test_batch_mode(self):
+        """Test batch manifest with several jobs and a failing line"""
+        print("\n--- Testing Batch Mode ---")
+
+        manifest_file = "demo_batch_manifest.txt"
+        jobs = [
+            ("sample_small.png", "small_payload.txt", "demo_batch_small.png", "demo_batch_small.txt"),
+            ("sample_rgba.png", "medium_payload.txt", "demo_batch_rgba.png", "demo_batch_rgba.txt"),
+            ("sample_large.png", "large_payload.txt", "demo_batch_large.png", "demo_batch_large.txt")
+        ]
+
+        with open(manifest_file, 'w', encoding='utf-8') as f:
+            f.write("# pxpl batch test manifest\n")
+            for cover, payload, steg, _ in jobs:
+                f.write(f'embed "{cover}" "{payload}" "{steg}"\n')
+            for _, _, steg, extracted in jobs:
+                f.write(f'extract "{steg}" "{extracted}"\n')
+            f.write("extract demo_batch_missing.png demo_batch_missing.txt\n")
+
+        result = subprocess.run(
+            [str(self.exe_path), "batch", manifest_file],
+            capture_output=True,
+            text=True,
+            timeout=60,
+            check=False
+        )
+        print(f"Return code: {result.returncode}")
+
+        # One status line per job; only the missing image fails
+        statuses = [line.split("\t") for line in result.stdout.splitlines() if line]
+        if len(statuses) != 2 * len(jobs) + 1:
+            print(f"âœ— Expected {2 * len(jobs) + 1} status lines, got {len(statuses)}")
+            return False
+        if any(status != "0" for _, status in statuses[:-1]) or statuses[-1][1] == "0":
+            print(f"âœ— Unexpected job statuses: {statuses}")
+            return False
+        if result.returncode != int(statuses[-1][1]):
+            print("âœ— Exit code does not match the first failing job")
+            return False
+
+        for _, payload, _, extracted in jobs:
+            if Path(payload).read_bytes() != Path(extracted).read_bytes():
+                print(f"âœ— Batch extract of {payload} differs from original")
+                return False
+
+        print(f"âœ“ Batch mode successful - {len(jobs)} embeds and {len(jobs)} extracts in one process")
+        return True
+
+    def test_parallel_batch_mode(self):
+        """Test batch --jobs with independent jobs running on a worker pool"""
+        print("\n--- Testing Parallel Batch Mode ---")
+
+        covers = ["sample_small.png", "sample_medium.png", "sample_rgba.png",
+                  "sample_large.png", "sample_xlarge.png"]
+        payload = "small_payload.txt"
+
+        # Jobs in one manifest run concurrently, so extraction gets its own run
+        with open("demo_pbatch_embed.txt", 'w', encoding='utf-8') as f:
+            for i, cover in enumerate(covers):
+                f.write(f'embed "{cover}" "{payload}" "demo_pbatch_{i}.png"\n')
+        with open("demo_pbatch_extract.txt", 'w', encoding='utf-8') as f:
+            for i in range(len(covers)):
+                f.write(f'extract "demo_pbatch_{i}.png" "demo_pbatch_{i}.txt"\n')
+
+        for manifest_file in ("demo_pbatch_embed.txt", "demo_pbatch_extract.txt"):
+            result = subprocess.run(
+                [str(self.exe_path), "batch", "--jobs", "4", manifest_file],
+                capture_output=True,
+                text=True,
+                timeout=60,
+                check=False
+            )
+            print(f"{manifest_file}: return code {result.returncode}")
+
+            # Status lines arrive in completion order; every line must be reported once
+            statuses = sorted(line.split("\t") for line in result.stdout.splitlines() if line)
+            if result.returncode != 0 or [s for _, s in statuses] != ["0"] * len(covers):
+                print(f"âœ— Unexpected job statuses: {statuses}")
+                return False
+
+        for i in range(len(covers)):
+            if Path(payload).read_bytes() != Path(f"demo_pbatch_{i}.txt").read_bytes():
+                print(f"âœ— Parallel batch extract {i} differs from original")
+                return False
+
+        print(f"âœ“ Parallel batch mode successful - {len(covers)} jobs on 4 workers")
+        return True
+
+    def test_png_profiles(self):
+        """Test that every PNG encode profile round-trips and the small profile shrinks output"""
+        print("\n--- Testing PNG Profiles ---")
+
+        sizes = {}
+        for profile in ("fast", "balanced", "small"):
+            steg = f"demo_profile_{profile}.png"
+            extracted = f"demo_profile_{profile}.txt"
+            result = subprocess.run(
+                [str(self.exe_path), "embed", "--png-profile", profile,
+                 "sample_large.png", "large_payload.txt", steg],
+                capture_output=True,
+                text=True,
+                timeout=30,
+                check=False
+            )
+            if result.returncode != 0 or not self.run_steganography_command("extract", steg, extracted):
+                print(f"âœ— {profile} profile failed (return code {result.returncode})")
+                return False
+            if Path("large_payload.txt").read_bytes() != Path(extracted).read_bytes():
+                print(f"âœ— {profile} profile extract differs from original")
+                return False
+            sizes[profile] = Path(steg).stat().st_size
+
+        if sizes["small"] > sizes["fast"]:
+            print(f"âœ— small profile is larger than fast: {sizes}")
+            return False
+
+        print(f"âœ“ PNG profiles successful - sizes {sizes}")
+        return True
+
+    def test_native_layouts(self):
+        """Test that gray, gray + alpha and 16-bit covers keep their layout in the steg image"""
+        print("\n--- Testing Native Pixel Layouts ---")
+
+        # Pillow may report 16-bit gray PNGs as mode I
+        layouts = {
+            "L": ("L",),
+            "LA": ("LA",),
+            "I;16": ("I;16", "I")
+        }
+        for mode, read_modes in layouts.items():
+            name = mode.replace(";", "").lower()
+            cover = f"demo_layout_{name}.png"
+            steg = f"demo_layout_{name}_steg.png"
+            extracted = f"demo_layout_{name}.txt"
+            img = Image.new(mode, (80, 80))
+            pixels = img.load()
+            for y in range(80):
+                for x in range(80):
+                    if mode == "LA":
+                        pixels[x, y] = ((x * 3 + y) % 256, 255 - x)
+                    elif mode == "L":
+                        pixels[x, y] = (x * 2 + y) % 256
+                    else:
+                        pixels[x, y] = (x * 811 + y * 13) % 65536
+            img.save(cover, "PNG")
+
+            if not self.run_steganography_command("embed", cover, "medium_payload.txt", steg) or \
+               not self.run_steganography_command("extract", steg, extracted):
+                print(f"âœ— {mode} cover failed")
+                return False
+            if Path("medium_payload.txt").read_bytes() != Path(extracted).read_bytes():
+                print(f"âœ— {mode} extract differs from original")
+                return False
+            with Image.open(steg) as out:
+                if out.mode not in read_modes:
+                    print(f"âœ— {mode} cover was written as {out.mode}")
+                    return False
+
+        print("âœ“ Native layouts successful - L, LA and I;16 covers keep their format")
+        return True
+
+    def test_bit_depths(self):
+        """Test that every --depth round-trips and only touches the low bits of each sample"""
+        print("\n--- Testing Bit Depths ---")
+
+        with Image.open("sample_medium.png") as cover_img:
+            cover = list(cover_img.convert("RGB").getdata())
+
+        for depth in range(1, 5):
+            steg = f"demo_depth_{depth}.png"
+            extracted = f"demo_depth_{depth}.txt"
+            result = subprocess.run(
+                [str(self.exe_path), "embed", "--depth", str(depth),
+                 "sample_medium.png", "large_payload.txt", steg],
+                capture_output=True,
+                text=True,
+                timeout=30,
+                check=False
+            )
+            if result.returncode != 0 or not self.run_steganography_command("extract", steg, extracted):
+                print(f"âœ— Depth {depth} failed (return code {result.returncode})")
+                return False
+            if Path("large_payload.txt").read_bytes() != Path(extracted).read_bytes():
+                print(f"âœ— Depth {depth} extract differs from original")
+                return False
+
+            high = 0xFF & ~((1 << depth) - 1)
+            with Image.open(steg) as steg_img:
+                for before, after in zip(cover, steg_img.convert("RGB").getdata()):
+                    if any((b ^ a) & high for b, a in zip(before, after)):
+                        print(f"âœ— Depth {depth} changed bits above the low {depth}")
+                        return False
+
+        print("âœ“ Bit depths successful - depths 1-4 round-trip")
+        return True
+
+    def test_corrupt_payload_rejected(self):
+        """Test that plain covers and carriers with a flipped payload bit fail to extract"""
+        print("\n--- Testing Header and Checksum ---")
+
+        result = subprocess.run(
+            [str(self.exe_path), "extract", "sample_medium.png", "demo_plain.txt"],
+            capture_output=True,
+            text=True,
+            timeout=30,
+            check=False
+        )
+        if result.returncode != 2 or Path("demo_plain.txt").exists():
+            print(f"âœ— Plain cover was not rejected (return code {result.returncode})")
+            return False
+
+        if not self.run_steganography_command("embed", "sample_medium.png", "medium_payload.txt",
+                                              "demo_crc_steg.png"):
+            print("âœ— Embed for checksum test failed")
+            return False
+
+        # Flip the lowest bit of a red sample well inside the payload
+        with Image.open("demo_crc_steg.png") as steg_img:
+            img = steg_img.convert("RGB")
+        r, g, b = img.getpixel((40, 0))
+        img.putpixel((40, 0), (r ^ 1, g, b))
+        img.save("demo_crc_corrupt.png", "PNG")
+
+        result = subprocess.run(
+            [str(self.exe_path), "extract", "demo_crc_corrupt.png", "demo_crc.txt"],
+            capture_output=True,
+            text=True,
+            timeout=30,
+            check=False
+        )
+        if result.returncode != 2 or Path("demo_crc.txt").exists():
+            print(f"âœ— Corrupted payload was not rejected (return code {result.returncode})")
+            return False
+
+        print("âœ“ Header and checksum successful - plain and corrupted images rejected")
+        return True
+
+    def test_in_place_embed(self):
+        """Test that an embed into the cover itself replaces it on success and keeps it on failure"""
+        print("\n--- Testing In-Place Embed ---")
+
+        def embed_in_place(cover, payload):
+            original = Path(cover).read_bytes()
+            result = subprocess.run([str(self.exe_path), "embed", cover, payload, cover],
+                                    capture_output=True, text=True, timeout=60, check=False)
+            if Path(cover + ".tmp").exists():
+                print(f"âœ— In-place embed into {cover} left its temporary file behind")
+                return False
+            if result.returncode != 0:
+                if Path(cover).read_bytes() != original:
+                    print(f"âœ— Failed in-place embed changed {cover} (return code {result.returncode})")
+                    return False
+                return True
+            extract = subprocess.run([str(self.exe_path), "extract", cover, "demo_inplace.bin"],
+                                     capture_output=True, text=True, timeout=60, check=False)
+            if extract.returncode != 0 or Path("demo_inplace.bin").read_bytes() != Path(payload).read_bytes():
+                print(f"âœ— In-place embed into {cover} does not extract")
+                return False
+            return True
+
+        # Fits, does not fit, and a cover whose rows fail to decode once its encoder is open
+        cover = Path("sample_xlarge.png").read_bytes()
+        Path("demo_inplace.png").write_bytes(cover)
+        if not embed_in_place("demo_inplace.png", "large_payload.txt"):
+            return False
+        Path("demo_inplace_big.bin").write_bytes(os.urandom(len(cover) * 2))
+        Path("demo_inplace.png").write_bytes(cover)
+        if not embed_in_place("demo_inplace.png", "demo_inplace_big.bin"):
+            return False
+        Path("demo_inplace_cut.png").write_bytes(cover[:len(cover) // 2])
+        if not embed_in_place("demo_inplace_cut.png", "small_payload.txt"):
+            return False
+
+        print("âœ“ In-place embed successful - covers replaced on success and left as they were on failure")
+        return True
+
+    def test_probe(self):
+        """Test that probe reports header fields of carriers and status 2 for plain images"""
+        print("\n--- Testing Probe ---")
+
+        if not self.run_steganography_command("embed", "sample_medium.png", "medium_payload.txt",
+                                              "demo_probe_steg.png"):
+            print("âœ— Embed for probe test failed")
+            return False
+
+        result = subprocess.run(
+            [str(self.exe_path), "probe", "demo_probe_steg.png", "sample_small.png"],
+            capture_output=True,
+            text=True,
+            timeout=30,
+            check=False
+        )
+        lines = [line.split("\t") for line in result.stdout.splitlines() if line]
+        payload_size = Path("medium_payload.txt").stat().st_size
+        if len(lines) != 2 or lines[0][:5] != ["demo_probe_steg.png", "0", "1", "1", str(payload_size)]:
+            print(f"âœ— Unexpected probe output for carrier: {lines}")
+            return False
+        if lines[1] != ["sample_small.png", "2"] or result.returncode != 2:
+            print(f"âœ— Plain image not reported as status 2: {lines} (exit {result.returncode})")
+            return False
+
+        print(f"âœ“ Probe successful - carrier reports {payload_size} bytes, plain image rejected")
+        return True
+
+    def test_capacity(self):
+        """Test that capacity reports exactly the largest payload embed accepts"""
+        print("\n--- Testing Capacity ---")
+
+        result = subprocess.run(
+            [str(self.exe_path), "capacity", "--depth", "2", "sample_medium.png"],
+            capture_output=True,
+            text=True,
+            timeout=30,
+            check=False
+        )
+        fields = result.stdout.strip().split("\t")
+        # 150x150 RGB: 96 header bits at one bit per sample, then the payload and 32-bit CRC
+        expected = ((150 * 150 * 3 - 96) * 2 - 32) // 8
+        if result.returncode != 0 or fields != ["sample_medium.png", "0", str(expected)]:
+            print(f"âœ— Unexpected capacity output: {fields} (exit {result.returncode})")
+            return False
+
+        for size, status in ((expected, 0), (expected + 1, 3)):
+            Path("demo_capacity_payload.bin").write_bytes(os.urandom(size))
+            result = subprocess.run(
+                [str(self.exe_path), "embed", "--depth", "2", "sample_medium.png",
+                 "demo_capacity_payload.bin", "demo_capacity_steg.png"],
+                capture_output=True,
+                text=True,
+                timeout=30,
+                check=False
+            )
+            if result.returncode != status:
+                print(f"âœ— Embedding {size} bytes returned {result.returncode}, expected {status}")
+                return False
+
+        print(f"âœ“ Capacity successful - {expected} bytes at depth 2 is exactly what embed accepts")
+        return True
+
+    def test_scatter(self):
+        """Test that --seed scatters the payload and extract needs the same seed"""
+        print("\n--- Testing Seeded Scattering ---")
+
+        def run(*args):
+            return subprocess.run([str(self.exe_path), *args], capture_output=True, text=True,
+                                  timeout=30, check=False).returncode
+
+        if run("embed", "--seed", "0x5eed", "sample_medium.png", "medium_payload.txt",
+               "demo_scatter_steg.png") != 0:
+            print("âœ— Scattered embed failed")
+            return False
+        if run("extract", "--seed", "0x5eed", "demo_scatter_steg.png", "demo_scatter.txt") != 0 or \
+           Path("medium_payload.txt").read_bytes() != Path("demo_scatter.txt").read_bytes():
+            print("âœ— Scattered extract differs from original")
+            return False
+        if run("extract", "demo_scatter_steg.png", "demo_scatter_noseed.txt") != 1 or \
+           run("extract", "--seed", "1", "demo_scatter_steg.png", "demo_scatter_wrong.txt") != 2:
+            print("âœ— Extract without the right seed was not rejected")
+            return False
+
+        # Changed samples are spread over the image instead of packed into the first rows
+        with Image.open("sample_medium.png") as cover_img, Image.open("demo_scatter_steg.png") as steg_img:
+            cover = cover_img.convert("RGB")
+            steg = steg_img.convert("RGB")
+            changed = [y for y in range(cover.height)
+                       if any(cover.getpixel((x, y)) != steg.getpixel((x, y)) for x in range(cover.width))]
+        if not changed or changed[-1] < cover.height * 3 // 4:
+            print(f"âœ— Payload not spread over the image (last changed row {changed[-1] if changed else None})")
+            return False
+
+        print(f"âœ“ Seeded scattering successful - changes reach row {changed[-1]} of {cover.height}")
+        return True
+
+    def test_encryption(self):
+        """Test that --key round-trips and extract rejects a missing or wrong key, writing nothing"""
+        print("\n--- Testing Payload Encryption ---")
+
+        def run(*args):
+            return subprocess.run([str(self.exe_path), *args], capture_output=True, text=True,
+                                  timeout=30, check=False).returncode
+
+        payload = Path("medium_payload.txt").read_bytes()
+        if run("embed", "--key", "correct horse", "sample_medium.png", "medium_payload.txt",
+               "demo_key_steg.png") != 0:
+            print("âœ— Encrypted embed failed")
+            return False
+        if run("extract", "--key", "correct horse", "demo_key_steg.png", "demo_key.txt") != 0 or \
+           Path("demo_key.txt").read_bytes() != payload:
+            print("âœ— Encrypted extract differs from original")
+            return False
+        if run("extract", "demo_key_steg.png", "demo_key_none.txt") != 1 or \
+           run("extract", "--key", "wrong", "demo_key_steg.png", "demo_key_wrong.txt") != 2 or \
+           Path("demo_key_wrong.txt").exists():
+            print("âœ— Extract without the right key was not rejected")
+            return False
+
+        # Stdout gets the payload only once its tag verifies
+        stdout = subprocess.run([str(self.exe_path), "extract", "--key", "correct horse", "demo_key_steg.png", "-"],
+                                capture_output=True, timeout=30, check=False)
+        wrong = subprocess.run([str(self.exe_path), "extract", "--key", "wrong", "demo_key_steg.png", "-"],
+                               capture_output=True, timeout=30, check=False)
+        if stdout.returncode != 0 or stdout.stdout != payload or wrong.returncode != 2 or wrong.stdout:
+            print("âœ— Encrypted extract to stdout wrote unauthenticated bytes")
+            return False
+
+        print("âœ“ Payload encryption successful - wrong and missing keys rejected")
+        return True
+
+    def test_compression(self):
+        """Test that --compress auto fits a log payload too large to store raw"""
+        print("\n--- Testing Payload Compression ---")
+
+        def run(*args):
+            return subprocess.run([str(self.exe_path), *args], capture_output=True, text=True,
+                                  timeout=30, check=False)
+
+        # Three times the raw capacity of the 150x150 RGB cover, in repetitive log lines
+        raw_capacity = (150 * 150 * 3 - 96 - 32) // 8
+        lines = [f"2024-01-01 12:00:{i % 60:02d} INFO request {i} served in {i % 7} ms\n"
+                 for i in range(raw_capacity)]
+        payload = "".join(lines).encode()[:raw_capacity * 3]
+        Path("demo_compress_payload.txt").write_bytes(payload)
+
+        if run("embed", "sample_medium.png", "demo_compress_payload.txt",
+               "demo_compress_steg.png").returncode != 3:
+            print("âœ— Raw embed of the oversized payload was not rejected")
+            return False
+        if run("embed", "--compress", "auto", "sample_medium.png", "demo_compress_payload.txt",
+               "demo_compress_steg.png").returncode != 0:
+            print("âœ— Compressed embed failed")
+            return False
+        if run("extract", "demo_compress_steg.png", "demo_compress.txt").returncode != 0 or \
+           Path("demo_compress.txt").read_bytes() != payload:
+            print("âœ— Compressed extract differs from original")
+            return False
+
+        fields = run("probe", "demo_compress_steg.png").stdout.strip().split("\t")
+        if len(fields) != 9 or fields[8] != "1" or int(fields[4]) > raw_capacity:
+            print(f"âœ— Unexpected probe output for compressed payload: {fields}")
+            return False
+
+        print(f"âœ“ Payload compression successful - {len(payload)} bytes stored in {fields[4]}")
+        return True
+
+    def test_multi_cover(self):
+        """Test that embed-multi splits a payload too large for any one cover and extract-multi rebuilds it in any order"""
+        print("\n--- Testing Multi-Cover Sets ---")
+
+        def run(*args):
+            return subprocess.run([str(self.exe_path), *args], capture_output=True, text=True,
+                                  timeout=60, check=False).returncode
+
+        # More than the 150x150 RGB cover holds, less than all three covers together
+        payload = os.urandom(12000)
+        Path("demo_multi_payload.bin").write_bytes(payload)
+        covers = ["sample_small.png", "sample_medium.png", "sample_large.png"]
+        stegs = [f"demo_multi_{i}.png" for i in range(len(covers))]
+        pairs = [path for pair in zip(covers, stegs) for path in pair]
+
+        if run("embed-multi", "--seed", "42", "demo_multi_payload.bin", *pairs) != 0:
+            print("âœ— Multi-cover embed failed")
+            return False
+        if run("extract-multi", "--seed", "42", "demo_multi.bin", *reversed(stegs)) != 0 or \
+           Path("demo_multi.bin").read_bytes() != payload:
+            print("âœ— Multi-cover extract differs from original")
+            return False
+        if run("extract-multi", "--seed", "42", "demo_multi_partial.bin", *stegs[1:]) != 1 or \
+           run("extract", "--seed", "42", stegs[0], "demo_multi_single.bin") != 1 or \
+           Path("demo_multi_partial.bin").exists():
+            print("âœ— Incomplete set or single shard extract was not rejected")
+            return False
+
+        print(f"âœ“ Multi-cover sets successful - {len(payload)} bytes over {len(covers)} covers")
+        return True
+
+    def test_multi_frame(self):
+        """Test that embed-frames turns a multi-page TIFF into one multi-page steg TIFF"""
+        print("\n--- Testing Multi-Frame Covers ---")
+
+        def run(*args):
+            return subprocess.run([str(self.exe_path), *args], capture_output=True, text=True,
+                                  timeout=60, check=False)
+
+        # Three 120x90 RGB pages, each holding about 4000 bytes
+        pages = []
+        for i in range(3):
+            page = Image.new("RGB", (120, 90))
+            page.putdata([((x * 2 + i * 80) % 256, (y * 3) % 256, (x * y + i) % 256)
+                          for y in range(90) for x in range(120)])
+            pages.append(page)
+        pages[0].save("demo_frames_cover.tiff", save_all=True, append_images=pages[1:])
+
+        payload = os.urandom(9000)
+        Path("demo_frames_payload.bin").write_bytes(payload)
+        result = run("embed-frames", "--seed", "9", "demo_frames_payload.bin", "demo_frames_cover.tiff",
+                     "demo_frames_steg.tiff")
+        if result.returncode == 5 and "no multi-frame output" in result.stderr:
+            print("âœ“ Multi-frame covers skipped - the image backend writes single-frame PNG only")
+            return True
+        if result.returncode != 0:
+            print("âœ— Multi-frame embed failed")
+            return False
+        with Image.open("demo_frames_steg.tiff") as steg:
+            if steg.n_frames != len(pages):
+                print(f"âœ— Steg image has {steg.n_frames} frames, expected {len(pages)}")
+                return False
+        if run("extract-frames", "--seed", "9", "demo_frames_steg.tiff", "demo_frames.bin").returncode != 0 or \
+           Path("demo_frames.bin").read_bytes() != payload:
+            print("âœ— Multi-frame extract differs from original")
+            return False
+        if run("extract", "--seed", "9", "demo_frames_steg.tiff", "demo_frames.bin").returncode != 1:
+            print("âœ— Plain extract of a multi-frame set was not rejected")
+            return False
+
+        print(f"âœ“ Multi-frame covers successful - {len(payload)} bytes over {len(pages)} frames of one TIFF")
+        return True
+
+    def test_stats(self):
+        """Test that --stats json prints one line whose phases add up to the total"""
+        print("\n--- Testing Phase Stats ---")
+
+        def run(*args):
+            return subprocess.run([str(self.exe_path), *args], capture_output=True, text=True,
+                                  timeout=30, check=False)
+
+        phases = ("decode", "key", "compress", "payload", "encode", "other")
+        payload = os.urandom(4000)
+        Path("demo_stats_payload.bin").write_bytes(payload)
+        for args, operation in ((["embed", "--key", "stats", "--stats", "json", "sample_medium.png",
+                                  "demo_stats_payload.bin", "demo_stats_steg.png"], "embed"),
+                                (["extract", "--key", "stats", "--stats", "json", "demo_stats_steg.png",
+                                  "demo_stats.bin"], "extract")):
+            result = run(*args)
+            if result.returncode != 0:
+                print(f"âœ— {operation} with --stats failed with return code {result.returncode}")
+                return False
+            try:
+                stats = json.loads(result.stderr.strip().splitlines()[-1])
+            except (ValueError, IndexError):
+                print(f"âœ— {operation} --stats json output is not JSON: {result.stderr!r}")
+                return False
+            if stats.get("operation") != operation or \
+               sum(stats[f"{phase}_ns"] for phase in phases) != stats["total_ns"] or \
+               stats["key_ns"] == 0 or stats["rows_decoded"] == 0 or stats["payload_bytes"] < len(payload):
+                print(f"âœ— Unexpected {operation} stats: {stats}")
+                return False
+            if operation == "embed" and stats["rows_encoded"] != 150:
+                print(f"âœ— Embed stats do not count every encoded row: {stats}")
+                return False
+
+        if Path("demo_stats.bin").read_bytes() != payload:
+            print("âœ— Extract with --stats differs from original")
+            return False
+
+        print(f"âœ“ Phase stats successful - {stats['total_ns'] / 1e6:.1f} ms extract")
+        return True
+
+    def test_kernel_diff(self):
+        """Test that every LSB kernel variant matches the per-bit reference on random cases"""
+        print("\n--- Testing Kernel Variants Against the Reference ---")
+
+        diff_path = self.exe_path.with_name("pxpl-kernel-diff" + self.exe_path.suffix)
+        if not diff_path.exists():
+            print(f"âœ— {diff_path.name} was not built")
+            return False
+        result = subprocess.run([str(diff_path), "--iterations", "4000", "--seed", "7"],
+                                capture_output=True, text=True, timeout=120, check=False)
+        if result.returncode != 0:
+            print(f"âœ— Kernel differential test failed with return code {result.returncode}")
+            print(result.stderr)
+            return False
+
+        print(f"âœ“ Kernel variants match - {result.stdout.strip()}")
+        return True
+
+    def test_library_options(self):
+        """Test that the in-memory and pixel-buffer functions round-trip with embed options"""
+        print("\n--- Testing In-Memory and Pixel-Buffer Options ---")
+
+        bench_path = self.exe_path.with_name("pxpl-bench" + self.exe_path.suffix)
+        if not bench_path.exists():
+            print(f"âœ— {bench_path.name} was not built")
+            return False
+        # pxpl-bench checks every steg_*_pixels_ex and steg_*_mem_ex round trip it times
+        for options in (["--depth", "2", "--seed", "17"],
+                        ["--depth", "3", "--seed", "5", "--key", "library", "--compress", "auto"]):
+            result = subprocess.run([str(bench_path), "--sizes", "0.05", "--reps", "1", *options],
+                                    capture_output=True, text=True, timeout=300, check=False)
+            stages = {line.split("\t")[0] for line in result.stdout.splitlines()[1:]}
+            if result.returncode != 0 or not {"pixels-extract", "extract"} <= stages:
+                print(f"âœ— Round trip with {' '.join(options)} failed with return code {result.returncode}")
+                print(result.stderr[-2000:])
+                return False
+
+        print("âœ“ In-memory and pixel-buffer options successful")
+        return True
+
+    def benchmark_png_profiles(self):
+        """Print steg size and embed time for each PNG encode profile"""
+        if not self.exe_path.exists() and not self.compile_tool():
+            return False
+
+        cover = "demo_bench_cover.png"
+        self.create_larger_sample(cover, 1920, 1080, "RGB")
+        self.create_text_payloads()
+        cover_size = Path(cover).stat().st_size
+
+        print("\n=== PNG Profile Benchmark (1920x1080 RGB, best of 5) ===")
+        print(f"{'profile':<10}{'size (KB)':>12}{'vs cover':>10}{'embed (ms)':>12}")
+        success = True
+        for profile in ("fast", "balanced", "small"):
+            steg = f"demo_bench_{profile}.png"
+            best = None
+            for _ in range(5):
+                start = time.perf_counter()
+                result = subprocess.run(
+                    [str(self.exe_path), "embed", "--png-profile", profile, cover, "large_payload.txt", steg],
+                    capture_output=True,
+                    timeout=60,
+                    check=False
+                )
+                elapsed = time.perf_counter() - start
+                if result.returncode != 0:
+                    print(f"âœ— {profile} embed failed with return code {result.returncode}")
+                    success = False
+                    break
+                best = elapsed if best is None else min(best, elapsed)
+            if best is not None:
+                size = Path(steg).stat().st_size
+                print(f"{profile:<10}{size / 1024:>12.1f}{size / cover_size:>9.2f}x{best * 1000:>12.1f}")
+
+        self.cleanup_files()
+        return success
+
     def run_steganography_command(self, operation, arg1, arg2, arg3=None):
         """Run a steganography command"""
         try: